@@ -22,8 +22,26 @@
  
 #include "ftle.h"
 
-void compute_gradient_2D ( int ip, int nVertsPerFace, double *coords, double *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, double *log_sqrt, double T );
-void compute_gradient_3D ( int ip, int nVertsPerFace, double *coords, double *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, double *log_sqrt, double T );
+/* Points per batch of the vectorised kernels: 8 doubles fill an AVX-512 register, 2 AVX2 ones */
+#define SIMD_BATCH 8
+
+/* FTLE kernels on flowmaps and results stored as real_t, with the gradient, tensor and eigenvalue computed in
+   acc_t: instantiated for double/double, float/float and float/double (single precision storage, double arithmetic).
+   The dimension NDIM and the vertices per face NVERTS (triangles in 2D, tetrahedra in 3D) are compile-time
+   constants, so callers dispatch on them once per run rather than once per point */
+template <int NDIM, int NVERTS, typename real_t, typename acc_t = real_t>
+void compute_gradient ( int ip, double *coords, real_t *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, real_t *log_sqrt, double T );
+template <int NDIM, int NVERTS, typename real_t, typename acc_t = real_t>
+void compute_gradient_coded ( int ip, double *coords, real_t *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, real_t *log_sqrt, double T );
+template <int NDIM, typename real_t, typename acc_t = real_t>
+void compute_ftle_stencil ( int ip, int *stencil, double *invDenom, real_t *flowmap, real_t *log_sqrt, double T );
+template <int NDIM, typename real_t, typename acc_t = real_t>
+void compute_ftle_stencil_batch ( int ip0, int n, int *stencil, double *invDenom, real_t *flowmap, real_t *log_sqrt, double T );
+template <typename real_t, typename acc_t = real_t>
+void compute_ftle_grid_block ( int iblock, grid_t *grid, real_t *flowmap, real_t *log_sqrt, double T );
+void compute_ftle_ensemble_2D ( int ip, int K, int *stencil, double *invDenom, double *flowmap, double *log_sqrt, double *T );
+void compute_ftle_ensemble_3D ( int ip, int K, int *stencil, double *invDenom, double *flowmap, double *log_sqrt, double *T );
+int  grid_nblocks ( grid_t *grid );
 double log_sqrt ( double T, double eigen );
 double max_solve_3rd_degree_eq ( double a, double b, double c, double d);
 double max_eigen_2D ( double A10, double A11, double A20, double A21 );
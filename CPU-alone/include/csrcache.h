@@ -0,0 +1,68 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef CSRCACHE_H
+#define CSRCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "meshfile.h"
+
+/* 
+ * Sidecar cache of the derived mesh connectivity (faces, CSR point-to-face
+ * lists and, optionally, the stencil table). It uses the UVaFTLE mesh file
+ * layout and is only reused when its key, a content hash of the input
+ * files, matches the one of the current run.
+ */
+#define CSR_CACHE_MAGIC   "UVACSR"
+#define CSR_CACHE_VERSION 1
+
+enum { CSR_SECTION_FACES = 0, CSR_SECTION_NFACESPERPOINT = 1, CSR_SECTION_FACESPERPOINT = 2,
+       CSR_SECTION_STENCIL = 3, CSR_SECTION_INVDENOM = 4, CSR_NSECTIONS = 5 };
+
+typedef struct CsrCacheHeader {
+   char            magic[8];
+   uint32_t        endian;          /* MESH_FILE_ENDIAN as written by the producer */
+   uint32_t        version;
+   uint32_t        nDim;
+   uint32_t        nSections;
+   uint64_t        key;             /* content hash of the coordinates and faces files */
+   uint64_t        nPoints;
+   double          csr_seconds;     /* time spent reading the faces and building the CSR lists */
+   double          stencil_seconds; /* time spent building the stencil table, 0 if absent */
+   mesh_section_t  sections[CSR_NSECTIONS];
+} csr_cache_header_t;
+
+typedef struct CsrCache {
+   void                *map;
+   size_t               size;
+   csr_cache_header_t  *header;
+} csr_cache_t;
+
+uint64_t hash_input_file ( char *filename, uint64_t seed, int nth );
+int      open_csr_cache ( char *filename, uint64_t key, int nDim, int nPoints, csr_cache_t *cache );
+void    *csr_cache_section ( csr_cache_t *cache, int section, int *count );
+void     close_csr_cache ( csr_cache_t *cache );
+int      write_csr_cache ( char *filename, uint64_t key, int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces,
+                           int *nFacesPerPoint, int *facesPerPoint, int *stencil, double *invDenom, double csr_seconds, double stencil_seconds );
+#endif
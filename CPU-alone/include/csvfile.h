@@ -0,0 +1,42 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef CSVFILE_H
+#define CSVFILE_H
+
+#include <stddef.h>
+
+/* 
+ * Parallel CSV output: every row holds the nCols values of a point, in the
+ * original point order when iperm is not NULL. Values are formatted by all
+ * threads into their own buffers, which are written in order with a few
+ * large write calls. CSV_FORMAT_FIXED gives the same bytes as "%f",
+ * CSV_FORMAT_SHORTEST the shortest text that reads back as the same double.
+ * write_csv_file takes double or float values (real_t), the latter written
+ * as the doubles they widen to.
+ */
+enum { CSV_FORMAT_FIXED = 0, CSV_FORMAT_SHORTEST = 1 };
+
+template <typename real_t>
+long long write_csv_file ( char *filename, int nPoints, int nCols, real_t *values, int *iperm, int format, int nth );
+size_t    format_csv_rows ( int nPoints, int nCols, double *values, int *iperm, int format, int nth, char **data );
+#endif
@@ -0,0 +1,134 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "ftle.h"
+#include "meshfile.h"
+#include "csrcache.h"
+#include "timing.h"
+#include "options.h"
+#include "series.h"
+#include "uvaftle.h"
+
+/* 
+ * The ftle driver around libuvaftle: reading the inputs, the connectivity
+ * cache, the FTLE of every snapshot with its output, and the run report.
+ */
+
+/* Connectivity cache of a run: the CSR lists (and stencil table) of the same inputs, mapped from a former run */
+typedef struct ConnectivityCache {
+   char         *file;             /* NULL: not used */
+   uint64_t      key;
+   int           nDim;
+   int           nPoints;
+   csr_cache_t   cache;
+   int           hit;
+   int           stencil_cached;   /* the stencil table came from the cache as well */
+   double        lookup_seconds;
+} connectivity_cache_t;
+
+void   lookup_connectivity_cache ( connectivity_cache_t *cc, char *file, char *coords_file, char *faces_file, int nDim, int nPoints, int reorder,
+                                   timing_t *timing, int nth );
+void   build_mesh_adjacency ( uvaftle_mesh_t *mesh, int flags, connectivity_cache_t *cc, double csr_seconds, timing_t *timing, int nth );
+double connectivity_cache_saving ( connectivity_cache_t *cc );
+void   close_connectivity_cache ( connectivity_cache_t *cc );
+
+/* FTLE of the snapshots of a run, with the hardware counters and the totals of its report */
+typedef struct FtleSolver {
+   uvaftle_mesh_t *mesh;
+   int             nth;
+   int             ensemble;
+   int             nMembers;
+   int             precision;       /* reduced ones are solved on float copies of the flowmap */
+   int             report;          /* and checked against the double kernel */
+   float          *flowmap32;
+   float          *ftle32;
+   int             miss_fd;
+   int             branch_fd;
+   long long       misses;          /* -1 if not available */
+   long long       branch_misses;
+   double          seconds;         /* "ftle" phase */
+   double          wall;
+   double          dev_max;
+   double          dev_sum;
+} ftle_solver_t;
+
+void init_ftle_solver ( ftle_solver_t *s, uvaftle_mesh_t *mesh, int nDim, int nPoints, ftle_options_t *opts, int nMembers, int miss_fd, int branch_fd );
+void narrow_snapshot ( ftle_solver_t *s, double *flowmap, timing_t *timing );
+void solve_snapshot ( ftle_solver_t *s, double *flowmap, double *t_eval, double *ftle, timing_t *timing );
+void free_ftle_solver ( ftle_solver_t *s );
+
+/* One run of the ftle driver: its arguments, options, inputs and the state kept from phase to phase */
+typedef struct FtleDriver {
+   int                   nDim;
+   int                   nVertsPerFace;
+   int                   nth;
+   int                   print2file;   /* 0: no output, 1: CSV, 2: VTU */
+   char                 *coords_file;
+   char                 *faces_file;
+   char                 *flowmap_spec;
+   ftle_options_t        opts;
+   flowmap_series_t      series;
+   int                   nSnapshots;
+   int                   nMembers;
+   timing_t              timing;
+   int                   miss_fd;
+   int                   branch_fd;
+
+   uvaftle_mesh_t       *mesh;
+   grid_t               *grid;         /* NULL on an unstructured mesh */
+   const char           *kernel_name;
+   int                   nPoints;
+   int                   nFaces;
+   double               *coords;
+   int                  *faces;
+   mesh_file_t           mf_coords;
+   mesh_file_t           mf_faces;
+   connectivity_cache_t  cc;
+   double                csr_seconds;
+
+   double               *flowmap;      /* current snapshot in the mesh point order */
+   double               *flowmap_read; /* current snapshot as read */
+   double               *flowmap_perm; /* renumbered copy, NULL if the points are not */
+   double               *spare;
+   mesh_file_t           mf_flowmap;
+   int                  *perm;
+   int                  *iperm;
+
+   double               *logSqrt;      /* double results, NULL if only the float ones of the solver are kept */
+   ftle_solver_t         solver;
+   struct timeval        preproc_clock;
+   struct timeval        ftle_clock;
+} ftle_driver_t;
+
+void init_ftle_driver ( ftle_driver_t *d, int nDim, char *coords_file, char *faces_file, char *flowmap_spec, double t_eval, int nth, int print2file );
+void read_ftle_inputs ( ftle_driver_t *d );
+void prepare_ftle_mesh ( ftle_driver_t *d );
+void solve_ftle_snapshots ( ftle_driver_t *d );
+void report_ftle_run ( ftle_driver_t *d );
+void free_ftle_driver ( ftle_driver_t *d );
+#endif
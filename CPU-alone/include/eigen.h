@@ -0,0 +1,49 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef EIGEN_H
+#define EIGEN_H
+
+/* Largest eigenvalue of a symmetric 3x3 tensor (a00 a01 a02 / a01 a11 a12 / a02 a12 a22).
+   trig:   closed form on the tensor shifted by its mean eigenvalue and scaled by its deviation,
+           with the cosine argument clamped, so that it holds for every spectrum and magnitude.
+   jacobi: cyclic Jacobi rotations until the off-diagonal part vanishes against the diagonal.
+   The batch form solves n tensors stored as arrays of entries in one vector loop: it uses the
+   scaling of trig, but finds the root of the normalised cubic with a few Newton steps instead of
+   acos and cos, which have no vector variants in libm. trig and batch lose about half of the digits
+   when the two largest eigenvalues coincide; jacobi keeps them all. The float overloads run the same
+   algorithms in single precision */
+#define EIGEN_TRIG   0
+#define EIGEN_JACOBI 1
+
+int    eigen_solver_id ( const char *name );
+void   eigen_set_solver ( int solver );
+int    eigen_get_solver ( void );
+
+double eigen_max_sym3 ( double a00, double a01, double a02, double a11, double a12, double a22 );
+float  eigen_max_sym3 ( float a00, float a01, float a02, float a11, float a12, float a22 );
+double eigen_max_sym3_trig ( double a00, double a01, double a02, double a11, double a12, double a22 );
+double eigen_max_sym3_jacobi ( double a00, double a01, double a02, double a11, double a12, double a22 );
+void   eigen_max_sym3_batch ( int n, double *a00, double *a01, double *a02, double *a11, double *a12, double *a22, double *lmax );
+void   eigen_max_sym3_batch ( int n, float *a00, float *a01, float *a02, float *a11, float *a12, float *a22, float *lmax );
+
+#endif
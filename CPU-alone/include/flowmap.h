@@ -0,0 +1,55 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef FLOWMAP_H
+#define FLOWMAP_H
+
+#include "ftle.h"
+
+/* 
+ * Flowmap integration from a velocity field sampled on the mesh lattice at
+ * a set of times, as written by mesh-generation.py (times_file, vel_file).
+ * The velocity is interpolated linearly in space and time and is 0 outside
+ * the sampled domain, as scipy's RegularGridInterpolator(fill_value=0).
+ */
+enum { FLOWMAP_RK4 = 0, FLOWMAP_RK45 = 1 };
+
+typedef struct Velocity {
+   grid_t   *grid;      /* lattice of the sampling points */
+   int       nPoints;
+   int       nTimes;
+   double   *times;     /* strictly increasing sampling times */
+   double   *vel;       /* [nTimes][nPoints][nDim] */
+} velocity_t;
+
+typedef struct Integrator {
+   int       method;    /* FLOWMAP_RK4 or FLOWMAP_RK45 */
+   int       nsteps;    /* fixed steps of RK4 */
+   double    rtol;      /* RK45 relative tolerance */
+   double    atol;      /* RK45 absolute tolerance */
+} integrator_t;
+
+int  read_times ( char *filename, double **times, int nth );
+void read_velocity ( char *filename, int nDim, int nPoints, int nTimes, double *vel, int nth );
+void interpolate_velocity ( velocity_t *v, double t, double *x, double *u );
+void compute_flowmap ( velocity_t *v, integrator_t *integ, int nPoints, double *coords, double t0, double T, double *flowmap, int nth );
+#endif
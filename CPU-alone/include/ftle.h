@@ -42,4 +42,13 @@ typedef struct Mesh {
    point_t  *points;
    face_t   *faces;
 } mesh_t;
+
+typedef struct Grid {
+   int       nDim;
+   int       dims[3];      /* number of lattice lines along each axis */
+   int       strides[3];   /* index distance between neighbours along each axis */
+   int       order[3];     /* axes sorted from the fastest to the slowest varying one */
+   double   *axis[3];      /* coordinates of the lattice lines */
+   double   *invDenom[3];  /* 1 / (axis[i+1] - axis[i-1]), 0 at the borders */
+} grid_t;
 #endif
@@ -0,0 +1,51 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef GMSH_H
+#define GMSH_H
+
+#include <stddef.h>
+
+/* 
+ * Gmsh MSH 4.1 reader (ASCII and binary). Points are the nodes of the $Nodes
+ * section in file order, so flowmaps have to follow that order; faces are the
+ * triangles (2D) or tetrahedra (3D) of the $Elements section, any other element
+ * type is skipped.
+ */
+typedef struct GmshFile {
+   char    *data;
+   size_t   size;
+   int      binary;
+   size_t   nodes, nodes_end;         /* body of the $Nodes section */
+   size_t   elements, elements_end;   /* body of the $Elements section */
+   long     minTag;
+   long     nTags;
+   int     *tag2idx;                  /* node tag - minTag -> point index, -1 if unused */
+   char    *filename;
+} gmsh_file_t;
+
+int  is_gmsh_file ( char *filename );
+void open_gmsh_file ( char *filename, gmsh_file_t *gf );
+int  read_gmsh_nodes ( gmsh_file_t *gf, int nDim, double **coords, int nth );
+int  read_gmsh_elements ( gmsh_file_t *gf, int nDim, int **faces, int nth );
+void close_gmsh_file ( gmsh_file_t *gf );
+#endif
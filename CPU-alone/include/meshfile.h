@@ -0,0 +1,72 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef MESHFILE_H
+#define MESHFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* 
+ * UVaFTLE binary mesh container. The header is followed by the raw arrays,
+ * each one starting at a MESH_FILE_ALIGN boundary, so they can be used
+ * straight from the mapped file.
+ */
+#define MESH_FILE_MAGIC   "UVAFTLE"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ENDIAN  0x01020304
+#define MESH_FILE_ALIGN   64
+
+enum { MESH_DTYPE_NONE = 0, MESH_DTYPE_INT32 = 1, MESH_DTYPE_FLOAT64 = 2 };
+enum { MESH_SECTION_COORDS = 0, MESH_SECTION_FACES = 1, MESH_SECTION_FLOWMAP = 2, MESH_NSECTIONS = 3 };
+
+typedef struct MeshSection {
+   uint64_t  offset;    /* bytes from the file start, 0 if absent */
+   uint64_t  count;     /* number of points or faces */
+   uint32_t  width;     /* values per element (nDim or nVertsPerFace) */
+   uint32_t  dtype;     /* MESH_DTYPE_* */
+} mesh_section_t;
+
+typedef struct MeshHeader {
+   char            magic[8];
+   uint32_t        endian;   /* MESH_FILE_ENDIAN as written by the producer */
+   uint32_t        version;
+   uint32_t        nDim;
+   uint32_t        nSections;
+   mesh_section_t  sections[MESH_NSECTIONS];
+} mesh_header_t;
+
+typedef struct MeshFile {
+   void           *map;
+   size_t          size;
+   mesh_header_t  *header;
+} mesh_file_t;
+
+int   is_mesh_file ( char *filename );
+void  open_mesh_file ( char *filename, mesh_file_t *mf );
+void *mesh_file_section ( mesh_file_t *mf, int section, int width, int *count );
+int   mesh_section_fits ( mesh_section_t *sec, size_t size );
+void  close_mesh_file ( mesh_file_t *mf );
+void  write_mesh_file ( char *filename, int nDim, int nPoints, double *coords, int nFaces, int nVertsPerFace, int *faces, double *flowmap );
+uint64_t write_mesh_section ( FILE *file, uint64_t offset, mesh_section_t *sec, void *data, int count, int width, uint32_t dtype, size_t elem );
+#endif
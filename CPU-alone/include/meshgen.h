@@ -0,0 +1,36 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef MESHGEN_H
+#define MESHGEN_H
+
+/* 
+ * Structured meshes on an nx x ny [x nz] lattice, with the point order of
+ * mesh-generation.py (y varies fastest, then x, then z): every quad is split
+ * into 2 triangles and every cube into 5 or 6 tetrahedra.
+ */
+long lattice_index ( int nDim, int *dims, int ix, int iy, int iz );
+int  generate_lattice_coords ( int nDim, int *dims, double *bounds, double **coords, int nth );
+int  generate_lattice_faces ( int nDim, int *dims, int nTetsPerCube, int **faces, int nth );
+void write_coordinates ( char *filename, int nDim, int nPoints, double *coords );
+void write_faces ( char *filename, int nVertsPerFace, int nFaces, int *faces );
+#endif
@@ -0,0 +1,67 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "omp.h"
+
+#include "flowmap.h"
+
+/* 
+ * Run options of the ftle driver, read from the FTLE_* environment
+ * variables, and the OpenMP schedules of its phases.
+ */
+
+/* OpenMP schedule and thread count of one phase */
+typedef struct Schedule {
+   omp_sched_t  kind;
+   int          chunk;   /* 0: implementation default */
+   int          nth;
+} sched_t;
+
+/* Run options read from the FTLE_* environment variables */
+typedef struct FtleOptions {
+   sched_t       preproc_sched;
+   sched_t       ftle_sched;
+   char         *preproc;       /* CSR builder: "linear" or "quadratic" */
+   int           kernel;        /* UVAFTLE_KERNEL_* */
+   char         *grid_env;      /* FTLE_GRID, NULL if the lattice size is not checked */
+   int           grid_dims[3];
+   char         *vel_file;      /* FTLE_VELOCITY and FTLE_TIMES, NULL if the flowmap is read */
+   char         *times_file;
+   integrator_t  integrator;
+   int           ensemble;
+   int           precision;     /* UVAFTLE_PRECISION_* */
+   int           precision_report;  /* reduced precisions: deviation from the double kernel reported */
+   int           reorder;       /* UVAFTLE_REORDER_* */
+   int           vtu_level;
+   int           csv_format;    /* CSV_FORMAT_* */
+   char         *cache_file;    /* FTLE_CACHE, NULL if off */
+   char         *timing_log;    /* FTLE_TIMING, NULL if off */
+} ftle_options_t;
+
+void read_ftle_options ( int nDim, int nth, char *faces_file, int nSnapshots, ftle_options_t *opts );
+void free_ftle_options ( ftle_options_t *opts );
+void schedule_name ( sched_t *sched, char *name, int len );
+void apply_schedule ( sched_t *sched, const char *phase );
+#endif
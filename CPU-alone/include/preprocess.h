@@ -24,8 +24,16 @@
 #include <stdlib.h>
 #include "ftle.h"
 
-void read_coordinates ( char *filename, int nDim, int npoints, double *coords );
-void read_faces ( char *filename, int nDim, int nVertsPerFace, int nfaces, int *faces );
-void read_flowmap ( char *filename, int nDims, int nPoints, double *flowmap );
+int  read_coordinates ( char *filename, int nDim, double **coords, int nth );
+int  read_faces ( char *filename, int nDim, int nVertsPerFace, int **faces, int nth );
+long count_text_tokens ( char *data, size_t begin, size_t end, int nth );
+void parse_text_range ( char *data, size_t begin, size_t end, long ntokens, double *values, int nth, const char *caller );
+void read_flowmap ( char *filename, int nDims, int nPoints, double *flowmap, int nth );
 void create_nFacesPerPoint_vector ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint );
+void create_nFacesPerPoint_vector_parallel ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint, int nth );
 void create_facesPerPoint_vector ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint, int *facesPerPoint );
+void create_facesPerPoint_vector_linear ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint, int *facesPerPoint, int nth );
+void create_stencil_table ( int nDim, int nPoints, int nVertsPerFace, double *coords, int *faces, int *nFacesPerPoint, int *facesPerPoint, int *stencil, double *invDenom, int nth );
+void create_grid_stencil_table ( grid_t *grid, int nPoints, int *stencil, double *invDenom, int nth );
+int  detect_structured_grid ( int nDim, int nPoints, double *coords, int *dims, grid_t *grid, int nth );
+void free_structured_grid ( grid_t *grid );
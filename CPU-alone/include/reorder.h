@@ -0,0 +1,35 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef REORDER_H
+#define REORDER_H
+
+/* 
+ * Point renumbering for locality: points sorted along a Morton (Z-order)
+ * curve of their coordinates, with the faces renumbered and sorted to match.
+ * perm[new] = old and iperm[old] = new.
+ */
+void morton_order ( int nDim, int nPoints, double *coords, int *perm, int nth );
+void invert_permutation ( int nPoints, int *perm, int *iperm, int nth );
+void permute_points ( int nPoints, int width, int *perm, double *src, double *dst, int nth );
+void renumber_faces ( int nPoints, int nFaces, int nVertsPerFace, int *iperm, int *faces, int *dst, int nth );
+#endif
@@ -0,0 +1,61 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <pthread.h>
+#include "omp.h"
+
+#include "meshfile.h"
+#include "timing.h"
+
+/* 
+ * Time series (or ensemble) of flowmaps solved against one resident mesh:
+ * the snapshot files with their integration times, and the background read
+ * of the next snapshot while the current one is computed.
+ */
+typedef struct FlowmapSeries {
+   int      n;
+   char   **files;
+   double  *t_eval;
+} flowmap_series_t;
+
+typedef struct FlowmapPrefetch {
+   pthread_t    thread;
+   char        *filename;
+   int          nDim;
+   int          nPoints;
+   double      *flowmap;   /* text files: buffer filled by the reader (allocated if NULL) */
+   mesh_file_t  mf;        /* UVaFTLE mesh files: mapping whose pages the reader faults in */
+   double       seconds;
+   long long    bytes;
+} flowmap_prefetch_t;
+
+void    read_flowmap_series ( char *spec, double t_eval, flowmap_series_t *series );
+void    free_flowmap_series ( flowmap_series_t *series );
+void    start_flowmap_prefetch ( flowmap_prefetch_t *pf, char *filename, int nDim, int nPoints, double *buffer );
+double *finish_flowmap_prefetch ( flowmap_prefetch_t *pf );
+double *swap_prefetched_flowmap ( flowmap_prefetch_t *pf, double *current, mesh_file_t *mf_current, double **spare );
+void    interleave_flowmaps ( int nPoints, int nDim, int K, double **members, double *flowmapK, int nth );
+double *read_ensemble_members ( flowmap_series_t *series, int nDim, int nPoints, double *flowmap, mesh_file_t *mf, timing_t *timing, int nth );
+#endif
@@ -0,0 +1,71 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdio.h>
+
+/* 
+ * Per-phase instrumentation: wall time, bytes moved and threads of every
+ * phase of a run, emitted as a single-line JSON record.
+ */
+#define TIMING_MAX_PHASES 24
+#define TIMING_MAX_FIELDS 24
+#define TIMING_NAME_LEN   32
+#define TIMING_FIELD_LEN  256
+
+typedef struct TimingPhase {
+   char       name[TIMING_NAME_LEN];
+   double     seconds;
+   long long  bytes;     /* bytes read or written, 0 for compute phases */
+   int        nth;
+   int        calls;     /* times the phase ran, its seconds and bytes are the totals */
+} timing_phase_t;
+
+/* Hardware events of timing_counter_open */
+enum { TIMING_CACHE_MISSES = 0, TIMING_BRANCH_MISSES = 1 };
+
+typedef struct Timing {
+   double          start;     /* wall time of the run start */
+   double          begin;     /* wall time of the current phase start */
+   int             nPhases;
+   timing_phase_t  phases[TIMING_MAX_PHASES];
+   int             nFields;
+   char            fields[TIMING_MAX_FIELDS][TIMING_FIELD_LEN];   /* "key": value, already in JSON */
+} timing_t;
+
+void      timing_init ( timing_t *t );
+void      timing_begin ( timing_t *t );
+double    timing_end ( timing_t *t, const char *name, int nth, long long bytes );
+void      timing_add ( timing_t *t, const char *name, double seconds, int nth, long long bytes );
+void      timing_set_int ( timing_t *t, const char *key, long long value );
+void      timing_set_double ( timing_t *t, const char *key, double value );
+void      timing_set_string ( timing_t *t, const char *key, const char *value );
+long long timing_file_size ( const char *filename );
+int       timing_counter_open ( int event );
+void      timing_counter_start ( int fd );
+long long timing_counter_stop ( int fd );
+void      timing_counter_close ( int fd );
+void      timing_write_json ( timing_t *t, FILE *fp );
+void      timing_report ( timing_t *t, const char *destination );
+#endif
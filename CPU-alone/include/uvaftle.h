@@ -0,0 +1,111 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef UVAFTLE_H
+#define UVAFTLE_H
+
+/*
+ * libuvaftle: the FTLE pipeline with a C ABI for in-process use.
+ *
+ *   mesh = uvaftle_mesh_create( nDim, nPoints, coords, UVAFTLE_KERNEL_AUTO, NULL, nth );
+ *   uvaftle_mesh_set_faces( mesh, nFaces, faces );       (not needed on a lattice)
+ *   uvaftle_mesh_reorder( mesh, UVAFTLE_REORDER_MORTON ); (optional: flowmaps are then
+ *                                                        given through uvaftle_mesh_permute)
+ *   uvaftle_build_adjacency( mesh, 0 );                  (once)
+ *   uvaftle_compute( mesh, flowmap, t_eval, ftle );      (any number of flowmaps)
+ *   uvaftle_narrow_flowmap( mesh, flowmap, flowmap32 );  (float copy, renumbered like
+ *                                                        uvaftle_mesh_permute)
+ *   uvaftle_compute_float( mesh, flowmap32, t_eval, ftle32, UVAFTLE_PRECISION_MIXED );
+ *                                                        (the same on float arrays)
+ *   uvaftle_mesh_free( mesh );
+ *
+ * coords (nPoints x nDim), faces (nFaces x nDim+1), flowmaps and results are
+ * caller-owned row-major arrays that are used in place, never copied: they
+ * must outlive the mesh, or the calls that read them. Arrays built by the
+ * library, renumbered coordinates and faces included, are owned by the mesh.
+ * Functions returning int give 0 on success and -1 on a wrong argument,
+ * described on stderr. The preprocessing and FTLE loops use schedule(runtime),
+ * i.e. the omp_set_schedule of the caller.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct UvaFtleMesh uvaftle_mesh_t;
+struct Grid;
+
+/* FTLE kernels; AUTO resolves to GRID on a rectilinear lattice and to STENCIL otherwise */
+enum { UVAFTLE_KERNEL_AUTO = 0, UVAFTLE_KERNEL_GRID = 1, UVAFTLE_KERNEL_STENCIL = 2, UVAFTLE_KERNEL_SIMD = 3,
+       UVAFTLE_KERNEL_FACEWALK = 4, UVAFTLE_KERNEL_FACECODE = 5, UVAFTLE_NKERNELS = 6 };
+
+/* Precision of uvaftle_compute_float: SINGLE computes in float, MIXED in double; both store float */
+enum { UVAFTLE_PRECISION_DOUBLE = 0, UVAFTLE_PRECISION_SINGLE = 1, UVAFTLE_PRECISION_MIXED = 2, UVAFTLE_NPRECISIONS = 3 };
+
+/* Point orders of uvaftle_mesh_reorder */
+enum { UVAFTLE_REORDER_NONE = 0, UVAFTLE_REORDER_MORTON = 1, UVAFTLE_NREORDERS = 2 };
+
+/* uvaftle_build_adjacency flags */
+#define UVAFTLE_BUILD_QUADRATIC  1   /* serial count and per-point face search instead of the linear CSR builder */
+#define UVAFTLE_BUILD_STENCIL    2   /* stencil table whatever the kernel (ensembles) */
+#define UVAFTLE_BUILD_KEEP_FACES 4   /* keep the faces and CSR lists once the stencil table is built */
+
+int             uvaftle_kernel_id ( const char *name );
+const char     *uvaftle_kernel_name ( int kernel );
+int             uvaftle_precision_id ( const char *name );
+const char     *uvaftle_precision_name ( int precision );
+int             uvaftle_reorder_id ( const char *name );
+const char     *uvaftle_reorder_name ( int order );
+
+uvaftle_mesh_t *uvaftle_mesh_create ( int nDim, int nPoints, double *coords, int kernel, int *grid_dims, int nth );
+void            uvaftle_mesh_free ( uvaftle_mesh_t *mesh );
+int             uvaftle_mesh_set_threads ( uvaftle_mesh_t *mesh, int preproc_nth, int ftle_nth );
+int             uvaftle_mesh_set_coords ( uvaftle_mesh_t *mesh, double *coords );
+int             uvaftle_mesh_set_faces ( uvaftle_mesh_t *mesh, int nFaces, int *faces );
+int             uvaftle_mesh_set_adjacency ( uvaftle_mesh_t *mesh, int *nFacesPerPoint, int *facesPerPoint,
+                                             int *stencil, double *invDenom );
+int             uvaftle_mesh_kernel ( uvaftle_mesh_t *mesh );
+int             uvaftle_mesh_npoints ( uvaftle_mesh_t *mesh );
+struct Grid    *uvaftle_mesh_grid ( uvaftle_mesh_t *mesh );
+double         *uvaftle_mesh_coords ( uvaftle_mesh_t *mesh );
+int            *uvaftle_mesh_faces ( uvaftle_mesh_t *mesh, int *nFaces );
+
+int             uvaftle_mesh_reorder ( uvaftle_mesh_t *mesh, int order );
+void            uvaftle_mesh_permutation ( uvaftle_mesh_t *mesh, int **perm, int **iperm );
+int             uvaftle_mesh_permute ( uvaftle_mesh_t *mesh, int width, double *src, double *dst );
+
+int             uvaftle_build_adjacency ( uvaftle_mesh_t *mesh, int flags );
+void            uvaftle_mesh_adjacency ( uvaftle_mesh_t *mesh, int **nFacesPerPoint, int **facesPerPoint,
+                                         int **stencil, double **invDenom );
+void            uvaftle_mesh_drop_faces ( uvaftle_mesh_t *mesh );
+double          uvaftle_phase_seconds ( uvaftle_mesh_t *mesh, const char *phase );
+
+int             uvaftle_compute ( uvaftle_mesh_t *mesh, double *flowmap, double t_eval, double *ftle );
+int             uvaftle_compute_float ( uvaftle_mesh_t *mesh, float *flowmap, double t_eval, float *ftle, int precision );
+int             uvaftle_narrow_flowmap ( uvaftle_mesh_t *mesh, double *flowmap, float *flowmap32 );
+int             uvaftle_precision_deviation ( uvaftle_mesh_t *mesh, const float *ftle, const double *reference,
+                                              double *dev_max, double *dev_sum );
+int             uvaftle_compute_ensemble ( uvaftle_mesh_t *mesh, int nMembers, double *flowmapK, double *t_eval, double *ftle );
+
+#ifdef __cplusplus
+}
+#endif
+#endif
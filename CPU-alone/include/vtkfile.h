@@ -0,0 +1,40 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#ifndef VTKFILE_H
+#define VTKFILE_H
+
+#include "ftle.h"
+
+/* 
+ * VTK XML unstructured grid (.vtu) output: points, cells and one FTLE point
+ * array per ensemble member, stored as raw appended binary data that is
+ * zlib-compressed when level > 0 (and UVaFTLE was built with zlib).
+ * Cells are the faces, or the lattice quads/hexahedra when grid is not NULL.
+ * With a point renumbering (perm/iperm not NULL) everything is written back
+ * in the original point order. The FTLE values may be double or float
+ * (real_t); the arrays are Float64 either way. Returns the bytes written.
+ */
+template <typename real_t>
+long long write_vtu_file ( char *filename, int nDim, int nPoints, double *coords, int nFaces, int nVertsPerFace, int *faces, grid_t *grid,
+                           int nArrays, real_t *values, int *perm, int *iperm, int level, int nth );
+#endif
@@ -21,6 +21,7 @@
  */ 
  
 #include "arithmetic.h"
+#include "eigen.h"
 #include "math.h"
 
 double max_solve_3rd_degree_eq ( double a, double b, double c, double d)
@@ -48,343 +49,510 @@ double max_solve_3rd_degree_eq ( double a, double b, double c, double d)
 		x2         = (-b+sqrt(A)*(cos(xt)+sqrt(3)*sin(xt)))/(3*a);
 		x3         = (-b+sqrt(A)*(cos(xt)-sqrt(3)*sin(xt)))/(3*a);
 	}
+	else
+	{
+		/* A single real root (Cardano); rounding can land here on the real spectrum of a symmetric tensor */
+		double sq  = sqrt(del);
+		double Y1  = A*b + 3*a*(-B+sq)/2;
+		double Y2  = A*b + 3*a*(-B-sq)/2;
+		x1 = x2 = x3 = (-b-(cbrt(Y1)+cbrt(Y2)))/(3*a);
+	}
 	double max = ( x1 > x2 ) ? x1 : x2;
 	return ( max > x3 ) ? max : x3;
 }
 
-void compute_gradient_2D ( int ip, int nVertsPerFace, double *coords, double *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, double *log_sqrt, double T )
+/* Max eigenvalue of the Cauchy-Green tensor C = grad^T grad. The squared tensor used before had the
+   same eigenvector and the square of this eigenvalue, so log(sqrt(.)) of that one is log of this one */
+template <typename acc_t>
+static inline acc_t eigen_from_gradient_2D ( acc_t gra10, acc_t gra11, acc_t gra20, acc_t gra21 )
+{
+    acc_t C00 = gra10 * gra10 + gra11 * gra11;
+    acc_t C01 = gra10 * gra20 + gra11 * gra21;
+    acc_t C11 = gra20 * gra20 + gra21 * gra21;
+
+    acc_t mean = ( C00 + C11 ) / 2;
+    acc_t half = ( C00 - C11 ) / 2;
+    return mean + sqrt( half * half + C01 * C01 );
+}
+
+template <typename acc_t>
+static inline acc_t ftle_from_gradient_2D ( acc_t gra10, acc_t gra11, acc_t gra20, acc_t gra21, double T )
+{
+	return log( eigen_from_gradient_2D ( gra10, gra11, gra20, gra21 ) ) / (acc_t) T;
+}
+
+/* Upper triangle of the Cauchy-Green tensor; row i of the gradient is component i of the flowmap */
+template <typename acc_t>
+static inline void tensor_from_gradient_3D ( acc_t gra10, acc_t gra11, acc_t gra12, acc_t gra20, acc_t gra21, acc_t gra22, acc_t gra30, acc_t gra31, acc_t gra32, acc_t *a00, acc_t *a01, acc_t *a02, acc_t *a11, acc_t *a12, acc_t *a22 )
 {
-	int nDim = 2; 
-	int iface, nFaces, idxface, ivert;
-	int closest_points_0 = -1;
-	int closest_points_1 = -1;
-	int closest_points_2 = -1;
-	int closest_points_3 = -1;
+    *a00 = gra10 * gra10 + gra20 * gra20 + gra30 * gra30;
+    *a01 = gra10 * gra11 + gra20 * gra21 + gra30 * gra31;
+    *a02 = gra10 * gra12 + gra20 * gra22 + gra30 * gra32;
+    *a11 = gra11 * gra11 + gra21 * gra21 + gra31 * gra31;
+    *a12 = gra11 * gra12 + gra21 * gra22 + gra31 * gra32;
+    *a22 = gra12 * gra12 + gra22 * gra22 + gra32 * gra32;
+}
+
+template <typename acc_t>
+static inline acc_t ftle_from_gradient_3D ( acc_t gra10, acc_t gra11, acc_t gra12, acc_t gra20, acc_t gra21, acc_t gra22, acc_t gra30, acc_t gra31, acc_t gra32, double T )
+{
+    acc_t a00, a01, a02, a11, a12, a22;
+    tensor_from_gradient_3D ( gra10, gra11, gra12, gra20, gra21, gra22, gra30, gra31, gra32, &a00, &a01, &a02, &a11, &a12, &a22 );
+    return log( eigen_max_sym3 ( a00, a01, a02, a11, a12, a22 ) ) / (acc_t) T;
+}
+
+/* FTLE from the gradient gra[c][a] = d flowmap_c / d x_a, overloaded on its dimension */
+template <typename acc_t>
+static inline acc_t ftle_from_gradient ( acc_t (&gra)[2][2], double T )
+{
+	return ftle_from_gradient_2D<acc_t> ( gra[0][0], gra[1][0], gra[0][1], gra[1][1], T );
+}
+
+template <typename acc_t>
+static inline acc_t ftle_from_gradient ( acc_t (&gra)[3][3], double T )
+{
+	return ftle_from_gradient_3D<acc_t> ( gra[0][0], gra[0][1], gra[0][2], gra[1][0], gra[1][1], gra[1][2], gra[2][0], gra[2][1], gra[2][2], T );
+}
+
+/* Neighbours a point needs for a gradient: in 2D the complete pair is kept when a single one of the 4 is
+   missing, in 3D all 6 are required. Every axis without both neighbours keeps a unit gradient term; past
+   this count the pairs of a 3D point need no test, which keeps its gradient in registers */
+#define MIN_NEIGHBOURS(NDIM) ( ( (NDIM) == 2 ) ? 3 : 6 )
+
+/* Unit gradient of the points without enough neighbours */
+template <int NDIM, typename acc_t>
+static inline acc_t ftle_from_unit_gradient ( double T )
+{
+	acc_t gra[NDIM][NDIM];
+	for ( int comp = 0; comp < NDIM; comp++ )
+		for ( int axis = 0; axis < NDIM; axis++ )
+			gra[comp][axis] = 1;
+	return ftle_from_gradient<acc_t> ( gra, T );
+}
+
+/* FTLE of point ip from the count neighbours found in closest by the face-walk kernels */
+template <int NDIM, typename real_t, typename acc_t>
+static inline void ftle_from_neighbours ( int ip, int *closest, int count, double *coords, real_t *flowmap, real_t *log_sqrt, double T )
+{
+	acc_t gra[NDIM][NDIM];
+
+	if ( count < MIN_NEIGHBOURS(NDIM) )
+	{
+		log_sqrt[ip] = ftle_from_unit_gradient<NDIM, acc_t> ( T );
+		return;
+	}
+
+	for ( int axis = 0; axis < NDIM; axis++ )
+	{
+		int lo = closest[2 * axis], hi = closest[2 * axis + 1];
+		if ( ( MIN_NEIGHBOURS(NDIM) == 2 * NDIM ) || ( ( lo > -1 ) && ( hi > -1 ) ) )
+		{
+			/* NOTE: take care with denom zero */
+			acc_t denom = coords[ hi * NDIM + axis ] - coords[ lo * NDIM + axis ];
+			for ( int comp = 0; comp < NDIM; comp++ )
+				gra[comp][axis] = ( (acc_t) flowmap[ hi * NDIM + comp ] - (acc_t) flowmap[ lo * NDIM + comp ] ) / denom;
+		}
+		else
+			for ( int comp = 0; comp < NDIM; comp++ )
+				gra[comp][axis] = 1;
+	}
+	log_sqrt[ip] = ftle_from_gradient<acc_t> ( gra, T );
+}
+
+/* Neighbour k of a point is the first vertex found, among its faces, on the line of axis k/2 through it:
+   below it for even k, above it for odd k. With NDIM and NVERTS known at compile time the tests of every
+   vertex and the gradient loops are unrolled */
+template <int NDIM, int NVERTS, typename real_t, typename acc_t>
+void compute_gradient ( int ip, double *coords, real_t *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, real_t *log_sqrt, double T )
+{
+	int closest[2 * NDIM];
 	int count = 0;
+	int first  = (ip == 0) ? 0 : nFacesPerPoint[ip-1];
+	int nFaces = nFacesPerPoint[ip] - first;
+	double *x = coords + ip * NDIM;
 
-	int ivertex;
-	double denom_x, denom_y;
-	double gra10, gra11, gra20, gra21;
-	double ftle_matrix[4], d_W_ei[2];
+	for ( int k = 0; k < 2 * NDIM; k++ )
+		closest[k] = -1;
 
-	nFaces  = (ip == 0) ? nFacesPerPoint[ip] : nFacesPerPoint[ip] - nFacesPerPoint[ip-1];
-    /* Find 4 closest points */
-	
-	for ( iface = 0; (iface < nFaces) && (count < 4); iface++ )
+	for ( int iface = 0; (iface < nFaces) && (count < 2 * NDIM); iface++ )
 	{
-		idxface = (ip == 0) ? facesPerPoint[iface] : facesPerPoint[nFacesPerPoint[ip-1] + iface];
-		for ( ivert = 0; (ivert < nVertsPerFace) && (count < 4); ivert++ )
+		int idxface = facesPerPoint[first + iface];
+		for ( int ivert = 0; (ivert < NVERTS) && (count < 2 * NDIM); ivert++ )
 		{
-			ivertex = faces[idxface * nVertsPerFace + ivert];
-			if ( ivertex != ip )
+			int ivertex = faces[idxface * NVERTS + ivert];
+			double *y = coords + ivertex * NDIM;
+			if ( ivertex == ip )
+				continue;
+			for ( int axis = 0; axis < NDIM; axis++ )
 			{
-        		/* (i-1, j) */
-				if ( (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) && (coords[ivertex * nDim] < coords[ip * nDim]) )
+				int on_line = 1;
+				for ( int other = 0; other < NDIM; other++ )
+					on_line = on_line && ( ( other == axis ) || ( y[other] == x[other] ) );
+				int side = ( y[axis] < x[axis] ) ? 0 : ( ( y[axis] > x[axis] ) ? 1 : -1 );
+				if ( on_line && ( side >= 0 ) )
 				{
-					if (closest_points_0 == -1)
+					if ( closest[2 * axis + side] == -1 )
 					{
-						closest_points_0 = ivertex;
+						closest[2 * axis + side] = ivertex;
 						count++;
 					}
+					break;
 				}
-				else
-				{
-        			/* (i+1, j) */
-					if ( (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) && (coords[ivertex * nDim] > coords[ip * nDim]) )
-					{
-						if (closest_points_1 == -1)
-						{
-							closest_points_1 = ivertex;
-							count++;
-						}
-					}
-					else
-					{
-        				/* (i, j-1) */
-						if ( (coords[ivertex * nDim] == coords[ip * nDim]) && (coords[ivertex * nDim + 1] < coords[ip * nDim + 1]) ) 
-						{
-							if (closest_points_2 == -1)
-							{
-								closest_points_2 = ivertex;
-								count++;
-							}
-						}
-						else
-						{
-        					/* (i, j+1) */
-							if ( (coords[ivertex * nDim] == coords[ip * nDim]) && (coords[ivertex * nDim + 1] > coords[ip * nDim + 1]) )
-							{
-								if (closest_points_3 == -1)
-								{
-									closest_points_3 = ivertex;
-									count++;
-								}
-							}
-						}
-					}
-				}			
 			}
 		}
-	}     
-	if ( count == 4 )
+	}
+	ftle_from_neighbours<NDIM, real_t, acc_t> ( ip, closest, count, coords, flowmap, log_sqrt, T );
+}
+
+/* Position code of vertex y around point x: digit a (base 4) is 0 when y has coordinate a of x, 1 when it
+   is below, 2 above and 3 unordered (NaN). Two comparisons per axis and no branch, so the loop over the vertices of a face can be vectorised */
+template <int NDIM>
+static inline int neighbour_code ( double *x, double *y )
+{
+	int code = 0;
+	for ( int axis = NDIM - 1; axis >= 0; axis-- )
+		code = 4 * code + !( y[axis] >= x[axis] ) + 2 * !( y[axis] <= x[axis] );
+	return code;
+}
+
+/* Neighbour slot of every position code: a neighbour differs from the point on a single axis (codes 4^a and
+   2 4^a), any other vertex, the point itself included, goes to the spare slot 2 NDIM */
+static const signed char neighbour_slot_2D[16] = {
+	4, 0, 1, 4,   2, 4, 4, 4,   3, 4, 4, 4,   4, 4, 4, 4 };
+static const signed char neighbour_slot_3D[64] = {
+	6, 0, 1, 6,   2, 6, 6, 6,   3, 6, 6, 6,   6, 6, 6, 6,
+	4, 6, 6, 6,   6, 6, 6, 6,   6, 6, 6, 6,   6, 6, 6, 6,
+	5, 6, 6, 6,   6, 6, 6, 6,   6, 6, 6, 6,   6, 6, 6, 6,
+	6, 6, 6, 6,   6, 6, 6, 6,   6, 6, 6, 6,   6, 6, 6, 6 };
+
+/* Face-walk kernel without the comparison chain of compute_gradient, whose branches are mispredicted when
+   the faces of the points come in no fixed order: the vertices of every face get their position codes in a
+   simd loop, and the table gives their slots, which keep the first vertex found through selects. The spare
+   slot is never empty, so it is never counted. The neighbours, and so the results, are those of compute_gradient */
+template <int NDIM, int NVERTS, typename real_t, typename acc_t>
+void compute_gradient_coded ( int ip, double *coords, real_t *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, real_t *log_sqrt, double T )
+{
+	const signed char *slot_of = ( NDIM == 2 ) ? neighbour_slot_2D : neighbour_slot_3D;
+	int closest[2 * NDIM + 1];
+	int count = 0;
+	int first  = (ip == 0) ? 0 : nFacesPerPoint[ip-1];
+	int nFaces = nFacesPerPoint[ip] - first;
+	double *x = coords + ip * NDIM;
+
+	for ( int k = 0; k < 2 * NDIM; k++ )
+		closest[k] = -1;
+	closest[2 * NDIM] = ip;
+
+	for ( int iface = 0; (iface < nFaces) && (count < 2 * NDIM); iface++ )
+	{
+		int *vertex = faces + facesPerPoint[first + iface] * NVERTS;
+		int code[NVERTS];
+
+		#pragma omp simd
+		for ( int ivert = 0; ivert < NVERTS; ivert++ )
+			code[ivert] = neighbour_code<NDIM> ( x, coords + vertex[ivert] * NDIM );
+
+		for ( int ivert = 0; ivert < NVERTS; ivert++ )
+		{
+			int slot  = slot_of[ code[ivert] ];
+			int empty = ( closest[slot] == -1 );
+			closest[slot] = empty ? vertex[ivert] : closest[slot];
+			count += empty;
+		}
+	}
+	ftle_from_neighbours<NDIM, real_t, acc_t> ( ip, closest, count, coords, flowmap, log_sqrt, T );
+}
+
+/* Same neighbour rules as compute_gradient, on the neighbours and inverse distances of the stencil table */
+template <int NDIM, typename real_t, typename acc_t>
+void compute_ftle_stencil ( int ip, int *stencil, double *invDenom, real_t *flowmap, real_t *log_sqrt, double T )
+{
+	int *closest = stencil + ip * 2 * NDIM;
+	int count = 0;
+	acc_t gra[NDIM][NDIM];
+
+	for ( int k = 0; k < 2 * NDIM; k++ )
+		count += ( closest[k] > -1 );
+
+	if ( count < MIN_NEIGHBOURS(NDIM) )
 	{
-		/* NOTE: take care with denom_x and denom_y zero */
-		denom_x = coords[ closest_points_1 * nDim ]    - coords[ closest_points_0 * nDim ]; 
-		denom_y = coords[ closest_points_3 * nDim + 1] - coords[ closest_points_2 * nDim + 1];
-		gra10 = ( flowmap[ closest_points_1 * nDim ]     - flowmap[ closest_points_0 * nDim ] )     / denom_x; 			
-		gra20 = ( flowmap[ closest_points_3 * nDim ]     - flowmap[ closest_points_2 * nDim ] )     / denom_y;
-		gra11 = ( flowmap[ closest_points_1 * nDim + 1 ] - flowmap[ closest_points_0 * nDim + 1 ] ) / denom_x;
-		gra21 = ( flowmap[ closest_points_3 * nDim + 1 ] - flowmap[ closest_points_2 * nDim + 1 ] ) / denom_y;
+		log_sqrt[ip] = ftle_from_unit_gradient<NDIM, acc_t> ( T );
+		return;
 	}
-	else
+
+	for ( int axis = 0; axis < NDIM; axis++ )
 	{
-		if ( count == 3 )
+		int lo = closest[2 * axis], hi = closest[2 * axis + 1];
+		if ( ( MIN_NEIGHBOURS(NDIM) == 2 * NDIM ) || ( ( lo > -1 ) && ( hi > -1 ) ) )
 		{
-			// (i-1, j) and (i+1, j) 
-			if ( ( closest_points_0 > -1 ) && ( closest_points_1 > -1 ) )
-			{
-				denom_x = coords[ closest_points_1 * nDim ]    - coords[ closest_points_0 * nDim ]; 
-				gra10 = ( flowmap[ closest_points_1 * nDim ] - flowmap[ closest_points_0 * nDim ] ) / denom_x;					
-				gra20 = 1; //flowmap [ ip * nDim ]; //??
-				gra11 = ( flowmap[ closest_points_1 * nDim + 1 ] - flowmap[ closest_points_0 * nDim + 1 ] ) / denom_x;
-				gra21 = 1;//flowmap [ ip * nDim + 1];   //??
-			}
-			// (i-1, j) and (i+1, j) 
-			else
-			{
-				denom_y = coords[ closest_points_3 * nDim + 1] - coords[ closest_points_2 * nDim + 1];
-                gra10 = 1; //flowmap [ ip * nDim ];//??
-                gra20 = ( flowmap[ closest_points_3 * nDim ]     - flowmap[ closest_points_2 * nDim ] )     / denom_y;
-				gra11 = 1;// flowmap [ ip * nDim +1];//??
-				gra21 = ( flowmap[ closest_points_3 * nDim + 1 ] - flowmap[ closest_points_2 * nDim + 1 ] ) / denom_y;
-			}
+			acc_t inv = (acc_t) invDenom[ ip * NDIM + axis ];
+			for ( int comp = 0; comp < NDIM; comp++ )
+				gra[comp][axis] = ( (acc_t) flowmap[ hi * NDIM + comp ] - (acc_t) flowmap[ lo * NDIM + comp ] ) * inv;
 		}
 		else
-		{
-            gra10 = 1;//flowmap [ ip * nDim ];
-            gra20 = 1;//flowmap [ ip * nDim ];
-            gra11 = 1;//flowmap [ ip * nDim + 1];
-            gra21 = 1;//flowmap [ ip * nDim + 1];
-        }
-    }
-    ftle_matrix[0] = gra10 * gra10 + gra11 * gra11;
-    ftle_matrix[1] = gra10 * gra20 + gra11 * gra21;
-    ftle_matrix[2] = gra20 * gra10 + gra21 * gra11;
-    ftle_matrix[3] = gra20 * gra20 + gra21 * gra21;
-
-    gra10 = ftle_matrix[0];
-    gra11 = ftle_matrix[1];
-    gra20 = ftle_matrix[2];        
-    gra21 = ftle_matrix[3];
-
-    ftle_matrix[0] = gra10 * gra10 + gra11 * gra11;
-    ftle_matrix[1] = gra10 * gra20 + gra11 * gra21;
-    ftle_matrix[2] = gra20 * gra10 + gra21 * gra11;
-    ftle_matrix[3] = gra20 * gra20 + gra21 * gra21;
-
-    double A10 = ftle_matrix[0];
-    double A11 = ftle_matrix[1];
-    double A20 = ftle_matrix[2];        
-    double A21 = ftle_matrix[3];
-
-    double sq = sqrt(A21 * A21 + A10 * A10 - 2 * (A10 * A21) + 4 * (A11 * A20));
-    d_W_ei[0] = (A21 + A10 + sq) / 2;
-    d_W_ei[1] = (A21 + A10 - sq) / 2; 
-
-	//---------------- max---sqrt---log
-
-
-	double max = d_W_ei[0];	 //d_w[ip*nDim];      
-
-	if (d_W_ei[1] > max ) max = d_W_ei[1];
-
-	max = sqrt(max);
-	max = log (max);
-	log_sqrt[ip] = max / T;		
+			for ( int comp = 0; comp < NDIM; comp++ )
+				gra[comp][axis] = 1;
+	}
+	log_sqrt[ip] = ftle_from_gradient<acc_t> ( gra, T );
 }
 
-void compute_gradient_3D ( int ip, int nVertsPerFace, double *coords, double *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, double *log_sqrt, double T)
+/* Largest eigenvalue of the Cauchy-Green tensor of every lane: the 2D closed form, or the 3D tensors
+   and the batched eigen solver. The vector loops ask for SIMD_BATCH lanes, which float batches would
+   not fill at the widest vector length */
+template <typename acc_t>
+static inline void eigen_from_gradient_batch ( acc_t (&gra)[2][2][SIMD_BATCH], acc_t *res )
 {
-	int nDim = 3; 
-	int iface, nFaces, idxface, ivert;
-	int closest_points_0 = -1;
-	int closest_points_1 = -1;
-	int closest_points_2 = -1;
-	int closest_points_3 = -1;
-	int closest_points_4 = -1;
-	int closest_points_5 = -1;
-	int count = 0;
-	
-	int ivertex;
-	double denom_x, denom_y, denom_z;
-	double ftle_matrix[9];
-	double gra10, gra11, gra12, gra20, gra21, gra22, gra30, gra31, gra32;
-	nFaces  = (ip == 0) ? nFacesPerPoint[ip] : nFacesPerPoint[ip] - nFacesPerPoint[ip-1];
-
-        /* Find 6 closest points */
-	for ( iface = 0; (iface < nFaces) && (count < 6); iface++ )
+	#pragma omp simd simdlen(SIMD_BATCH)
+	for ( int l = 0; l < SIMD_BATCH; l++ )
+		res[l] = eigen_from_gradient_2D<acc_t> ( gra[0][0][l], gra[1][0][l], gra[0][1][l], gra[1][1][l] );
+}
+
+template <typename acc_t>
+static inline void eigen_from_gradient_batch ( acc_t (&gra)[3][3][SIMD_BATCH], acc_t *res )
+{
+	acc_t ten[6][SIMD_BATCH];
+
+	#pragma omp simd simdlen(SIMD_BATCH)
+	for ( int l = 0; l < SIMD_BATCH; l++ )
+		tensor_from_gradient_3D<acc_t> ( gra[0][0][l], gra[0][1][l], gra[0][2][l], gra[1][0][l], gra[1][1][l], gra[1][2][l], gra[2][0][l], gra[2][1][l], gra[2][2][l],
+			&ten[0][l], &ten[1][l], &ten[2][l], &ten[3][l], &ten[4][l], &ten[5][l] );
+
+	eigen_max_sym3_batch ( SIMD_BATCH, ten[0], ten[1], ten[2], ten[3], ten[4], ten[5], res );
+}
+
+/* Batched stencil kernel: the points of a batch of SIMD_BATCH consecutive points are gathered into lanes and
+   solved by branch-free loops; only log is left out of them and kept scalar, so that the results are identical
+   to those of the scalar kernels. Points without all their neighbours keep a unit gradient in their lanes: in 3D
+   that is their result, while in 2D they may still have a complete pair and take the scalar path */
+template <int NDIM, typename real_t, typename acc_t>
+void compute_ftle_stencil_batch ( int ip0, int n, int *stencil, double *invDenom, real_t *flowmap, real_t *log_sqrt, double T )
+{
+	int full[SIMD_BATCH];
+	acc_t gra[NDIM][NDIM][SIMD_BATCH], res[SIMD_BATCH];
+
+	for ( int l = 0; l < SIMD_BATCH; l++ )
+	{
+		int *closest = stencil + ( ip0 + l ) * 2 * NDIM;
+		int lane = ( l < n );
+		for ( int k = 0; k < 2 * NDIM; k++ )
+			lane = lane && ( closest[k] > -1 );
+		full[l] = lane;
+		for ( int axis = 0; axis < NDIM; axis++ )
+			for ( int comp = 0; comp < NDIM; comp++ )
+				gra[comp][axis][l] = lane ? ( (acc_t) flowmap[ closest[2*axis+1] * NDIM + comp ] - (acc_t) flowmap[ closest[2*axis] * NDIM + comp ] ) * (acc_t) invDenom[ ( ip0 + l ) * NDIM + axis ] : 1;
+	}
+
+	eigen_from_gradient_batch<acc_t> ( gra, res );
+
+	for ( int l = 0; l < n; l++ )
 	{
-		idxface = (ip == 0) ? facesPerPoint[iface] : facesPerPoint[nFacesPerPoint[ip-1] + iface];
-		for ( ivert = 0; (ivert < nVertsPerFace) && (count < 6); ivert++ )
+		if ( full[l] || ( NDIM == 3 ) )
+			log_sqrt[ip0 + l] = log(res[l]) / (acc_t) T;
+		else
+			compute_ftle_stencil<NDIM, real_t, acc_t> ( ip0 + l, stencil, invDenom, flowmap, log_sqrt, T );
+	}
+}
+
+/* Tile of the fastest varying axis (and the next one in 3D) streamed along the slowest axis */
+#define GRID_BLOCK_FAST 256
+#define GRID_BLOCK_MID  16
+
+int grid_nblocks ( grid_t *grid )
+{
+	int nblocks = ( grid->dims[grid->order[0]] + GRID_BLOCK_FAST - 1 ) / GRID_BLOCK_FAST;
+	if ( grid->nDim == 3 )
+		nblocks *= ( grid->dims[grid->order[1]] + GRID_BLOCK_MID - 1 ) / GRID_BLOCK_MID;
+	return nblocks;
+}
+
+template <typename real_t, typename acc_t>
+static inline void compute_ftle_grid_2D ( int ip, int ix, int iy, grid_t *grid, real_t *flowmap, real_t *log_sqrt, double T )
+{
+	int nDim = 2;
+	int sx = grid->strides[0], sy = grid->strides[1];
+	int has_x = ( ix > 0 ) && ( ix < grid->dims[0] - 1 );
+	int has_y = ( iy > 0 ) && ( iy < grid->dims[1] - 1 );
+	int count = 4 - ( ix == 0 ) - ( ix == grid->dims[0] - 1 ) - ( iy == 0 ) - ( iy == grid->dims[1] - 1 );
+	acc_t gra10 = 1, gra11 = 1, gra20 = 1, gra21 = 1;
+
+	/* Same neighbour rules as compute_gradient */
+	if ( has_x && ( count >= 3 ) )
+	{
+		gra10 = ( (acc_t) flowmap[ ( ip + sx ) * nDim ]     - (acc_t) flowmap[ ( ip - sx ) * nDim ] )     * (acc_t) grid->invDenom[0][ix];
+		gra11 = ( (acc_t) flowmap[ ( ip + sx ) * nDim + 1 ] - (acc_t) flowmap[ ( ip - sx ) * nDim + 1 ] ) * (acc_t) grid->invDenom[0][ix];
+	}
+	if ( has_y && ( count >= 3 ) )
+	{
+		gra20 = ( (acc_t) flowmap[ ( ip + sy ) * nDim ]     - (acc_t) flowmap[ ( ip - sy ) * nDim ] )     * (acc_t) grid->invDenom[1][iy];
+		gra21 = ( (acc_t) flowmap[ ( ip + sy ) * nDim + 1 ] - (acc_t) flowmap[ ( ip - sy ) * nDim + 1 ] ) * (acc_t) grid->invDenom[1][iy];
+	}
+	log_sqrt[ip] = ftle_from_gradient_2D<acc_t> ( gra10, gra11, gra20, gra21, T );
+}
+
+template <typename real_t, typename acc_t>
+static inline void compute_ftle_grid_3D ( int ip, int ix, int iy, int iz, grid_t *grid, real_t *flowmap, real_t *log_sqrt, double T )
+{
+	int nDim = 3;
+	int sx = grid->strides[0], sy = grid->strides[1], sz = grid->strides[2];
+
+	/* Same neighbour rules as compute_gradient */
+	if (   ( ix > 0 ) && ( ix < grid->dims[0] - 1 )
+		&& ( iy > 0 ) && ( iy < grid->dims[1] - 1 )
+		&& ( iz > 0 ) && ( iz < grid->dims[2] - 1 ) )
+	{
+		acc_t inv_x = (acc_t) grid->invDenom[0][ix];
+		acc_t inv_y = (acc_t) grid->invDenom[1][iy];
+		acc_t inv_z = (acc_t) grid->invDenom[2][iz];
+		log_sqrt[ip] = ftle_from_gradient_3D<acc_t> (
+			( (acc_t) flowmap[ ( ip + sx ) * nDim ]     - (acc_t) flowmap[ ( ip - sx ) * nDim ] )     * inv_x,
+			( (acc_t) flowmap[ ( ip + sy ) * nDim ]     - (acc_t) flowmap[ ( ip - sy ) * nDim ] )     * inv_y,
+			( (acc_t) flowmap[ ( ip + sz ) * nDim ]     - (acc_t) flowmap[ ( ip - sz ) * nDim ] )     * inv_z,
+			( (acc_t) flowmap[ ( ip + sx ) * nDim + 1 ] - (acc_t) flowmap[ ( ip - sx ) * nDim + 1 ] ) * inv_x,
+			( (acc_t) flowmap[ ( ip + sy ) * nDim + 1 ] - (acc_t) flowmap[ ( ip - sy ) * nDim + 1 ] ) * inv_y,
+			( (acc_t) flowmap[ ( ip + sz ) * nDim + 1 ] - (acc_t) flowmap[ ( ip - sz ) * nDim + 1 ] ) * inv_z,
+			( (acc_t) flowmap[ ( ip + sx ) * nDim + 2 ] - (acc_t) flowmap[ ( ip - sx ) * nDim + 2 ] ) * inv_x,
+			( (acc_t) flowmap[ ( ip + sy ) * nDim + 2 ] - (acc_t) flowmap[ ( ip - sy ) * nDim + 2 ] ) * inv_y,
+			( (acc_t) flowmap[ ( ip + sz ) * nDim + 2 ] - (acc_t) flowmap[ ( ip - sz ) * nDim + 2 ] ) * inv_z,
+			T );
+	}
+	else
+		log_sqrt[ip] = ftle_from_gradient_3D<acc_t> ( 1, 1, 1, 1, 1, 1, 1, 1, 1, T );
+}
+
+template <typename real_t, typename acc_t>
+void compute_ftle_grid_block ( int iblock, grid_t *grid, real_t *flowmap, real_t *log_sqrt, double T )
+{
+	int fast = grid->order[0], mid = grid->order[1], slow = grid->order[grid->nDim - 1];
+	int nbfast = ( grid->dims[fast] + GRID_BLOCK_FAST - 1 ) / GRID_BLOCK_FAST;
+	int f0 = ( iblock % nbfast ) * GRID_BLOCK_FAST;
+	int f1 = ( f0 + GRID_BLOCK_FAST < grid->dims[fast] ) ? f0 + GRID_BLOCK_FAST : grid->dims[fast];
+	int idx[3];
+
+	if ( grid->nDim == 2 )
+	{
+		for ( int j = 0; j < grid->dims[slow]; j++ )
 		{
-			ivertex = faces[idxface * nVertsPerFace + ivert];
-			if ( ivertex != ip )
+			idx[slow] = j;
+			for ( int i = f0; i < f1; i++ )
 			{
-            		/* (i-1, j, k) */
-				if (   (coords[ivertex * nDim + 1] == coords[ip * nDim + 1])
-					&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
-					&& (coords[ivertex * nDim]     <  coords[ip * nDim]) )
+				idx[fast] = i;
+				compute_ftle_grid_2D<real_t, acc_t> ( i + j * grid->strides[slow], idx[0], idx[1], grid, flowmap, log_sqrt, T );
+			}
+		}
+	}
+	else
+	{
+		int m0 = ( iblock / nbfast ) * GRID_BLOCK_MID;
+		int m1 = ( m0 + GRID_BLOCK_MID < grid->dims[mid] ) ? m0 + GRID_BLOCK_MID : grid->dims[mid];
+		for ( int k = 0; k < grid->dims[slow]; k++ )
+		{
+			idx[slow] = k;
+			for ( int j = m0; j < m1; j++ )
+			{
+				idx[mid] = j;
+				for ( int i = f0; i < f1; i++ )
 				{
-					if (closest_points_0 == -1)
-					{
-						closest_points_0 = ivertex;
-						count++;
-					}
+					idx[fast] = i;
+					compute_ftle_grid_3D<real_t, acc_t> ( i + j * grid->strides[mid] + k * grid->strides[slow], idx[0], idx[1], idx[2], grid, flowmap, log_sqrt, T );
 				}
-				else
-				{
-            			/* (i+1, j, k) */
-					if (   (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) 
-						&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
-						&& (coords[ivertex * nDim]     >  coords[ip * nDim]) )
-					{
-						if (closest_points_1 == -1)
-						{
-							closest_points_1 = ivertex;
-							count++;
-						}
-					}
-					else
-					{
-            				/* (i, j-1, k) */
-						if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
-							&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
-							&& (coords[ivertex * nDim + 1] <  coords[ip * nDim + 1]) ) 
-						{
-							if (closest_points_2 == -1)
-							{
-								closest_points_2 = ivertex;
-								count++;
-							}
-						}
-						else
-						{
-            					/* (i, j+1, k) */
-							if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
-								&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
-								&& (coords[ivertex * nDim + 1] >  coords[ip * nDim + 1]) )
-							{
-								if (closest_points_3 == -1)
-								{
-									closest_points_3 = ivertex;
-									count++;
-								}
-							}
-							else
-							{
-            						/* (i, j, k-1) */
-								if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
-									&& (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) 
-									&& (coords[ivertex * nDim + 2] <  coords[ip * nDim + 2]) )
-								{
-									if (closest_points_4 == -1)
-									{
-										closest_points_4 = ivertex;
-										count++;
-									}
-								}
-								else
-								{
-	            						/* (i, j, k+1) */
-									if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
-										&& (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) 
-										&& (coords[ivertex * nDim + 2] >  coords[ip * nDim + 2]) )
-									{
-										if (closest_points_5 == -1)
-										{
-											closest_points_5 = ivertex;
-											count++;
-										}
-									}
-								}
-							}
-						}
-					}
-				}			
 			}
 		}
-	}     
-	if ( count == 6 )
+	}
+}
+
+/* Ensemble kernels: K flowmaps interleaved as flowmap[( point * nDim + component ) * K + member], so the
+   neighbours of a point are resolved once and every gradient term is a contiguous run over the members.
+   Results go to log_sqrt[ point * K + member ]; each member may have its own integration time T[member] */
+void compute_ftle_ensemble_2D ( int ip, int K, int *stencil, double *invDenom, double *flowmap, double *log_sqrt, double *T )
+{
+	int nDim = 2;
+	int *closest = stencil + ip * 4;
+	int count = ( closest[0] > -1 ) + ( closest[1] > -1 ) + ( closest[2] > -1 ) + ( closest[3] > -1 );
+	int has_x = ( closest[0] > -1 ) && ( closest[1] > -1 ) && ( count >= 3 );
+	int has_y = ( closest[2] > -1 ) && ( closest[3] > -1 ) && ( count >= 3 );
+	double inv_x = has_x ? invDenom[ ip * nDim ] : 0;
+	double inv_y = has_y ? invDenom[ ip * nDim + 1 ] : 0;
+
+	/* Missing pairs read the point itself and keep the gradient term at 1, as compute_ftle_stencil */
+	double *x0 = flowmap + (long) ( has_x ? closest[0] : ip ) * nDim * K;
+	double *x1 = flowmap + (long) ( has_x ? closest[1] : ip ) * nDim * K;
+	double *y0 = flowmap + (long) ( has_y ? closest[2] : ip ) * nDim * K;
+	double *y1 = flowmap + (long) ( has_y ? closest[3] : ip ) * nDim * K;
+	double *res = log_sqrt + (long) ip * K;
+
+	#pragma omp simd
+	for ( int k = 0; k < K; k++ )
 	{
-		/* NOTE: take care with denom_x and denom_y zero */
-		denom_x = coords[ closest_points_1 * nDim ]    - coords[ closest_points_0 * nDim ]; 
-		denom_y = coords[ closest_points_3 * nDim + 1] - coords[ closest_points_2 * nDim + 1];
-		denom_z = coords[ closest_points_5 * nDim + 2] - coords[ closest_points_4 * nDim + 2];
-
-		gra10 = ( flowmap[ closest_points_1 * nDim ] - flowmap[ closest_points_0 * nDim ] ) / denom_x; 			
-		gra11 = ( flowmap[ closest_points_3 * nDim ] - flowmap[ closest_points_2 * nDim ] ) / denom_y;
-		gra12 = ( flowmap[ closest_points_5 * nDim ] - flowmap[ closest_points_4 * nDim ] ) / denom_z;
-
-		gra20 = ( flowmap[ closest_points_1 * nDim + 1] - flowmap[ closest_points_0 * nDim + 1] ) / denom_x; 			
-		gra21 = ( flowmap[ closest_points_3 * nDim + 1] - flowmap[ closest_points_2 * nDim + 1] ) / denom_y;
-		gra22 = ( flowmap[ closest_points_5 * nDim + 1] - flowmap[ closest_points_4 * nDim + 1] ) / denom_z;
-
-		gra30 = ( flowmap[ closest_points_1 * nDim + 2] - flowmap[ closest_points_0 * nDim + 2] ) / denom_x; 			
-		gra31 = ( flowmap[ closest_points_3 * nDim + 2] - flowmap[ closest_points_2 * nDim + 2] ) / denom_y;
-		gra32 = ( flowmap[ closest_points_5 * nDim + 2] - flowmap[ closest_points_4 * nDim + 2] ) / denom_z;
+		double gra10 = has_x ? ( x1[k]     - x0[k] )     * inv_x : 1;
+		double gra11 = has_x ? ( x1[K + k] - x0[K + k] ) * inv_x : 1;
+		double gra20 = has_y ? ( y1[k]     - y0[k] )     * inv_y : 1;
+		double gra21 = has_y ? ( y1[K + k] - y0[K + k] ) * inv_y : 1;
+		res[k] = eigen_from_gradient_2D ( gra10, gra11, gra20, gra21 );
 	}
-	else
+
+	for ( int k = 0; k < K; k++ )
+		res[k] = log(res[k]) / T[k];
+}
+
+/* Members per pass of the 3D ensemble kernel, bounded by its stack buffers */
+#define ENSEMBLE_CHUNK 64
+
+void compute_ftle_ensemble_3D ( int ip, int K, int *stencil, double *invDenom, double *flowmap, double *log_sqrt, double *T )
+{
+	int nDim = 3;
+	int *closest = stencil + ip * 6;
+	int full = ( closest[0] > -1 ) && ( closest[1] > -1 ) && ( closest[2] > -1 ) && ( closest[3] > -1 ) && ( closest[4] > -1 ) && ( closest[5] > -1 );
+	double *res = log_sqrt + (long) ip * K;
+	double *lo[3], *hi[3], inv[3];
+	double ten[6][ENSEMBLE_CHUNK];
+
+	for ( int axis = 0; axis < 3; axis++ )
 	{
-		gra10 = 1;
-		gra11 = 1;
-		gra12 = 1;
-		gra20 = 1;
-		gra21 = 1;
-		gra22 = 1;
-		gra30 = 1;
-		gra31 = 1;
-		gra32 = 1;
+		lo[axis]  = flowmap + (long) ( full ? closest[2*axis] : ip ) * nDim * K;
+		hi[axis]  = flowmap + (long) ( full ? closest[2*axis+1] : ip ) * nDim * K;
+		inv[axis] = full ? invDenom[ ip * nDim + axis ] : 0;
 	}
 
-        /* Tens */
-	ftle_matrix[0] = gra10 * gra10 + gra20 * gra20 + gra30 * gra30;
-	ftle_matrix[1] = gra10 * gra11 + gra20 * gra21 + gra30 * gra31;
-	ftle_matrix[2] = gra10 * gra12 + gra20 * gra22 + gra30 * gra32;
-    ftle_matrix[3] = ftle_matrix[1];
-    ftle_matrix[4] = gra11 * gra11 + gra21 * gra21 + gra31 * gra31;
-    ftle_matrix[5] = gra11 * gra12 + gra11 * gra22 + gra31 * gra32;
-    ftle_matrix[6] = ftle_matrix[2];
-    ftle_matrix[7] = ftle_matrix[5];
-    ftle_matrix[8] = gra12 * gra12 + gra22 * gra22 + gra32 * gra32;
-
-    // Store copy to later multiply by transpose 
-    gra10 = ftle_matrix[0];
-    gra11 = ftle_matrix[1];
-    gra12 = ftle_matrix[2];        
-    gra20 = ftle_matrix[3];
-    gra21 = ftle_matrix[4];
-    gra22 = ftle_matrix[5];
-    gra30 = ftle_matrix[6];        
-    gra31 = ftle_matrix[7];
-    gra32 = ftle_matrix[8];
-
-    // Matrix mult 
-    double A10 = gra10 * gra10 + gra11 * gra11 + gra12 * gra12;
-    double A11 = gra10 * gra20 + gra11 * gra21 + gra12 * gra22;
-    double A12 = gra10 * gra30 + gra11 * gra31 + gra12 * gra32;
-    double A20 = gra20 * gra10 + gra21 * gra11 + gra22 * gra12;
-    double A21 = gra20 * gra20 + gra21 * gra21 + gra22 * gra22;
-    double A22 = gra20 * gra30 + gra21 * gra31 + gra22 * gra32;
-    double A30 = gra30 * gra10 + gra31 * gra11 + gra32 * gra12;
-    double A31 = gra30 * gra20 + gra31 * gra21 + gra32 * gra22;
-    double A32 = gra30 * gra30 + gra31 * gra31 + gra32 * gra32;
-
-    double a = -1;
-    double b = A10 + A21 + A32;
-    double c = A12 * A30 + A22 * A31 + A11 * A20 - A10 * A21 - A10 * A32 - A21 * A32;
-    double d = A10 * A21 * A32 + A11 * A22 * A30 + A12 * A20 * A31 - A10 * A22 * A31 - A11 * A20 * A32 - A12 * A21 * A30;
-    double max = max_solve_3rd_degree_eq ( a, b, c, d );
-    max = sqrt(max);
-    max = log (max);
-    log_sqrt[ip] = max / T;
+	for ( int k0 = 0; k0 < K; k0 += ENSEMBLE_CHUNK )
+	{
+		int n = ( K - k0 < ENSEMBLE_CHUNK ) ? K - k0 : ENSEMBLE_CHUNK;
+
+		/* Same split as compute_ftle_stencil_batch: tensors and the batched eigen solver in vector loops, log scalar */
+		#pragma omp simd
+		for ( int l = 0; l < n; l++ )
+		{
+			int k = k0 + l;
+			double gra[9];
+			for ( int g = 0; g < 9; g++ )
+			{
+				/* Row g/3 of the gradient is the flowmap component, column g%3 the axis */
+				int comp = g / 3, axis = g % 3;
+				gra[g] = full ? ( hi[axis][comp * K + k] - lo[axis][comp * K + k] ) * inv[axis] : 1;
+			}
+			tensor_from_gradient_3D ( gra[0], gra[1], gra[2], gra[3], gra[4], gra[5], gra[6], gra[7], gra[8],
+				&ten[0][l], &ten[1][l], &ten[2][l], &ten[3][l], &ten[4][l], &ten[5][l] );
+		}
+
+		eigen_max_sym3_batch ( n, ten[0], ten[1], ten[2], ten[3], ten[4], ten[5], res + k0 );
+
+		for ( int l = 0; l < n; l++ )
+			res[k0 + l] = log(res[k0 + l]) / T[k0 + l];
+	}
 }
+
+/* Kernels in double precision, single precision, and single precision storage with double arithmetic,
+   for triangles in 2D and tetrahedra in 3D */
+#define INSTANTIATE_DIM_KERNELS(NDIM, NVERTS, real_t, acc_t) \
+	template void compute_gradient<NDIM, NVERTS, real_t, acc_t> ( int, double *, real_t *, int *, int *, int *, real_t *, double ); \
+	template void compute_gradient_coded<NDIM, NVERTS, real_t, acc_t> ( int, double *, real_t *, int *, int *, int *, real_t *, double ); \
+	template void compute_ftle_stencil<NDIM, real_t, acc_t> ( int, int *, double *, real_t *, real_t *, double ); \
+	template void compute_ftle_stencil_batch<NDIM, real_t, acc_t> ( int, int, int *, double *, real_t *, real_t *, double );
+
+#define INSTANTIATE_KERNELS(real_t, acc_t) \
+	INSTANTIATE_DIM_KERNELS(2, 3, real_t, acc_t) \
+	INSTANTIATE_DIM_KERNELS(3, 4, real_t, acc_t) \
+	template void compute_ftle_grid_block<real_t, acc_t> ( int, grid_t *, real_t *, real_t *, double );
+
+INSTANTIATE_KERNELS(double, double)
+INSTANTIATE_KERNELS(float, float)
+INSTANTIATE_KERNELS(float, double)
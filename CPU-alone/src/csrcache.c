@@ -0,0 +1,219 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "omp.h"
+
+#include "csrcache.h"
+
+#define FNV_OFFSET     0xcbf29ce484222325ULL
+#define FNV_PRIME      0x100000001b3ULL
+#define HASH_BLOCK     ( 1 << 20 )
+
+/* FNV-1a over 8-byte words, trailing bytes one by one */
+static uint64_t hash_block ( const unsigned char *data, size_t bytes, uint64_t h )
+{
+	size_t i, nWords = bytes / 8;
+	uint64_t w;
+
+	for ( i = 0; i < nWords; i++ )
+	{
+		memcpy( &w, data + i * 8, 8 );
+		h = ( h ^ w ) * FNV_PRIME;
+	}
+	for ( i = nWords * 8; i < bytes; i++ )
+		h = ( h ^ data[i] ) * FNV_PRIME;
+	return h;
+}
+
+/* Content hash of a whole file: blocks are hashed in parallel, then chained in order after the seed */
+uint64_t hash_input_file ( char *filename, uint64_t seed, int nth )
+{
+	struct stat st;
+	unsigned char *map;
+	uint64_t *blocks, h;
+	long nBlocks, ib;
+	size_t size;
+	int fd;
+
+	fd = open( filename, O_RDONLY );
+	if ( ( fd < 0 ) || ( fstat( fd, &st ) < 0 ) )
+	{
+		fprintf( stderr, "Error: cannot open %s\n", filename );
+		exit(-1);
+	}
+	size = st.st_size;
+	h = hash_block( (const unsigned char *) &size, sizeof(size), seed ^ FNV_OFFSET );
+	if ( size == 0 )
+	{
+		close(fd);
+		return h;
+	}
+	map = (unsigned char *) mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close(fd);
+	if ( map == MAP_FAILED )
+	{
+		fprintf( stderr, "Error: cannot map %s\n", filename );
+		exit(-1);
+	}
+	madvise( map, size, MADV_SEQUENTIAL );
+
+	nBlocks = ( size + HASH_BLOCK - 1 ) / HASH_BLOCK;
+	blocks  = (uint64_t *) malloc( sizeof(uint64_t) * nBlocks );
+	#pragma omp parallel for default(none) shared(map, size, nBlocks, blocks) num_threads(nth) schedule(static)
+	for ( ib = 0; ib < nBlocks; ib++ )
+	{
+		size_t start = (size_t) ib * HASH_BLOCK;
+		size_t bytes = ( size - start < HASH_BLOCK ) ? size - start : HASH_BLOCK;
+		blocks[ib] = hash_block( map + start, bytes, FNV_OFFSET );
+	}
+	h = hash_block( (const unsigned char *) blocks, sizeof(uint64_t) * nBlocks, h );
+
+	free(blocks);
+	munmap( map, size );
+	return h;
+}
+
+/* Map the cache read-only; any mismatch (missing, stale or damaged file) is a miss and returns 0 */
+int open_csr_cache ( char *filename, uint64_t key, int nDim, int nPoints, csr_cache_t *cache )
+{
+	csr_cache_header_t *hd;
+	struct stat st;
+	int fd, is;
+
+	cache->map    = NULL;
+	cache->header = NULL;
+	fd = open( filename, O_RDONLY );
+	if ( fd < 0 ) return 0;
+	if ( ( fstat( fd, &st ) < 0 ) || ( (size_t) st.st_size < sizeof(csr_cache_header_t) ) )
+	{
+		close(fd);
+		return 0;
+	}
+	cache->size = st.st_size;
+	cache->map  = mmap( NULL, cache->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close(fd);
+	if ( cache->map == MAP_FAILED )
+	{
+		cache->map = NULL;
+		return 0;
+	}
+	hd = (csr_cache_header_t *) cache->map;
+
+	if ( memcmp( hd->magic, CSR_CACHE_MAGIC, sizeof(CSR_CACHE_MAGIC) ) || ( hd->endian != MESH_FILE_ENDIAN ) ||
+	     ( hd->version != CSR_CACHE_VERSION ) || ( hd->nSections != CSR_NSECTIONS ) ||
+	     ( hd->key != key ) || ( hd->nDim != (uint32_t) nDim ) || ( hd->nPoints != (uint64_t) nPoints ) )
+	{
+		close_csr_cache( cache );
+		return 0;
+	}
+	for ( is = 0; is < CSR_NSECTIONS; is++ )
+	{
+		mesh_section_t *sec = &hd->sections[is];
+		if ( sec->offset == 0 )
+		{
+			/* Faces and CSR lists are always stored, the stencil table only by the stencil kernels */
+			if ( is <= CSR_SECTION_FACESPERPOINT )
+			{
+				close_csr_cache( cache );
+				return 0;
+			}
+			continue;
+		}
+		if ( !mesh_section_fits( sec, cache->size ) )
+		{
+			close_csr_cache( cache );
+			return 0;
+		}
+	}
+	cache->header = hd;
+	return 1;
+}
+
+void *csr_cache_section ( csr_cache_t *cache, int section, int *count )
+{
+	mesh_section_t *sec = &cache->header->sections[section];
+
+	if ( sec->offset == 0 ) return NULL;
+	if ( count != NULL ) *count = (int) sec->count;
+	return (char *) cache->map + sec->offset;
+}
+
+void close_csr_cache ( csr_cache_t *cache )
+{
+	if ( cache->map != NULL ) munmap( cache->map, cache->size );
+	cache->map    = NULL;
+	cache->header = NULL;
+}
+
+/* Written to a temporary file renamed over the old cache, so readers never see a partial one; returns 0 if it cannot be stored */
+int write_csr_cache ( char *filename, uint64_t key, int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces,
+                      int *nFacesPerPoint, int *facesPerPoint, int *stencil, double *invDenom, double csr_seconds, double stencil_seconds )
+{
+	csr_cache_header_t header;
+	uint64_t offset = sizeof(csr_cache_header_t);
+	char *tmpname = (char *) malloc( strlen(filename) + 32 );
+	FILE *file;
+
+	sprintf( tmpname, "%s.tmp%ld", filename, (long) getpid() );
+	file = fopen( tmpname, "wb" );
+	if ( file == NULL )
+	{
+		fprintf( stderr, "Warning: cannot create connectivity cache %s\n", filename );
+		free(tmpname);
+		return 0;
+	}
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, CSR_CACHE_MAGIC, sizeof(CSR_CACHE_MAGIC) );
+	header.endian          = MESH_FILE_ENDIAN;
+	header.version         = CSR_CACHE_VERSION;
+	header.nDim            = nDim;
+	header.nSections       = CSR_NSECTIONS;
+	header.key             = key;
+	header.nPoints         = nPoints;
+	header.csr_seconds     = csr_seconds;
+	header.stencil_seconds = ( stencil != NULL ) ? stencil_seconds : 0;
+	fwrite( &header, sizeof(header), 1, file );
+
+	offset = write_mesh_section( file, offset, &header.sections[CSR_SECTION_FACES],          faces,          nFaces,  nVertsPerFace, MESH_DTYPE_INT32,   sizeof(int) );
+	offset = write_mesh_section( file, offset, &header.sections[CSR_SECTION_NFACESPERPOINT], nFacesPerPoint, nPoints, 1,             MESH_DTYPE_INT32,   sizeof(int) );
+	offset = write_mesh_section( file, offset, &header.sections[CSR_SECTION_FACESPERPOINT],  facesPerPoint,  nFacesPerPoint[ nPoints - 1 ], 1, MESH_DTYPE_INT32, sizeof(int) );
+	offset = write_mesh_section( file, offset, &header.sections[CSR_SECTION_STENCIL],        stencil,        nPoints, 2 * nDim,      MESH_DTYPE_INT32,   sizeof(int) );
+	offset = write_mesh_section( file, offset, &header.sections[CSR_SECTION_INVDENOM],       invDenom,       nPoints, nDim,          MESH_DTYPE_FLOAT64, sizeof(double) );
+
+	if ( fseek( file, 0, SEEK_SET ) || ( fwrite( &header, sizeof(header), 1, file ) != 1 ) || fclose( file ) || rename( tmpname, filename ) )
+	{
+		fprintf( stderr, "Warning: cannot write connectivity cache %s\n", filename );
+		remove( tmpname );
+		free(tmpname);
+		return 0;
+	}
+	free(tmpname);
+	return 1;
+}
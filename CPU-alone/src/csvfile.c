@@ -0,0 +1,214 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <charconv>
+#include "omp.h"
+
+#include "csvfile.h"
+
+#define CSV_STAGE_POINTS  ( 1 << 20 )   /* points formatted before every round of writes */
+#define CSV_MAX_VALUE     352           /* longest "%f" of a double, sign and separator included */
+
+typedef struct CsvBuffer {
+	char    *data;
+	size_t   size;
+	size_t   capacity;
+} csv_buffer_t;
+
+/* Falls back to printf for infinities, NaNs and values whose 6 decimals do not fit in 52 bits */
+static inline char *format_fixed ( char *p, double x )
+{
+	double a = fabs(x);
+	double s = a * 1e6;
+
+	if ( !( s < 4503599627370496.0 ) )
+		return p + sprintf( p, "%f", x );
+
+	/* 
+	 * x * 10^6 = s + err exactly (fma), and the integer part of s is exact below
+	 * 2^52. err is less than half an ulp of s, so it only decides exact halves,
+	 * which printf rounds to even like the current rounding mode.
+	 */
+	double err = fma( a, 1e6, -s );
+	double fl  = floor(s);
+	double t   = s - fl;
+	uint64_t n = (uint64_t) fl;
+	if ( ( t > 0.5 ) || ( ( t == 0.5 ) && ( ( err > 0 ) || ( ( err == 0 ) && ( n & 1 ) ) ) ) ) n++;
+
+	char digits[24];
+	int  len = 0;
+	uint64_t ipart = n / 1000000, fpart = n % 1000000;
+	if ( signbit(x) ) *p++ = '-';
+	do { digits[len++] = '0' + ipart % 10; ipart /= 10; } while ( ipart );
+	while ( len ) *p++ = digits[--len];
+	*p++ = '.';
+	for ( int i = 5; i >= 0; i-- )
+	{
+		p[i] = '0' + fpart % 10;
+		fpart /= 10;
+	}
+	return p + 6;
+}
+
+/* Fewest significant digits that read back as x, in plain or exponent notation, whichever is shorter (C++17
+   std::to_chars, a Ryu-style conversion that neither parses nor depends on the locale). Standard libraries
+   without it get %.17g, which also reads back exactly but is not the shortest */
+static inline char *format_shortest ( char *p, double x )
+{
+#if defined(__cpp_lib_to_chars) && ( __cpp_lib_to_chars >= 201611L )
+	return std::to_chars( p, p + CSV_MAX_VALUE, x ).ptr;
+#else
+	return p + sprintf( p, "%.17g", x );
+#endif
+}
+
+/* Rows [first, last) of the file into the thread buffer; float values are written as the doubles they widen to */
+template <typename real_t>
+static void format_rows ( csv_buffer_t *buf, long first, long last, int nCols, real_t *values, int *iperm, int format )
+{
+	for ( long ii = first; ii < last; ii++ )
+	{
+		long row = ( iperm != NULL ) ? iperm[ii] : ii;
+		if ( buf->capacity - buf->size < (size_t) nCols * CSV_MAX_VALUE )
+		{
+			buf->capacity = 2 * buf->capacity + (size_t) nCols * CSV_MAX_VALUE;
+			buf->data = (char *) realloc( buf->data, buf->capacity );
+		}
+		char *p = buf->data + buf->size;
+		for ( int k = 0; k < nCols; k++ )
+		{
+			double x = values[row * nCols + k];
+			p = ( format == CSV_FORMAT_SHORTEST ) ? format_shortest( p, x ) : format_fixed( p, x );
+			*p++ = ( k < nCols - 1 ) ? ',' : '\n';
+		}
+		buf->size = p - buf->data;
+	}
+}
+
+static void write_all ( int fd, char *data, size_t size, char *filename )
+{
+	while ( size > 0 )
+	{
+		ssize_t n = write( fd, data, size );
+		if ( n <= 0 )
+		{
+			fprintf( stderr, "Error: cannot write %s\n", filename );
+			exit(-1);
+		}
+		data += n;
+		size -= n;
+	}
+}
+
+template <typename real_t>
+long long write_csv_file ( char *filename, int nPoints, int nCols, real_t *values, int *iperm, int format, int nth )
+{
+	csv_buffer_t *buffers = (csv_buffer_t *) calloc( nth, sizeof(csv_buffer_t) );
+	locale_t c_locale = newlocale( LC_ALL_MASK, "C", (locale_t) 0 );
+	long long written = 0;
+	int fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+
+	if ( fd < 0 )
+	{
+		fprintf( stderr, "Error: cannot create %s\n", filename );
+		exit(-1);
+	}
+
+	for ( long first = 0; first < nPoints; first += CSV_STAGE_POINTS )
+	{
+		long n = ( nPoints - first < CSV_STAGE_POINTS ) ? nPoints - first : CSV_STAGE_POINTS;
+
+		/* printf and strtod of the rare values that need them see the C locale whatever the application set */
+		#pragma omp parallel default(none) shared(buffers, c_locale, first, n, nCols, values, iperm, format, nth) num_threads(nth)
+		{
+			int t = omp_get_thread_num();
+			int nt = omp_get_num_threads();
+			locale_t previous = uselocale( c_locale );
+			buffers[t].size = 0;
+			format_rows( &buffers[t], first + n * t / nt, first + n * ( t + 1 ) / nt, nCols, values, iperm, format );
+			uselocale( previous );
+		}
+		for ( int t = 0; t < nth; t++ )
+		{
+			write_all( fd, buffers[t].data, buffers[t].size, filename );
+			written += buffers[t].size;
+			buffers[t].size = 0;
+		}
+	}
+	if ( close(fd) != 0 )
+	{
+		fprintf( stderr, "Error: cannot write %s\n", filename );
+		exit(-1);
+	}
+
+	for ( int t = 0; t < nth; t++ )
+		free( buffers[t].data );
+	free(buffers);
+	freelocale( c_locale );
+	return written;
+}
+
+template long long write_csv_file<double> ( char *filename, int nPoints, int nCols, double *values, int *iperm, int format, int nth );
+template long long write_csv_file<float>  ( char *filename, int nPoints, int nCols, float *values, int *iperm, int format, int nth );
+
+/* All the rows formatted into one buffer (allocated, *data), for writers that place it themselves; returns its size */
+size_t format_csv_rows ( int nPoints, int nCols, double *values, int *iperm, int format, int nth, char **data )
+{
+	csv_buffer_t *buffers = (csv_buffer_t *) calloc( nth, sizeof(csv_buffer_t) );
+	size_t       *offsets = (size_t *) calloc( nth + 1, sizeof(size_t) );
+	locale_t c_locale = newlocale( LC_ALL_MASK, "C", (locale_t) 0 );
+	char *out;
+
+	#pragma omp parallel default(none) shared(buffers, c_locale, nPoints, nCols, values, iperm, format, nth) num_threads(nth)
+	{
+		int t = omp_get_thread_num();
+		int nt = omp_get_num_threads();
+		locale_t previous = uselocale( c_locale );
+		format_rows( &buffers[t], (long) nPoints * t / nt, (long) nPoints * ( t + 1 ) / nt, nCols, values, iperm, format );
+		uselocale( previous );
+	}
+	for ( int t = 0; t < nth; t++ )
+		offsets[t + 1] = offsets[t] + buffers[t].size;
+
+	out = (char *) malloc( offsets[nth] + 1 );
+	#pragma omp parallel for default(none) shared(buffers, offsets, out, nth) num_threads(nth) schedule(static)
+	for ( int t = 0; t < nth; t++ )
+	{
+		if ( buffers[t].size ) memcpy( out + offsets[t], buffers[t].data, buffers[t].size );
+		free( buffers[t].data );
+	}
+
+	size_t size = offsets[nth];
+	free(buffers);
+	free(offsets);
+	freelocale( c_locale );
+	*data = out;
+	return size;
+}
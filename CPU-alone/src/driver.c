@@ -0,0 +1,713 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "omp.h"
+
+#include "driver.h"
+#include "preprocess.h"
+#include "flowmap.h"
+#include "gmsh.h"
+#include "vtkfile.h"
+#include "csvfile.h"
+#include "eigen.h"
+
+/* Swap in the prefetched snapshot (see swap_prefetched_flowmap) and return it in the mesh point order:
+   renumbered into flowmap_perm if the points are, as read otherwise */
+static double *next_snapshot ( flowmap_prefetch_t *pf, uvaftle_mesh_t *mesh, int nDim, double **flowmap_read, mesh_file_t *mf, double **spare,
+                               double *flowmap_perm, timing_t *timing, int nth )
+{
+	timing_begin( timing );
+	*flowmap_read = swap_prefetched_flowmap( pf, *flowmap_read, mf, spare );
+	timing_end( timing, "prefetch_wait", 1, 0 );
+	timing_add( timing, "read_flowmap", pf->seconds, 1, pf->bytes );
+	if ( flowmap_perm == NULL ) return *flowmap_read;
+	uvaftle_mesh_permute( mesh, nDim, *flowmap_read, flowmap_perm );
+	timing_end( timing, "reorder", nth, 0 );
+	return flowmap_perm;
+}
+
+/* Map the cache of file if it was stored for the very same coordinates and faces contents (and point order);
+   a NULL file leaves it unused */
+void lookup_connectivity_cache ( connectivity_cache_t *cc, char *file, char *coords_file, char *faces_file, int nDim, int nPoints, int reorder,
+                                 timing_t *timing, int nth )
+{
+	cc->file           = file;
+	cc->key            = 0;
+	cc->nDim           = nDim;
+	cc->nPoints        = nPoints;
+	cc->cache.map      = NULL;
+	cc->hit            = 0;
+	cc->stencil_cached = 0;
+	cc->lookup_seconds = 0;
+	if ( file == NULL ) return;
+
+	timing_begin( timing );
+	cc->key = hash_input_file( faces_file, hash_input_file( coords_file, nDim + ( reorder != UVAFTLE_REORDER_NONE ) * 256, nth ), nth );
+	cc->hit = open_csr_cache( file, cc->key, nDim, nPoints, &cc->cache );
+	cc->lookup_seconds = timing_end( timing, "cache_lookup", nth, timing_file_size( coords_file ) + timing_file_size( faces_file ) );
+}
+
+/* Assign faces to vertices (CSR lists) and resolve the axis neighbours of the stencil kernels, starting from whatever
+   the cache holds, then store what this run built for the next ones. csr_seconds is the time spent reading the faces */
+void build_mesh_adjacency ( uvaftle_mesh_t *mesh, int flags, connectivity_cache_t *cc, double csr_seconds, timing_t *timing, int nth )
+{
+	int     kernel = uvaftle_mesh_kernel( mesh ), use_grid = ( uvaftle_mesh_grid( mesh ) != NULL );
+	int     use_stencil = ( flags & UVAFTLE_BUILD_STENCIL ) || ( kernel == UVAFTLE_KERNEL_STENCIL ) || ( kernel == UVAFTLE_KERNEL_SIMD );
+	int    *faces, *nFacesPerPoint, *facesPerPoint, *stencil = NULL, nFaces;
+	double *invDenom = NULL, stencil_seconds = 0;
+
+	/* Faces (already in the point order of the run), connectivity and stencil table, if stored, used straight from the mapped cache */
+	if ( cc->hit )
+	{
+		faces          = (int *) csr_cache_section( &cc->cache, CSR_SECTION_FACES, &nFaces );
+		nFacesPerPoint = (int *) csr_cache_section( &cc->cache, CSR_SECTION_NFACESPERPOINT, NULL );
+		facesPerPoint  = (int *) csr_cache_section( &cc->cache, CSR_SECTION_FACESPERPOINT, NULL );
+		if ( use_stencil )
+		{
+			stencil  = (int *)    csr_cache_section( &cc->cache, CSR_SECTION_STENCIL, NULL );
+			invDenom = (double *) csr_cache_section( &cc->cache, CSR_SECTION_INVDENOM, NULL );
+			cc->stencil_cached = ( stencil != NULL ) && ( invDenom != NULL );
+		}
+		if ( uvaftle_mesh_set_faces( mesh, nFaces, faces ) ) exit(-1);
+		uvaftle_mesh_set_adjacency( mesh, nFacesPerPoint, facesPerPoint, cc->stencil_cached ? stencil : NULL, cc->stencil_cached ? invDenom : NULL );
+	}
+
+	if ( uvaftle_build_adjacency( mesh, flags ) ) exit(-1);
+	if ( !use_grid && !cc->hit )
+	{
+		double count_scan = uvaftle_phase_seconds( mesh, "count_scan" ), csr_build = uvaftle_phase_seconds( mesh, "csr_build" );
+		timing_add( timing, "count_scan", count_scan, ( flags & UVAFTLE_BUILD_QUADRATIC ) ? 1 : nth, 0 );
+		timing_add( timing, "csr_build", csr_build, nth, 0 );
+		csr_seconds += count_scan + csr_build;
+	}
+	uvaftle_mesh_adjacency( mesh, &nFacesPerPoint, &facesPerPoint, &stencil, &invDenom );
+	if ( ( stencil != NULL ) && !cc->stencil_cached )
+	{
+		stencil_seconds = uvaftle_phase_seconds( mesh, "stencil_table" );
+		timing_add( timing, "stencil_table", stencil_seconds, nth, 0 );
+	}
+
+	/* Nothing new to store on a hit that already had the stencil table, or when it is not wanted */
+	if ( ( cc->file != NULL ) && !( cc->hit && ( cc->stencil_cached || stencil == NULL ) ) )
+	{
+		timing_begin( timing );
+		if ( cc->hit ) csr_seconds = cc->cache.header->csr_seconds;
+		faces = uvaftle_mesh_faces( mesh, &nFaces );
+		if ( write_csr_cache( cc->file, cc->key, cc->nDim, cc->nPoints, nFaces, cc->nDim + 1, faces, nFacesPerPoint, facesPerPoint,
+		                      stencil, invDenom, csr_seconds, stencil_seconds ) )
+			timing_end( timing, "cache_write", 1, timing_file_size( cc->file ) );
+	}
+}
+
+/* What building the reused data took in the run that stored it, minus hashing and mapping */
+double connectivity_cache_saving ( connectivity_cache_t *cc )
+{
+	if ( !cc->hit ) return 0;
+	return cc->cache.header->csr_seconds + ( cc->stencil_cached ? cc->cache.header->stencil_seconds : 0 ) - cc->lookup_seconds;
+}
+
+void close_connectivity_cache ( connectivity_cache_t *cc )
+{
+	if ( cc->cache.map ) close_csr_cache( &cc->cache );
+	cc->hit = 0;
+}
+
+void init_ftle_solver ( ftle_solver_t *s, uvaftle_mesh_t *mesh, int nDim, int nPoints, ftle_options_t *opts, int nMembers, int miss_fd, int branch_fd )
+{
+	s->mesh          = mesh;
+	s->nth           = opts->ftle_sched.nth;
+	s->ensemble      = opts->ensemble;
+	s->nMembers      = nMembers;
+	s->precision     = opts->precision;
+	s->report        = opts->precision_report;
+	s->flowmap32     = NULL;
+	s->ftle32        = NULL;
+	s->miss_fd       = miss_fd;
+	s->branch_fd     = branch_fd;
+	s->misses        = 0;
+	s->branch_misses = 0;
+	s->seconds       = 0;
+	s->wall          = 0;
+	s->dev_max       = 0;
+	s->dev_sum       = 0;
+	if ( s->precision != UVAFTLE_PRECISION_DOUBLE )
+	{
+		s->flowmap32 = (float *) malloc( sizeof(float) * nPoints * nDim );
+		s->ftle32    = (float *) malloc( sizeof(float) * nPoints );
+	}
+}
+
+/* Float copy of a snapshot for the reduced precisions, from the flowmap as read (the library renumbers it) */
+void narrow_snapshot ( ftle_solver_t *s, double *flowmap, timing_t *timing )
+{
+	struct timeval snap_clock, end_clock;
+
+	gettimeofday(&snap_clock, NULL);
+	timing_begin( timing );
+	uvaftle_narrow_flowmap( s->mesh, flowmap, s->flowmap32 );
+	timing_end( timing, "narrow", s->nth, 0 );
+	gettimeofday(&end_clock, NULL);
+	s->wall += (end_clock.tv_sec - snap_clock.tv_sec) + (end_clock.tv_usec - snap_clock.tv_usec)/1000000.0;
+}
+
+/* FTLE of one snapshot (or of all the ensemble members, one t_eval each) into ftle, in the mesh point order. The reduced
+   precisions solve the float copy of narrow_snapshot into s->ftle32; only with the report are the double flowmap and
+   ftle used, for the double kernel run out of the FTLE time */
+void solve_snapshot ( ftle_solver_t *s, double *flowmap, double *t_eval, double *ftle, timing_t *timing )
+{
+	struct timeval snap_clock, end_clock;
+	long long      misses;
+
+	gettimeofday(&snap_clock, NULL);
+	timing_begin( timing );
+	timing_counter_start( s->miss_fd );
+	timing_counter_start( s->branch_fd );
+	if ( s->ensemble )
+		uvaftle_compute_ensemble( s->mesh, s->nMembers, flowmap, t_eval, ftle );
+	else if ( s->precision != UVAFTLE_PRECISION_DOUBLE )
+		uvaftle_compute_float( s->mesh, s->flowmap32, t_eval[0], s->ftle32, s->precision );
+	else
+		uvaftle_compute( s->mesh, flowmap, t_eval[0], ftle );
+
+	gettimeofday(&end_clock, NULL);
+	misses = timing_counter_stop( s->miss_fd );
+	s->misses = ( ( misses < 0 ) || ( s->misses < 0 ) ) ? -1 : s->misses + misses;
+	misses = timing_counter_stop( s->branch_fd );
+	s->branch_misses = ( ( misses < 0 ) || ( s->branch_misses < 0 ) ) ? -1 : s->branch_misses + misses;
+	s->seconds += timing_end( timing, "ftle", s->nth, 0 );
+	s->wall    += (end_clock.tv_sec - snap_clock.tv_sec) + (end_clock.tv_usec - snap_clock.tv_usec)/1000000.0;
+
+	if ( s->report )
+	{
+		timing_begin( timing );
+		uvaftle_compute( s->mesh, flowmap, t_eval[0], ftle );
+		timing_end( timing, "ftle_reference", s->nth, 0 );
+		uvaftle_precision_deviation( s->mesh, s->ftle32, ftle, &s->dev_max, &s->dev_sum );
+	}
+}
+
+void free_ftle_solver ( ftle_solver_t *s )
+{
+	free( s->flowmap32 );
+	free( s->ftle32 );
+	timing_counter_close( s->miss_fd );
+	timing_counter_close( s->branch_fd );
+	s->flowmap32 = NULL;
+	s->ftle32    = NULL;
+}
+
+/* Arguments, hardware counters, flowmap series and FTLE_* options of a run */
+void init_ftle_driver ( ftle_driver_t *d, int nDim, char *coords_file, char *faces_file, char *flowmap_spec, double t_eval, int nth, int print2file )
+{
+	d->nDim          = nDim;
+	d->nVertsPerFace = nDim + 1;   // 2D: faces are triangles, 3D: faces (volumes) are tetrahedrons
+	d->nth           = nth;
+	d->print2file    = print2file;
+	d->coords_file   = coords_file;
+	d->faces_file    = faces_file;
+	d->flowmap_spec  = flowmap_spec;
+	d->nMembers      = 1;
+	d->csr_seconds   = 0;
+	d->spare         = NULL;
+	d->perm          = NULL;
+	d->iperm         = NULL;
+	d->flowmap_perm  = NULL;
+	d->logSqrt       = NULL;
+	timing_init( &d->timing );
+
+	/* Cache and branch-miss counters of the FTLE kernel, opened before any thread is started so that all of them are counted */
+	d->miss_fd   = timing_counter_open( TIMING_CACHE_MISSES );
+	d->branch_fd = timing_counter_open( TIMING_BRANCH_MISSES );
+
+	/* One or many flowmaps solved against the same mesh, as members of an ensemble with FTLE_ENSEMBLE */
+	read_flowmap_series( flowmap_spec, t_eval, &d->series );
+	read_ftle_options( nDim, nth, faces_file, d->series.n, &d->opts );
+	d->nSnapshots = d->opts.ensemble ? 1 : d->series.n;
+}
+
+/* Coordinates from Python-generated files, UVaFTLE mesh files or Gmsh files, and the mesh built on them */
+static void read_mesh_points ( ftle_driver_t *d, gmsh_file_t *gmsh )
+{
+	int nDim = d->nDim, nth = d->nth;
+
+	printf("\tReading mesh points coordinates...        "); 
+	fflush(stdout);
+	timing_begin( &d->timing );
+	if ( is_mesh_file( d->coords_file ) )
+	{
+		open_mesh_file( d->coords_file, &d->mf_coords );
+		d->coords = (double *) mesh_file_section( &d->mf_coords, MESH_SECTION_COORDS, nDim, &d->nPoints );
+		timing_end( &d->timing, "read_coords", 1, (long long) sizeof(double) * d->nPoints * nDim );
+	}
+	else if ( is_gmsh_file( d->coords_file ) )
+	{
+		open_gmsh_file( d->coords_file, gmsh );
+		d->nPoints = read_gmsh_nodes( gmsh, nDim, &d->coords, nth );
+		timing_end( &d->timing, "read_coords", nth, timing_file_size( d->coords_file ) );
+	}
+	else
+	{
+		d->nPoints = read_coordinates( d->coords_file, nDim, &d->coords, nth ); 
+		timing_end( &d->timing, "read_coords", nth, timing_file_size( d->coords_file ) );
+	}
+	printf("DONE\n"); 
+	fflush(stdout);
+
+	/* Structured lattices need neither faces nor adjacency: the library detects them */
+	timing_begin( &d->timing );
+	d->mesh = uvaftle_mesh_create( nDim, d->nPoints, d->coords, d->opts.kernel, d->opts.grid_env ? d->opts.grid_dims : NULL, nth );
+	if ( d->mesh == NULL ) exit(-1);
+	if ( d->opts.kernel == UVAFTLE_KERNEL_AUTO || d->opts.kernel == UVAFTLE_KERNEL_GRID )
+		timing_end( &d->timing, "detect_grid", nth, 0 );
+	d->grid = uvaftle_mesh_grid( d->mesh );
+
+	/* Kernel that runs: "auto" is resolved by the library, to grid or stencil */
+	d->kernel_name = d->opts.ensemble ? "ensemble" : uvaftle_kernel_name( uvaftle_mesh_kernel( d->mesh ) );
+}
+
+/* Faces, unless the points form a lattice or the connectivity cache holds them */
+static void read_mesh_faces ( ftle_driver_t *d, gmsh_file_t *gmsh )
+{
+	int nDim = d->nDim, nth = d->nth;
+
+	printf("\tReading mesh faces vertices...            "); 
+	fflush(stdout);
+	timing_begin( &d->timing );
+	if ( d->grid != NULL )
+	{
+		printf("SKIPPED (%s lattice)\n", ( nDim == 2 ) ? "2D" : "3D");
+		d->faces  = NULL;
+		d->nFaces = 0;
+	}
+	else if ( d->cc.hit )
+	{
+		/* Handed to the mesh with the rest of the cached connectivity */
+		printf("CACHED (%s)\n", d->cc.file);
+		csr_cache_section( &d->cc.cache, CSR_SECTION_FACES, &d->nFaces );
+		d->faces = NULL;
+	}
+	else if ( is_mesh_file( d->faces_file ) )
+	{
+		open_mesh_file( d->faces_file, &d->mf_faces );
+		d->faces = (int *) mesh_file_section( &d->mf_faces, MESH_SECTION_FACES, d->nVertsPerFace, &d->nFaces );
+		d->csr_seconds = timing_end( &d->timing, "read_faces", 1, (long long) sizeof(int) * d->nFaces * d->nVertsPerFace );
+	}
+	else if ( is_gmsh_file( d->faces_file ) )
+	{
+		/* Same .msh file for points and faces: its node tags are already mapped */
+		if ( gmsh->data && strcmp( d->coords_file, d->faces_file ) )
+			close_gmsh_file( gmsh );
+		if ( gmsh->data == NULL )
+			open_gmsh_file( d->faces_file, gmsh );
+		d->nFaces = read_gmsh_elements( gmsh, nDim, &d->faces, nth );
+		d->csr_seconds = timing_end( &d->timing, "read_faces", nth, timing_file_size( d->faces_file ) );
+	}
+	else
+	{
+		d->nFaces = read_faces( d->faces_file, nDim, d->nVertsPerFace, &d->faces, nth ); 
+		d->csr_seconds = timing_end( &d->timing, "read_faces", nth, timing_file_size( d->faces_file ) );
+	}
+	if ( gmsh->data ) close_gmsh_file( gmsh );
+	if ( ( d->grid == NULL ) && !d->cc.hit ) printf("DONE\n"); 
+	fflush(stdout);
+}
+
+/* First flowmap of the series, read or mapped; only allocated when it is integrated from the velocity field instead */
+static void read_first_flowmap ( ftle_driver_t *d )
+{
+	int   nDim = d->nDim, nPoints = d->nPoints;
+	char *file = d->series.files[0];
+
+	printf("\tReading mesh flowmap (x, y[, z])...       "); 
+	fflush(stdout);
+	timing_begin( &d->timing );
+	if ( d->opts.vel_file != NULL )
+	{
+		printf("SKIPPED (integrated from %s)\n", d->opts.vel_file);
+		d->flowmap = (double*) malloc( sizeof(double) * nPoints * nDim ); 
+	}
+	else if ( is_mesh_file( file ) )
+	{
+		int nFlowmap;
+		open_mesh_file( file, &d->mf_flowmap );
+		d->flowmap = (double *) mesh_file_section( &d->mf_flowmap, MESH_SECTION_FLOWMAP, nDim, &nFlowmap );
+		if ( nFlowmap != nPoints )
+		{
+			fprintf( stderr, "Error: flowmap has %d points but the mesh has %d\n", nFlowmap, nPoints );
+			exit(-1);
+		}
+		timing_end( &d->timing, "read_flowmap", 1, (long long) sizeof(double) * nPoints * nDim );
+	}
+	else
+	{
+		d->flowmap = (double*) malloc( sizeof(double) * nPoints * nDim ); 
+		read_flowmap ( file, nDim, nPoints, d->flowmap, d->nth );
+		timing_end( &d->timing, "read_flowmap", d->nth, timing_file_size( file ) );
+	}
+	if ( d->opts.vel_file == NULL ) printf("DONE\n\n"); 
+	fflush(stdout);
+}
+
+/* Advect the mesh points through the sampled velocity field from t0 (first sample by default) to t0 + t_eval */
+static void integrate_first_flowmap ( ftle_driver_t *d )
+{
+	int         nDim = d->nDim, nPoints = d->nPoints, nth = d->nth;
+	velocity_t  velocity;
+	grid_t      vel_grid;
+	double      t0;
+	char       *env;
+
+	printf("\tReading velocity times...                 "); 
+	fflush(stdout);
+	timing_begin( &d->timing );
+	velocity.nTimes  = read_times( d->opts.times_file, &velocity.times, nth );
+	velocity.nPoints = nPoints;
+	timing_end( &d->timing, "read_times", nth, timing_file_size( d->opts.times_file ) );
+	printf("DONE\n"); 
+	printf("\tReading velocity field...                 "); 
+	fflush(stdout);
+	velocity.vel = (double*) malloc( sizeof(double) * nPoints * nDim * velocity.nTimes ); 
+	read_velocity( d->opts.vel_file, nDim, nPoints, velocity.nTimes, velocity.vel, nth );
+	timing_end( &d->timing, "read_velocity", nth, timing_file_size( d->opts.vel_file ) );
+	printf("DONE\n\n"); 
+
+	/* The velocity is sampled at the mesh points, which must form a lattice */
+	velocity.grid = d->grid;
+	if ( d->grid == NULL )
+	{
+		if ( !detect_structured_grid( nDim, nPoints, d->coords, d->opts.grid_env ? d->opts.grid_dims : NULL, &vel_grid, nth ) )
+		{
+			fprintf( stderr, "Error: the velocity field must be sampled on a rectilinear lattice of mesh points\n" );
+			exit(-1);
+		}
+		velocity.grid = &vel_grid;
+	}
+	t0 = ( ( env = getenv("FTLE_T0") ) != NULL ) ? atof(env) : velocity.times[0];
+
+	apply_schedule( &d->opts.preproc_sched, d->opts.integrator.method == FLOWMAP_RK4 ? "Flowmap RK4" : "Flowmap RK45" );
+	fflush(stdout);
+	timing_begin( &d->timing );
+	compute_flowmap( &velocity, &d->opts.integrator, nPoints, d->coords, t0, d->series.t_eval[0], d->flowmap, d->opts.preproc_sched.nth );
+	timing_end( &d->timing, "flowmap", d->opts.preproc_sched.nth, 0 );
+	printf("DONE\n"); 
+
+	/* Optionally keep it as a flowmap file for later runs */
+	if ( ( env = getenv("FTLE_FLOWMAP_OUT") ) != NULL )
+	{
+		FILE *fp_f = fopen(env, "w");
+		if ( fp_f == NULL )
+		{
+			fprintf( stderr, "Error: cannot open %s\n", env );
+			exit(-1);
+		}
+		for ( int ii = 0; ii < nPoints * nDim; ii++ )
+			fprintf(fp_f, "%.17g\n", d->flowmap[ii]);
+		timing_end( &d->timing, "write_flowmap", 1, ftell(fp_f) );
+		fclose(fp_f);
+	}
+
+	if ( d->grid == NULL ) free_structured_grid( &vel_grid );
+	free(velocity.times);
+	free(velocity.vel);
+}
+
+/* Coordinates, faces and the first flowmap (or all the ensemble members) */
+void read_ftle_inputs ( ftle_driver_t *d )
+{
+	gmsh_file_t gmsh;
+
+	d->mf_coords.map = d->mf_faces.map = d->mf_flowmap.map = NULL;
+	gmsh.data = NULL;
+	printf("\nReading input data\n\n"); 
+	fflush(stdout);
+	read_mesh_points( d, &gmsh );
+
+	/* The cache is only valid for the very same coordinates and faces contents */
+	lookup_connectivity_cache( &d->cc, ( d->grid != NULL ) ? NULL : d->opts.cache_file, d->coords_file, d->faces_file, d->nDim, d->nPoints,
+	                           d->opts.reorder, &d->timing, d->nth );
+	read_mesh_faces( d, &gmsh );
+	read_first_flowmap( d );
+	if ( d->opts.vel_file != NULL )
+		integrate_first_flowmap( d );
+
+	/* Ensemble: the members are interleaved point by point, so that one pass over the mesh solves all of them */
+	if ( d->opts.ensemble )
+	{
+		d->nMembers = d->series.n;
+		printf("\tReading %d ensemble members...             ", d->nMembers);
+		fflush(stdout);
+		d->flowmap = read_ensemble_members( &d->series, d->nDim, d->nPoints, d->flowmap, &d->mf_flowmap, &d->timing, d->nth );
+		printf("DONE\n\n");
+	}
+	d->flowmap_read = d->flowmap;
+}
+
+/* Release the faces read from the input (the mesh may hold its own copy) */
+static void release_input_faces ( ftle_driver_t *d )
+{
+	if ( d->mf_faces.map ) close_mesh_file( &d->mf_faces ); else free(d->faces);
+	d->mf_faces.map = NULL;
+	d->faces        = NULL;
+}
+
+/* Renumbering, adjacency and the solver of the snapshots */
+void prepare_ftle_mesh ( ftle_driver_t *d )
+{
+	int            nDim = d->nDim, nPoints = d->nPoints, build_flags;
+	ftle_options_t *opts = &d->opts;
+	int            keep_double = ( opts->precision == UVAFTLE_PRECISION_DOUBLE ) || opts->precision_report;
+
+	/* Mesh, adjacency and kernels live in libuvaftle; faces read from the input (not from the cache) are set now,
+	   in the original point order */
+	uvaftle_mesh_set_threads( d->mesh, opts->preproc_sched.nth, opts->ftle_sched.nth );
+	if ( ( d->faces != NULL ) && uvaftle_mesh_set_faces( d->mesh, d->nFaces, d->faces ) ) exit(-1);
+
+	/* Renumber the points along a space-filling curve: the mesh keeps its own renumbered coordinates and faces, the
+	   input ones are released, and the results are written back in the original order. The float copies of the
+	   reduced precisions are renumbered as they are narrowed, so a double copy is only made for the double kernel */
+	if ( ( d->grid == NULL ) && ( opts->reorder != UVAFTLE_REORDER_NONE ) )
+	{
+		printf("\tRenumbering points (Morton order)...       ");
+		fflush(stdout);
+		timing_begin( &d->timing );
+		uvaftle_mesh_reorder( d->mesh, opts->reorder );
+		uvaftle_mesh_permutation( d->mesh, &d->perm, &d->iperm );
+		if ( d->mf_coords.map ) close_mesh_file( &d->mf_coords ); else free(d->coords);
+		d->mf_coords.map = NULL;
+		d->coords = uvaftle_mesh_coords( d->mesh );
+		release_input_faces( d );
+
+		if ( keep_double )
+		{
+			d->flowmap_perm = (double *) malloc( sizeof(double) * nPoints * nDim * d->nMembers );
+			uvaftle_mesh_permute( d->mesh, nDim * d->nMembers, d->flowmap_read, d->flowmap_perm );
+			d->flowmap = d->flowmap_perm;
+		}
+		timing_end( &d->timing, "reorder", opts->preproc_sched.nth, 0 );
+		printf("DONE\n\n");
+	}
+
+	/* Allocate additional memory at the CPU: the reduced precisions keep float results, and double ones for the report */
+	if ( keep_double )
+		d->logSqrt = (double*) malloc( sizeof(double) * nPoints * d->nMembers );   
+	init_ftle_solver( &d->solver, d->mesh, nDim, nPoints, opts, d->nMembers, d->miss_fd, d->branch_fd );
+
+	/* The faces are kept until the cache and VTU writers are done with them */
+	build_flags = UVAFTLE_BUILD_KEEP_FACES | ( opts->ensemble ? UVAFTLE_BUILD_STENCIL : 0 ) | ( strcmp(opts->preproc, "quadratic") ? 0 : UVAFTLE_BUILD_QUADRATIC );
+
+	/* On a lattice the neighbours follow from the indices: there is no preprocessing */
+	if ( d->grid != NULL )
+	{
+		printf("\nComputing Preproc (structured %d", d->grid->dims[0]);
+		for ( int k = 1; k < nDim; k++ ) printf("x%d", d->grid->dims[k]);
+		printf(" lattice)...                     ");
+	}
+	else if ( d->cc.hit )
+		printf("\nComputing Preproc (connectivity cache)...                     ");
+	else if ( strcmp(opts->preproc, "linear") == 0 )
+	{
+		/* The count-and-scan builder partitions the faces statically by construction */
+		printf("\nComputing Preproc (linear CSR builder, %d threads)...                     ", opts->preproc_sched.nth);
+	}
+	else
+		apply_schedule( &opts->preproc_sched, "Preproc" );
+	gettimeofday(&d->preproc_clock, NULL);
+
+	build_mesh_adjacency( d->mesh, build_flags, &d->cc, d->csr_seconds, &d->timing, opts->preproc_sched.nth );
+
+	/* The VTU cells are the faces, so they are kept in that case */
+	if ( ( d->grid == NULL ) && ( d->print2file != 2 ) )
+	{
+		int *stencil;
+		uvaftle_mesh_adjacency( d->mesh, NULL, NULL, &stencil, NULL );
+		if ( stencil != NULL )
+		{
+			uvaftle_mesh_drop_faces( d->mesh );
+			release_input_faces( d );
+		}
+	}
+}
+
+/* One output per snapshot in series mode, one row of nMembers values per point in ensemble mode */
+static void write_snapshot_result ( ftle_driver_t *d, int is )
+{
+	char       result_file[64];
+	const char *ext = ( d->print2file == 2 ) ? "vtu" : "csv";
+	long long  written;
+
+	printf("\nWriting result in output file...                  ");
+	fflush(stdout);
+	timing_begin( &d->timing );
+	if      ( d->opts.ensemble )  sprintf( result_file, "ftle_result_ensemble.%s", ext );
+	else if ( d->nSnapshots > 1 ) sprintf( result_file, "ftle_result_%04d.%s", is, ext );
+	else                          sprintf( result_file, "ftle_result.%s", ext );
+	/* Original point order; the reduced precisions write their float results */
+	if ( ( d->print2file == 2 ) && ( d->solver.ftle32 != NULL ) )
+		written = write_vtu_file( result_file, d->nDim, d->nPoints, d->coords, d->nFaces, d->nVertsPerFace, uvaftle_mesh_faces( d->mesh, NULL ), d->grid,
+		                          d->nMembers, d->solver.ftle32, d->perm, d->iperm, d->opts.vtu_level, d->nth );
+	else if ( d->print2file == 2 )
+		written = write_vtu_file( result_file, d->nDim, d->nPoints, d->coords, d->nFaces, d->nVertsPerFace, uvaftle_mesh_faces( d->mesh, NULL ), d->grid,
+		                          d->nMembers, d->logSqrt, d->perm, d->iperm, d->opts.vtu_level, d->nth );
+	else if ( d->solver.ftle32 != NULL )
+		written = write_csv_file( result_file, d->nPoints, d->nMembers, d->solver.ftle32, d->iperm, d->opts.csv_format, d->nth );
+	else
+		written = write_csv_file( result_file, d->nPoints, d->nMembers, d->logSqrt, d->iperm, d->opts.csv_format, d->nth );
+	timing_end( &d->timing, "write", d->nth, written );
+	printf("DONE\n\n");
+	printf("--------------------------------------------------------\n");
+	fflush(stdout);
+}
+
+/* Release the current double snapshot; its buffer is kept as the spare one when another read follows */
+static void release_snapshot ( ftle_driver_t *d, int more )
+{
+	if ( d->mf_flowmap.map ) close_mesh_file( &d->mf_flowmap );
+	else if ( more && ( d->spare == NULL ) ) d->spare = d->flowmap_read;
+	else free(d->flowmap_read);
+	d->mf_flowmap.map = NULL;
+	d->flowmap_read   = NULL;
+	d->flowmap        = NULL;
+}
+
+/* Solve every snapshot with the mesh, adjacency and thread team kept resident; the next flowmap is read meanwhile */
+void solve_ftle_snapshots ( ftle_driver_t *d )
+{
+	flowmap_prefetch_t prefetch;
+
+	gettimeofday(&d->ftle_clock, NULL);
+	for ( int is = 0; is < d->nSnapshots; is++ )
+	{
+		/* Reduced precisions: the double snapshot is narrowed first and, without the report, released at once, its
+		   buffer taking the next read */
+		if ( d->opts.precision != UVAFTLE_PRECISION_DOUBLE )
+		{
+			narrow_snapshot( &d->solver, d->flowmap_read, &d->timing );
+			if ( !d->opts.precision_report )
+				release_snapshot( d, is + 1 < d->nSnapshots );
+		}
+		if ( is + 1 < d->nSnapshots )
+			start_flowmap_prefetch( &prefetch, d->series.files[is + 1], d->nDim, d->nPoints, d->spare );
+		if ( d->nSnapshots > 1 )
+			printf("\nSnapshot %d/%d: %s (t_eval %g)", is + 1, d->nSnapshots, d->series.files[is], d->series.t_eval[is]);
+
+		/* Solve FTLE */
+		fflush(stdout);
+		apply_schedule( &d->opts.ftle_sched, "FTLE" );
+		solve_snapshot( &d->solver, d->flowmap, d->series.t_eval + is, d->logSqrt, &d->timing );
+		printf("DONE\n\n");
+		printf("--------------------------------------------------------\n");
+		fflush(stdout);
+
+		/* Print numerical results */
+		if ( d->print2file )
+			write_snapshot_result( d, is );
+
+		/* Swap in the prefetched snapshot; a buffer no longer in use is kept for the following one */
+		if ( is + 1 < d->nSnapshots )
+			d->flowmap = next_snapshot( &prefetch, d->mesh, d->nDim, &d->flowmap_read, &d->mf_flowmap, &d->spare, d->flowmap_perm, &d->timing,
+			                            d->opts.preproc_sched.nth );
+	}
+}
+
+/* Execution times, throughput and counters on the standard output, and the FTLE_TIMING record */
+void report_ftle_run ( ftle_driver_t *d )
+{
+	ftle_options_t *opts = &d->opts;
+	ftle_solver_t  *solver = &d->solver;
+	const char     *order = ( d->perm != NULL ) ? "Morton" : "original";
+	double          time;
+	char            sched_str[32];
+
+	time = (d->ftle_clock.tv_sec - d->preproc_clock.tv_sec) + (d->ftle_clock.tv_usec - d->preproc_clock.tv_usec)/1000000.0;
+	printf("\nExecution time (ms) with %d threads: %f\n\n", opts->preproc_sched.nth, time*1000);
+	time = solver->wall;
+	printf("\nExecution time (ms) with %d threads: %f\n\n", opts->ftle_sched.nth, time*1000);
+	printf("FTLE throughput (Mpoints/s) with %s kernel: %f\n\n", d->kernel_name, ( time > 0 ) ? (double) d->nPoints * d->series.n / time / 1e6 : 0.0);
+	if ( opts->precision_report )
+		printf("FTLE deviation of %s precision from double: max %e, mean %e\n\n", uvaftle_precision_name(opts->precision), solver->dev_max,
+		       solver->dev_sum / ( (double) d->nPoints * d->nSnapshots ));
+	if ( solver->misses >= 0 )
+		printf("FTLE cache misses with %s point order: %lld\n\n", order, solver->misses);
+	else
+		printf("FTLE cache misses with %s point order: not available\n\n", order);
+	if ( solver->branch_misses >= 0 )
+		printf("FTLE branch misses with %s kernel: %lld\n\n", d->kernel_name, solver->branch_misses);
+	else
+		printf("FTLE branch misses with %s kernel: not available\n\n", d->kernel_name);
+	if ( d->cc.hit )
+		printf("Connectivity cache hit (%s): %f s saved\n\n", d->cc.file, connectivity_cache_saving( &d->cc ));
+	else if ( d->cc.file != NULL )
+		printf("Connectivity cache miss: stored in %s\n\n", d->cc.file);
+	printf("--------------------------------------------------------\n");
+	fflush(stdout);
+
+	if ( opts->timing_log == NULL ) return;
+	timing_set_int( &d->timing, "nDim", d->nDim );
+	timing_set_int( &d->timing, "nPoints", d->nPoints );
+	timing_set_int( &d->timing, "nFaces", d->nFaces );
+	timing_set_int( &d->timing, "threads", d->nth );
+	timing_set_string( &d->timing, "kernel", d->kernel_name );
+	timing_set_string( &d->timing, "preproc", ( d->grid != NULL ) ? "none" : opts->preproc );
+	timing_set_string( &d->timing, "eigen", ( eigen_get_solver() == EIGEN_JACOBI ) ? "jacobi" : "trig" );
+	timing_set_string( &d->timing, "precision", uvaftle_precision_name(opts->precision) );
+	if ( opts->precision_report )
+	{
+		timing_set_double( &d->timing, "precision_max_deviation", solver->dev_max );
+		timing_set_double( &d->timing, "precision_mean_deviation", solver->dev_sum / ( (double) d->nPoints * d->nSnapshots ) );
+	}
+	schedule_name( &opts->preproc_sched, sched_str, sizeof(sched_str) );
+	timing_set_string( &d->timing, "schedule_preproc", sched_str );
+	schedule_name( &opts->ftle_sched, sched_str, sizeof(sched_str) );
+	timing_set_string( &d->timing, "schedule_ftle", sched_str );
+	timing_set_string( &d->timing, "coords_file", d->coords_file );
+	timing_set_string( &d->timing, "faces_file", d->faces_file );
+	timing_set_string( &d->timing, "flowmap_file", d->flowmap_spec );
+	timing_set_int( &d->timing, "snapshots", d->nSnapshots );
+	timing_set_int( &d->timing, "members", d->nMembers );
+	timing_set_string( &d->timing, "reorder", uvaftle_reorder_name( ( d->perm != NULL ) ? opts->reorder : UVAFTLE_REORDER_NONE ) );
+	timing_set_int( &d->timing, "ftle_cache_misses", solver->misses );
+	timing_set_int( &d->timing, "ftle_branch_misses", solver->branch_misses );
+	timing_set_double( &d->timing, "points_per_second", ( solver->seconds > 0 ) ? (double) d->nPoints * d->series.n / solver->seconds : 0.0 );
+	timing_set_string( &d->timing, "cache", ( d->cc.file == NULL ) ? "off" : ( d->cc.hit ? "hit" : "miss" ) );
+	timing_set_double( &d->timing, "cache_saved_seconds", connectivity_cache_saving( &d->cc ) );
+	timing_report( &d->timing, opts->timing_log );
+}
+
+/* Free memory: renumbered coordinates belong to the mesh */
+void free_ftle_driver ( ftle_driver_t *d )
+{
+	if ( d->mf_coords.map )  close_mesh_file( &d->mf_coords );  else if ( d->perm == NULL ) free(d->coords);
+	uvaftle_mesh_free( d->mesh );
+	close_connectivity_cache( &d->cc );
+	free_ftle_options( &d->opts );
+	if ( d->mf_flowmap.map ) close_mesh_file( &d->mf_flowmap ); else free(d->flowmap_read);
+	free(d->flowmap_perm);
+	free_ftle_solver( &d->solver );
+	free(d->spare);
+	free_flowmap_series( &d->series );
+	release_input_faces( d );
+	free(d->logSqrt);
+}
@@ -0,0 +1,206 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <string.h>
+#include <math.h>
+
+#include "eigen.h"
+
+/* Solver of eigen_max_sym3 and eigen_max_sym3_batch, shared by the whole process */
+static int eigen_solver = EIGEN_TRIG;
+
+int eigen_solver_id ( const char *name )
+{
+	if ( !strcmp(name, "trig") )   return EIGEN_TRIG;
+	if ( !strcmp(name, "jacobi") ) return EIGEN_JACOBI;
+	return -1;
+}
+
+void eigen_set_solver ( int solver )
+{
+	eigen_solver = solver;
+}
+
+int eigen_get_solver ( void )
+{
+	return eigen_solver;
+}
+
+/* Mean eigenvalue q, deviation p and half the determinant r of (A - q I) / p, whose eigenvalues
+   x solve x^3 - 3x - 2r = 0, so that those of A are q + p x. An isotropic tensor gives p = r = 0.
+   A is first divided by its largest entry, so that no square overflows, also in single precision */
+template <typename real_t>
+static inline void eigen_shift_scale ( real_t a00, real_t a01, real_t a02, real_t a11, real_t a12, real_t a22, real_t *pq, real_t *pp, real_t *pr )
+{
+	real_t m = fabs(a00);
+	m = ( fabs(a01) > m ) ? fabs(a01) : m;
+	m = ( fabs(a02) > m ) ? fabs(a02) : m;
+	m = ( fabs(a11) > m ) ? fabs(a11) : m;
+	m = ( fabs(a12) > m ) ? fabs(a12) : m;
+	m = ( fabs(a22) > m ) ? fabs(a22) : m;
+	real_t im = ( m > 0 ) ? 1 / m : 0;
+	a00 *= im; a01 *= im; a02 *= im; a11 *= im; a12 *= im; a22 *= im;
+
+	real_t q   = ( a00 + a11 + a22 ) / 3;
+	real_t b00 = a00 - q;
+	real_t b11 = a11 - q;
+	real_t b22 = a22 - q;
+	real_t p2  = ( b00 * b00 + b11 * b11 + b22 * b22 + 2 * ( a01 * a01 + a02 * a02 + a12 * a12 ) ) / 6;
+	real_t p   = sqrt(p2);
+	real_t ip  = ( p2 > 0 ) ? 1 / p : 0;
+
+	b00 *= ip; b11 *= ip; b22 *= ip;
+	real_t c01 = a01 * ip, c02 = a02 * ip, c12 = a12 * ip;
+	real_t r = ( b00 * ( b11 * b22 - c12 * c12 ) - c01 * ( c01 * b22 - c12 * c02 ) + c02 * ( c01 * c12 - b11 * c02 ) ) / 2;
+
+	*pq = q * m;
+	*pp = p * m;
+	*pr = ( r < -1 ) ? -1 : ( ( r > 1 ) ? 1 : r );
+}
+
+template <typename real_t>
+static inline real_t max_sym3_trig ( real_t a00, real_t a01, real_t a02, real_t a11, real_t a12, real_t a22 )
+{
+	real_t q, p, r;
+	eigen_shift_scale ( a00, a01, a02, a11, a12, a22, &q, &p, &r );
+	return q + 2 * p * cos( acos(r) / 3 );
+}
+
+/* Sweeps bound the loop for non-finite input; a 3x3 tensor converges in 4 or 5 */
+#define JACOBI_MAX_SWEEPS 16
+
+/* tol: squared off-diagonal norm, relative to the diagonal one, below which the tensor is diagonal */
+template <typename real_t>
+static inline real_t max_sym3_jacobi ( real_t a00, real_t a01, real_t a02, real_t a11, real_t a12, real_t a22, real_t tol )
+{
+	real_t a[3][3] = { { a00, a01, a02 }, { a01, a11, a12 }, { a02, a12, a22 } };
+
+	for ( int sweep = 0; sweep < JACOBI_MAX_SWEEPS; sweep++ )
+	{
+		real_t off  = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		real_t diag = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+		if ( !( off > tol * diag ) )
+			break;
+
+		for ( int ip = 0; ip < 2; ip++ )
+		{
+			for ( int iq = ip + 1; iq < 3; iq++ )
+			{
+				real_t apq = a[ip][iq];
+				if ( apq == 0 )
+					continue;
+
+				/* Rotation that zeroes a[ip][iq], with the smaller angle for stability */
+				real_t theta = ( a[iq][iq] - a[ip][ip] ) / ( 2 * apq );
+				real_t t = 1 / ( fabs(theta) + sqrt( theta * theta + 1 ) );
+				if ( theta < 0 ) t = -t;
+				real_t c = 1 / sqrt( t * t + 1 );
+				real_t s = t * c;
+
+				int ir = 3 - ip - iq;
+				real_t arp = a[ir][ip], arq = a[ir][iq];
+				a[ip][ip] -= t * apq;
+				a[iq][iq] += t * apq;
+				a[ip][iq] = a[iq][ip] = 0;
+				a[ir][ip] = a[ip][ir] = c * arp - s * arq;
+				a[ir][iq] = a[iq][ir] = s * arp + c * arq;
+			}
+		}
+	}
+
+	real_t max = ( a[0][0] > a[1][1] ) ? a[0][0] : a[1][1];
+	return ( max > a[2][2] ) ? max : a[2][2];
+}
+
+/* Newton steps on the largest root of x^3 - 3x - 2r = 0, written for d = x - 1 in [0, 1] and
+   s = sqrt(1 + r) as d^2 (d + 3) = 2 s^2. The root is simple in d, so every step squares its
+   relative error, also for the double root x = 1 (r = -1) of a degenerate spectrum, and the
+   initial guess is within 1% of it */
+#define EIGEN_NEWTON_STEPS 3
+
+template <typename real_t>
+static inline void max_sym3_batch ( int n, real_t *a00, real_t *a01, real_t *a02, real_t *a11, real_t *a12, real_t *a22, real_t *lmax, real_t tol )
+{
+	if ( eigen_solver == EIGEN_JACOBI )
+	{
+		for ( int l = 0; l < n; l++ )
+			lmax[l] = max_sym3_jacobi ( a00[l], a01[l], a02[l], a11[l], a12[l], a22[l], tol );
+		return;
+	}
+
+	/* simdlen: the stencil kernels solve batches of 8 tensors, which in float would not fill one full-width vector */
+	#pragma omp simd simdlen(8)
+	for ( int l = 0; l < n; l++ )
+	{
+		real_t q, p, r;
+		eigen_shift_scale ( a00[l], a01[l], a02[l], a11[l], a12[l], a22[l], &q, &p, &r );
+		real_t s = sqrt( 1 + r );
+
+		/* Exact at both ends of the interval: d = sqrt(2/3) s near r = -1, and d = 1 at r = 1 */
+		real_t d = (real_t) 0.816496580927726 * s / ( 1 + (real_t) 0.109389636000917 * s );
+		for ( int it = 0; it < EIGEN_NEWTON_STEPS; it++ )
+		{
+			real_t g  = d * d * ( d + 3 ) - 2 * s * s;
+			real_t gp = d * ( 3 * d + 6 );
+			d = ( d > 0 ) ? d - g / gp : 0;
+		}
+		lmax[l] = q + p * ( 1 + d );
+	}
+}
+
+/* Jacobi tolerances: well below the squared machine epsilon of each type */
+#define JACOBI_TOL_DOUBLE 1e-36
+#define JACOBI_TOL_FLOAT  1e-18f
+
+double eigen_max_sym3 ( double a00, double a01, double a02, double a11, double a12, double a22 )
+{
+	if ( eigen_solver == EIGEN_JACOBI )
+		return max_sym3_jacobi ( a00, a01, a02, a11, a12, a22, JACOBI_TOL_DOUBLE );
+	return max_sym3_trig ( a00, a01, a02, a11, a12, a22 );
+}
+
+float eigen_max_sym3 ( float a00, float a01, float a02, float a11, float a12, float a22 )
+{
+	if ( eigen_solver == EIGEN_JACOBI )
+		return max_sym3_jacobi ( a00, a01, a02, a11, a12, a22, JACOBI_TOL_FLOAT );
+	return max_sym3_trig ( a00, a01, a02, a11, a12, a22 );
+}
+
+double eigen_max_sym3_trig ( double a00, double a01, double a02, double a11, double a12, double a22 )
+{
+	return max_sym3_trig ( a00, a01, a02, a11, a12, a22 );
+}
+
+double eigen_max_sym3_jacobi ( double a00, double a01, double a02, double a11, double a12, double a22 )
+{
+	return max_sym3_jacobi ( a00, a01, a02, a11, a12, a22, JACOBI_TOL_DOUBLE );
+}
+
+void eigen_max_sym3_batch ( int n, double *a00, double *a01, double *a02, double *a11, double *a12, double *a22, double *lmax )
+{
+	max_sym3_batch ( n, a00, a01, a02, a11, a12, a22, lmax, JACOBI_TOL_DOUBLE );
+}
+
+void eigen_max_sym3_batch ( int n, float *a00, float *a01, float *a02, float *a11, float *a12, float *a22, float *lmax )
+{
+	max_sym3_batch ( n, a00, a01, a02, a11, a12, a22, lmax, JACOBI_TOL_FLOAT );
+}
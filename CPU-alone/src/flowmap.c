@@ -0,0 +1,256 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "omp.h"
+
+#include "preprocess.h"
+#include "flowmap.h"
+
+/* Dormand-Prince 5(4) coefficients, as scipy's RK45 */
+static const double rk45_c[7] = { 0, 1.0/5, 3.0/10, 4.0/5, 8.0/9, 1, 1 };
+static const double rk45_a[6][5] = {
+	{ 0 },
+	{ 1.0/5 },
+	{ 3.0/40, 9.0/40 },
+	{ 44.0/45, -56.0/15, 32.0/9 },
+	{ 19372.0/6561, -25360.0/2187, 64448.0/6561, -212.0/729 },
+	{ 9017.0/3168, -355.0/33, 46732.0/5247, 49.0/176, -5103.0/18656 } };
+static const double rk45_b[6] = { 35.0/384, 0, 500.0/1113, 125.0/192, -2187.0/6784, 11.0/84 };
+static const double rk45_e[7] = { -71.0/57600, 0, 71.0/16695, -71.0/1920, 17253.0/339200, -22.0/525, 1.0/40 };
+
+#define RK45_SAFETY     0.9
+#define RK45_MIN_FACTOR 0.2
+#define RK45_MAX_FACTOR 10.0
+
+/* First line of the file is nTimes, then one time per line */
+int read_times ( char *filename, double **times, int nth )
+{
+	int nTimes = read_coordinates( filename, 1, times, nth );
+	if ( nTimes < 2 )
+	{
+		fprintf( stderr, "Error: %s must hold at least 2 times\n", filename );
+		exit(-1);
+	}
+	for ( int i = 1; i < nTimes; i++ )
+	{
+		if ( !( (*times)[i] > (*times)[i-1] ) )
+		{
+			fprintf( stderr, "Error: times in %s must be strictly increasing\n", filename );
+			exit(-1);
+		}
+	}
+	return nTimes;
+}
+
+/* nDim components per point, all the points of the first time, then of the next one... (no header) */
+void read_velocity ( char *filename, int nDim, int nPoints, int nTimes, double *vel, int nth )
+{
+	read_flowmap( filename, nDim, nPoints * nTimes, vel, nth );
+}
+
+/* Cell [*i, *i+1] of a monotonic axis holding x and the weight of its upper end; 0 if x is outside */
+static inline int locate ( double *axis, int n, double x, int *i, double *w )
+{
+	int lo = 0, hi = n - 1;
+	int increasing = ( n == 1 ) || ( axis[n-1] > axis[0] );
+
+	if ( n == 1 )
+	{
+		*i = 0;
+		*w = 0;
+		return ( x == axis[0] );
+	}
+	if ( increasing ? !( ( x >= axis[0] ) && ( x <= axis[n-1] ) ) : !( ( x <= axis[0] ) && ( x >= axis[n-1] ) ) )
+		return 0;
+	while ( hi - lo > 1 )
+	{
+		int mid = ( lo + hi ) / 2;
+		if ( increasing ? ( axis[mid] <= x ) : ( axis[mid] >= x ) ) lo = mid; else hi = mid;
+	}
+	*i = lo;
+	*w = ( x - axis[lo] ) / ( axis[lo+1] - axis[lo] );
+	return 1;
+}
+
+/* Multilinear interpolation in space and time */
+void interpolate_velocity ( velocity_t *v, double t, double *x, double *u )
+{
+	grid_t *g = v->grid;
+	int nDim = g->nDim, it, idx[3];
+	double wt, w[3];
+
+	for ( int d = 0; d < nDim; d++ ) u[d] = 0;
+	if ( !locate( v->times, v->nTimes, t, &it, &wt ) ) return;
+	for ( int d = 0; d < nDim; d++ )
+		if ( !locate( g->axis[d], g->dims[d], x[d], &idx[d], &w[d] ) ) return;
+
+	for ( int corner = 0; corner < ( 1 << nDim ); corner++ )
+	{
+		double wc = 1;
+		long node = 0;
+		for ( int d = 0; d < nDim; d++ )
+		{
+			int upper = ( corner >> d ) & 1;
+			wc   *= upper ? w[d] : 1 - w[d];
+			node += (long) ( idx[d] + ( upper && ( g->dims[d] > 1 ) ) ) * g->strides[d];
+		}
+		if ( wc == 0 ) continue;
+		for ( int k = 0; k < 2; k++ )
+		{
+			double wk = wc * ( k ? wt : 1 - wt );
+			if ( wk == 0 ) continue;
+			double *vk = v->vel + ( (long) ( it + k ) * v->nPoints + node ) * nDim;
+			for ( int d = 0; d < nDim; d++ )
+				u[d] += wk * vk[d];
+		}
+	}
+}
+
+static void advect_rk4 ( velocity_t *v, int nsteps, double *x, double t0, double T )
+{
+	int nDim = v->grid->nDim;
+	double h = T / nsteps;
+	double k1[3], k2[3], k3[3], k4[3], y[3];
+
+	for ( int s = 0; s < nsteps; s++ )
+	{
+		double t = t0 + s * h;
+		interpolate_velocity( v, t, x, k1 );
+		for ( int d = 0; d < nDim; d++ ) y[d] = x[d] + h / 2 * k1[d];
+		interpolate_velocity( v, t + h / 2, y, k2 );
+		for ( int d = 0; d < nDim; d++ ) y[d] = x[d] + h / 2 * k2[d];
+		interpolate_velocity( v, t + h / 2, y, k3 );
+		for ( int d = 0; d < nDim; d++ ) y[d] = x[d] + h * k3[d];
+		interpolate_velocity( v, t + h, y, k4 );
+		for ( int d = 0; d < nDim; d++ )
+			x[d] += h / 6 * ( k1[d] + 2 * k2[d] + 2 * k3[d] + k4[d] );
+	}
+}
+
+/* Root mean square of a[d] / scale[d] */
+static inline double rms_norm ( int nDim, double *a, double *scale )
+{
+	double sum = 0;
+	for ( int d = 0; d < nDim; d++ ) sum += ( a[d] / scale[d] ) * ( a[d] / scale[d] );
+	return sqrt( sum / nDim );
+}
+
+/* Adaptive Dormand-Prince with the step size control and initial step of scipy's solve_ivp */
+static void advect_rk45 ( velocity_t *v, double rtol, double atol, double *x, double t0, double T )
+{
+	int nDim = v->grid->nDim, rejected;
+	double dir = ( T < 0 ) ? -1 : 1, t = t0, t_end = t0 + T;
+	double k[7][3], y[3], ynew[3], err[3], scale[3], h;
+
+	if ( T == 0 ) return;
+
+	/* Initial step */
+	interpolate_velocity( v, t, x, k[0] );
+	for ( int d = 0; d < nDim; d++ ) scale[d] = atol + fabs(x[d]) * rtol;
+	{
+		double d0 = rms_norm( nDim, x, scale ), d1 = rms_norm( nDim, k[0], scale ), d2, h0, h1;
+		h0 = ( ( d0 < 1e-5 ) || ( d1 < 1e-5 ) ) ? 1e-6 : 0.01 * d0 / d1;
+		for ( int d = 0; d < nDim; d++ ) y[d] = x[d] + h0 * dir * k[0][d];
+		interpolate_velocity( v, t + h0 * dir, y, k[1] );
+		for ( int d = 0; d < nDim; d++ ) err[d] = k[1][d] - k[0][d];
+		d2 = rms_norm( nDim, err, scale ) / h0;
+		h1 = ( ( d1 <= 1e-15 ) && ( d2 <= 1e-15 ) ) ? fmax( 1e-6, h0 * 1e-3 ) : pow( 0.01 / fmax( d1, d2 ), 1.0 / 5 );
+		h  = fmin( 100 * h0, h1 );
+	}
+
+	while ( dir * ( t_end - t ) > 0 )
+	{
+		double min_step = 10 * fabs( nextafter( t, dir * INFINITY ) - t );
+		if ( h < min_step ) h = min_step;
+		if ( h > fabs( t_end - t ) ) h = fabs( t_end - t );
+		rejected = 0;
+
+		for ( ;; )
+		{
+			double hs = h * dir, norm;
+
+			/* Stages 2 to 6 from k[0], then the 5th order solution and the FSAL stage */
+			for ( int s = 1; s < 6; s++ )
+			{
+				for ( int d = 0; d < nDim; d++ )
+				{
+					y[d] = x[d];
+					for ( int j = 0; j < s; j++ ) y[d] += hs * rk45_a[s][j] * k[j][d];
+				}
+				interpolate_velocity( v, t + rk45_c[s] * hs, y, k[s] );
+			}
+			for ( int d = 0; d < nDim; d++ )
+			{
+				ynew[d] = x[d];
+				for ( int j = 0; j < 6; j++ ) ynew[d] += hs * rk45_b[j] * k[j][d];
+			}
+			interpolate_velocity( v, t + hs, ynew, k[6] );
+
+			for ( int d = 0; d < nDim; d++ )
+			{
+				err[d] = 0;
+				for ( int j = 0; j < 7; j++ ) err[d] += rk45_e[j] * k[j][d];
+				err[d]  *= hs;
+				scale[d] = atol + fmax( fabs(x[d]), fabs(ynew[d]) ) * rtol;
+			}
+			norm = rms_norm( nDim, err, scale );
+
+			if ( ( norm < 1 ) || ( h <= min_step ) )
+			{
+				double factor = ( norm == 0 ) ? RK45_MAX_FACTOR : fmin( RK45_MAX_FACTOR, RK45_SAFETY * pow( norm, -1.0 / 5 ) );
+				if ( rejected ) factor = fmin( 1, factor );
+				t = ( h == fabs( t_end - t ) ) ? t_end : t + hs;
+				for ( int d = 0; d < nDim; d++ )
+				{
+					x[d]    = ynew[d];
+					k[0][d] = k[6][d];
+				}
+				h *= factor;
+				break;
+			}
+			h *= fmax( RK45_MIN_FACTOR, RK45_SAFETY * pow( norm, -1.0 / 5 ) );
+			if ( h < min_step ) h = min_step;
+			rejected = 1;
+		}
+	}
+}
+
+/* Advect every point from t0 to t0 + T; the loop follows the runtime schedule */
+void compute_flowmap ( velocity_t *v, integrator_t *integ, int nPoints, double *coords, double t0, double T, double *flowmap, int nth )
+{
+	int nDim = v->grid->nDim;
+
+	#pragma omp parallel for default(none) shared(v, integ, nPoints, nDim, coords, t0, T, flowmap) num_threads(nth) schedule(runtime)
+	for ( int ip = 0; ip < nPoints; ip++ )
+	{
+		double x[3];
+		for ( int d = 0; d < nDim; d++ ) x[d] = coords[ip * nDim + d];
+		if ( integ->method == FLOWMAP_RK4 )
+			advect_rk4( v, integ->nsteps, x, t0, T );
+		else
+			advect_rk45( v, integ->rtol, integ->atol, x, t0, T );
+		for ( int d = 0; d < nDim; d++ ) flowmap[ip * nDim + d] = x[d];
+	}
+}
@@ -0,0 +1,113 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "omp.h"
+
+#include "ftle.h"
+#include "preprocess.h"
+#include "meshfile.h"
+#include "gmsh.h"
+
+/* Converts the Python-generated text files (or a Gmsh .msh file) into a UVaFTLE binary mesh file */
+
+static int count_tokens ( char *filename )
+{
+	char buffer[255];
+	int ntokens = 0;
+	FILE *file = fopen( filename, "r" );
+	if ( file == NULL )
+	{
+		fprintf( stderr, "Error: cannot open %s\n", filename );
+		exit(-1);
+	}
+	while ( fscanf(file, "%254s", buffer) == 1 ) ntokens++;
+	fclose(file);
+	return ntokens;
+}
+
+int main ( int argc, char *argv[] )
+{
+	int nDim, nVertsPerFace, nPoints = 0, nFaces = 0;
+	int nth = omp_get_max_threads();
+	double *coords = NULL, *flowmap = NULL;
+	int    *faces = NULL;
+	gmsh_file_t gmsh;
+
+	if ( argc != 6 )
+	{
+		printf("USAGE: %s <nDim> <coords_file> <faces_file> <flowmap_file> <output_file>\n", argv[0]);
+		printf("\tnDim:          dimensions of the space (2D/3D)\n");
+		printf("\tcoords_file:   file where mesh coordinates are stored ('-' to skip).\n");
+		printf("\tfaces_file:    file where mesh faces are stored ('-' to skip).\n");
+		printf("\tflowmap_file:  file where flowmap values are stored ('-' to skip).\n");
+		printf("\toutput_file:   UVaFTLE binary mesh file to create.\n");
+		return 1;
+	}
+
+	nDim = atoi(argv[1]);
+	if ( ( nDim != 2 ) && ( nDim != 3 ) )
+	{
+		printf("Wrong dimension provided (2 or 3 supported)\n");
+		return 1;
+	}
+	nVertsPerFace = nDim + 1;
+
+	gmsh.data = NULL;
+	if ( strcmp( argv[2], "-" ) && is_gmsh_file( argv[2] ) )
+	{
+		open_gmsh_file( argv[2], &gmsh );
+		nPoints = read_gmsh_nodes( &gmsh, nDim, &coords, nth );
+	}
+	else if ( strcmp( argv[2], "-" ) )
+	{
+		nPoints = read_coordinates( argv[2], nDim, &coords, nth );
+	}
+	if ( strcmp( argv[3], "-" ) && is_gmsh_file( argv[3] ) )
+	{
+		if ( gmsh.data && strcmp( argv[2], argv[3] ) ) close_gmsh_file( &gmsh );
+		if ( gmsh.data == NULL ) open_gmsh_file( argv[3], &gmsh );
+		nFaces = read_gmsh_elements( &gmsh, nDim, &faces, nth );
+	}
+	else if ( strcmp( argv[3], "-" ) )
+	{
+		nFaces = read_faces( argv[3], nDim, nVertsPerFace, &faces, nth );
+	}
+	if ( gmsh.data ) close_gmsh_file( &gmsh );
+	if ( strcmp( argv[4], "-" ) )
+	{
+		/* Flowmap files have no header: without coordinates, the number of values gives nPoints */
+		if ( coords == NULL ) nPoints = count_tokens( argv[4] ) / nDim;
+		flowmap = (double *) malloc( sizeof(double) * nPoints * nDim );
+		read_flowmap( argv[4], nDim, nPoints, flowmap, nth );
+	}
+
+	write_mesh_file( argv[5], nDim, nPoints, coords, nFaces, nVertsPerFace, faces, flowmap );
+	printf("%s: %d points, %d faces%s\n", argv[5], ( coords || flowmap ) ? nPoints : 0, nFaces, flowmap ? ", flowmap" : "");
+
+	free(coords);
+	free(faces);
+	free(flowmap);
+	return 0;
+}
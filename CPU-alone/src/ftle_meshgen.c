@@ -0,0 +1,94 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "omp.h"
+
+#include "meshgen.h"
+#include "meshfile.h"
+
+/* Generates a structured mesh without going through pyvista's Delaunay triangulation */
+
+int main ( int argc, char *argv[] )
+{
+	int nDim, nPoints, nFaces, dims[3] = { 0, 0, 0 }, nTets = 6;
+	int nth = omp_get_max_threads();
+	double bounds[6] = { 0, 1, 0, 1, 0, 1 };
+	double *coords;
+	int    *faces;
+	char   *env;
+
+	if ( argc != 5 )
+	{
+		printf("USAGE: %s <nDim> <nx,ny[,nz]> <coords_file> <faces_file>\n", argv[0]);
+		printf("\tnDim:          dimensions of the space (2D/3D)\n");
+		printf("\tnx,ny[,nz]:    lattice lines along every axis.\n");
+		printf("\tcoords_file:   file where mesh coordinates are written.\n");
+		printf("\tfaces_file:    file where mesh faces are written; if it is coords_file, both go to a UVaFTLE binary mesh file.\n");
+		printf("\tenvironment:   FTLE_MESHGEN_BOUNDS=x0,x1,y0,y1[,z0,z1], FTLE_MESHGEN_TETS=5|6.\n");
+		return 1;
+	}
+
+	nDim = atoi(argv[1]);
+	if ( ( nDim != 2 ) && ( nDim != 3 ) )
+	{
+		printf("Wrong dimension provided (2 or 3 supported)\n");
+		return 1;
+	}
+	if ( sscanf( argv[2], "%d,%d,%d", &dims[0], &dims[1], &dims[2] ) != nDim )
+	{
+		printf("Wrong lattice size provided (nx,ny for 2D or nx,ny,nz for 3D)\n");
+		return 1;
+	}
+
+	/* Same domains as mesh-generation.py by default */
+	if ( nDim == 2 ) bounds[1] = 2;
+	if ( ( env = getenv("FTLE_MESHGEN_BOUNDS") ) != NULL )
+	{
+		if ( sscanf( env, "%lf,%lf,%lf,%lf,%lf,%lf", &bounds[0], &bounds[1], &bounds[2], &bounds[3], &bounds[4], &bounds[5] ) != 2 * nDim )
+		{
+			printf("Wrong FTLE_MESHGEN_BOUNDS value provided (x0,x1,y0,y1 for 2D or x0,x1,y0,y1,z0,z1 for 3D)\n");
+			return 1;
+		}
+	}
+	if ( ( env = getenv("FTLE_MESHGEN_TETS") ) != NULL ) nTets = atoi(env);
+
+	nPoints = generate_lattice_coords( nDim, dims, bounds, &coords, nth );
+	nFaces  = generate_lattice_faces( nDim, dims, nTets, &faces, nth );
+
+	if ( strcmp( argv[3], argv[4] ) == 0 )
+	{
+		write_mesh_file( argv[3], nDim, nPoints, coords, nFaces, nDim + 1, faces, NULL );
+	}
+	else
+	{
+		write_coordinates( argv[3], nDim, nPoints, coords );
+		write_faces( argv[4], nDim + 1, nFaces, faces );
+	}
+	printf("%d points, %d %s\n", nPoints, nFaces, ( nDim == 2 ) ? "triangles" : "tetrahedra");
+
+	free(coords);
+	free(faces);
+	return 0;
+}
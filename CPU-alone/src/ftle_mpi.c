@@ -0,0 +1,543 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "omp.h"
+
+#include "ftle.h"
+#include "preprocess.h"
+#include "meshfile.h"
+#include "timing.h"
+#include "csvfile.h"
+#include "eigen.h"
+#include "uvaftle.h"
+
+/*
+ * Distributed FTLE (MPI + OpenMP). Every rank owns a contiguous block of
+ * points and receives the faces touching them, so it only holds its local
+ * adjacency plus a one-layer halo of ghost points (the other vertices of
+ * those faces). The ghost coordinates and flowmap values are fetched from
+ * their owners with one Alltoallv each, and the FTLE of the owned points is
+ * computed by libuvaftle with nth threads per rank.
+ */
+
+#define MPI_IO_CHUNK ( 1 << 30 )   /* bytes per MPI_File_write_at call */
+
+/* Ghost exchange plan: what every rank sends to (and receives from) every other one */
+typedef struct Halo {
+	int   size;
+	int  *sendcounts, *sdispls;   /* points */
+	int  *recvcounts, *rdispls;
+	int   nsend;
+	int  *sendidx;                /* local index of every point sent, grouped by destination */
+} halo_t;
+
+/* Errors stop every rank, not only the one that found them */
+static void mpi_error ( const char *message, const char *filename )
+{
+	fprintf( stderr, "Error: %s%s%s\n", message, filename ? " " : "", filename ? filename : "" );
+	MPI_Abort( MPI_COMM_WORLD, -1 );
+}
+
+/* Rank owning item g of a block distribution: the last r with first[r] <= g */
+static int block_owner ( long *first, int size, long g )
+{
+	int lo = 0, hi = size - 1;
+	while ( lo < hi )
+	{
+		int mid = ( lo + hi + 1 ) / 2;
+		if ( first[mid] <= g ) lo = mid; else hi = mid - 1;
+	}
+	return lo;
+}
+
+static void block_distribution ( long n, int size, long *first )
+{
+	for ( int r = 0; r <= size; r++ )
+		first[r] = n * r / size;
+}
+
+/* Block [first[rank], first[rank+1]) of the coordinates (nPoints set from the file) or of a flowmap; mapped files are only touched there */
+static double *read_point_block ( char *filename, int section, int nDim, int *nPoints, long *first, int rank, int size, int nth )
+{
+	mesh_file_t mf;
+	double *all, *block;
+	int n = *nPoints;
+
+	mf.map = NULL;
+	if ( is_mesh_file( filename ) )
+	{
+		int count;
+		open_mesh_file( filename, &mf );
+		all = (double *) mesh_file_section( &mf, section, nDim, &count );
+		if ( ( section == MESH_SECTION_FLOWMAP ) && ( count != n ) )
+			mpi_error( "the flowmap and the mesh have different numbers of points in", filename );
+		n = count;
+	}
+	else if ( section == MESH_SECTION_COORDS )
+		n = read_coordinates( filename, nDim, &all, nth );
+	else
+	{
+		all = (double *) malloc( sizeof(double) * n * nDim );
+		read_flowmap( filename, nDim, n, all, nth );
+	}
+
+	if ( section == MESH_SECTION_COORDS )
+	{
+		*nPoints = n;
+		if ( n < size ) mpi_error( "fewer mesh points than ranks in", filename );
+		block_distribution( n, size, first );
+	}
+	block = (double *) malloc( sizeof(double) * ( first[rank + 1] - first[rank] ) * nDim );
+	memcpy( block, all + first[rank] * nDim, sizeof(double) * ( first[rank + 1] - first[rank] ) * nDim );
+	if ( mf.map ) close_mesh_file( &mf ); else free(all);
+	return block;
+}
+
+/* Face block [f0, f1) of this rank */
+static int *read_face_block ( char *filename, int nDim, int nVertsPerFace, int rank, int size, int *nBlock, int nth )
+{
+	mesh_file_t mf;
+	int *all, *block, nFaces;
+	long f0, f1;
+
+	mf.map = NULL;
+	if ( is_mesh_file( filename ) )
+	{
+		open_mesh_file( filename, &mf );
+		all = (int *) mesh_file_section( &mf, MESH_SECTION_FACES, nVertsPerFace, &nFaces );
+	}
+	else
+		nFaces = read_faces( filename, nDim, nVertsPerFace, &all, nth );
+
+	f0 = (long) nFaces * rank / size;
+	f1 = (long) nFaces * ( rank + 1 ) / size;
+	*nBlock = f1 - f0;
+	block = (int *) malloc( sizeof(int) * ( f1 - f0 ) * nVertsPerFace + 1 );
+	memcpy( block, all + f0 * nVertsPerFace, sizeof(int) * ( f1 - f0 ) * nVertsPerFace );
+	if ( mf.map ) close_mesh_file( &mf ); else free(all);
+	return block;
+}
+
+/* Distinct owners of the vertices of a face */
+static int face_owners ( int *face, int nVertsPerFace, long *first, int size, int *owners )
+{
+	int n = 0;
+	for ( int v = 0; v < nVertsPerFace; v++ )
+	{
+		int o = block_owner( first, size, face[v] ), seen = 0;
+		for ( int u = 0; u < n; u++ ) seen |= ( owners[u] == o );
+		if ( !seen ) owners[n++] = o;
+	}
+	return n;
+}
+
+/* Every face goes once to each owner of its vertices; they arrive in rank order, i.e. in global face order */
+static int *scatter_faces ( int *block, int nBlock, int nVertsPerFace, long *first, int size, int *nLocalFaces )
+{
+	int *sendcounts = (int *) calloc( size, sizeof(int) ), *sdispls = (int *) malloc( sizeof(int) * size );
+	int *recvcounts = (int *) malloc( sizeof(int) * size ), *rdispls = (int *) malloc( sizeof(int) * size );
+	int *fill = (int *) malloc( sizeof(int) * size );
+	int *sendbuf, *recvbuf, owners[4];
+	long nsend = 0, nrecv = 0;
+
+	for ( int f = 0; f < nBlock; f++ )
+	{
+		int n = face_owners( block + (long) f * nVertsPerFace, nVertsPerFace, first, size, owners );
+		for ( int i = 0; i < n; i++ ) sendcounts[ owners[i] ] += nVertsPerFace;
+	}
+	for ( int r = 0; r < size; r++ )
+	{
+		sdispls[r] = fill[r] = nsend;
+		nsend += sendcounts[r];
+	}
+	sendbuf = (int *) malloc( sizeof(int) * nsend + 1 );
+	for ( int f = 0; f < nBlock; f++ )
+	{
+		int *face = block + (long) f * nVertsPerFace;
+		int n = face_owners( face, nVertsPerFace, first, size, owners );
+		for ( int i = 0; i < n; i++ )
+		{
+			memcpy( sendbuf + fill[ owners[i] ], face, sizeof(int) * nVertsPerFace );
+			fill[ owners[i] ] += nVertsPerFace;
+		}
+	}
+
+	MPI_Alltoall( sendcounts, 1, MPI_INT, recvcounts, 1, MPI_INT, MPI_COMM_WORLD );
+	for ( int r = 0; r < size; r++ )
+	{
+		rdispls[r] = nrecv;
+		nrecv += recvcounts[r];
+	}
+	recvbuf = (int *) malloc( sizeof(int) * nrecv + 1 );
+	MPI_Alltoallv( sendbuf, sendcounts, sdispls, MPI_INT, recvbuf, recvcounts, rdispls, MPI_INT, MPI_COMM_WORLD );
+
+	*nLocalFaces = nrecv / nVertsPerFace;
+	free(sendbuf);
+	free(fill);
+	free(sendcounts);
+	free(sdispls);
+	free(recvcounts);
+	free(rdispls);
+	return recvbuf;
+}
+
+static int compare_int ( const void *a, const void *b )
+{
+	return ( *(const int *) a > *(const int *) b ) - ( *(const int *) a < *(const int *) b );
+}
+
+/* Ghosts: the vertices of the local faces owned by other ranks, sorted (and so grouped by owner) */
+static int *find_ghosts ( int *faces, long nValues, long p0, long p1, int *nGhosts )
+{
+	int *ghosts = (int *) malloc( sizeof(int) * nValues + 1 );
+	long n = 0, m = 0;
+
+	for ( long i = 0; i < nValues; i++ )
+		if ( ( faces[i] < p0 ) || ( faces[i] >= p1 ) ) ghosts[n++] = faces[i];
+	qsort( ghosts, n, sizeof(int), compare_int );
+	for ( long i = 0; i < n; i++ )
+		if ( ( m == 0 ) || ( ghosts[i] != ghosts[m - 1] ) ) ghosts[m++] = ghosts[i];
+	*nGhosts = m;
+	return ghosts;
+}
+
+/* Local numbering: owned points first (g - p0), then the ghosts in their sorted order */
+static void localize_faces ( int *faces, long nValues, long p0, long p1, int *ghosts, int nGhosts, int nth )
+{
+	int nOwned = p1 - p0;
+	#pragma omp parallel for default(none) shared(faces, nValues, p0, p1, ghosts, nGhosts, nOwned) num_threads(nth) schedule(static)
+	for ( long i = 0; i < nValues; i++ )
+	{
+		int g = faces[i];
+		if ( ( g >= p0 ) && ( g < p1 ) )
+			faces[i] = g - p0;
+		else
+			faces[i] = nOwned + (int) ( (int *) bsearch( &g, ghosts, nGhosts, sizeof(int), compare_int ) - ghosts );
+	}
+}
+
+static void build_halo ( int *ghosts, int nGhosts, long *first, int size, halo_t *h )
+{
+	int *requests;
+
+	h->size       = size;
+	h->sendcounts = (int *) malloc( sizeof(int) * size );
+	h->sdispls    = (int *) malloc( sizeof(int) * size );
+	h->recvcounts = (int *) calloc( size, sizeof(int) );
+	h->rdispls    = (int *) malloc( sizeof(int) * size );
+
+	for ( int i = 0; i < nGhosts; i++ )
+		h->recvcounts[ block_owner( first, size, ghosts[i] ) ]++;
+	MPI_Alltoall( h->recvcounts, 1, MPI_INT, h->sendcounts, 1, MPI_INT, MPI_COMM_WORLD );
+	h->nsend = 0;
+	for ( int r = 0, s = 0; r < size; r++ )
+	{
+		h->rdispls[r] = s;
+		s += h->recvcounts[r];
+		h->sdispls[r] = h->nsend;
+		h->nsend += h->sendcounts[r];
+	}
+
+	/* Every owner learns which of its points the others need */
+	requests = (int *) malloc( sizeof(int) * h->nsend + 1 );
+	MPI_Alltoallv( ghosts, h->recvcounts, h->rdispls, MPI_INT, requests, h->sendcounts, h->sdispls, MPI_INT, MPI_COMM_WORLD );
+	for ( int r = 0; r < size; r++ )
+		for ( int i = h->sdispls[r]; i < h->sdispls[r] + h->sendcounts[r]; i++ )
+			requests[i] -= first[ block_owner( first, size, requests[i] ) ];
+	h->sendidx = requests;
+}
+
+/* Fill the ghost rows (after the nOwned owned ones) of a local array of width doubles per point */
+static void halo_exchange ( halo_t *h, double *local, int nOwned, int width, int nth )
+{
+	int     size = h->size, nsend = h->nsend, *sendidx = h->sendidx;
+	int    *sc = (int *) malloc( sizeof(int) * size ), *sd = (int *) malloc( sizeof(int) * size );
+	int    *rc = (int *) malloc( sizeof(int) * size ), *rd = (int *) malloc( sizeof(int) * size );
+	double *sendbuf = (double *) malloc( sizeof(double) * nsend * width + 1 );
+
+	#pragma omp parallel for default(none) shared(nsend, sendidx, sendbuf, local, width) num_threads(nth) schedule(static)
+	for ( int i = 0; i < nsend; i++ )
+		for ( int d = 0; d < width; d++ )
+			sendbuf[(long) i * width + d] = local[(long) sendidx[i] * width + d];
+	for ( int r = 0; r < size; r++ )
+	{
+		sc[r] = h->sendcounts[r] * width;
+		sd[r] = h->sdispls[r] * width;
+		rc[r] = h->recvcounts[r] * width;
+		rd[r] = h->rdispls[r] * width;
+	}
+	MPI_Alltoallv( sendbuf, sc, sd, MPI_DOUBLE, local + (long) nOwned * width, rc, rd, MPI_DOUBLE, MPI_COMM_WORLD );
+
+	free(sendbuf);
+	free(sc);
+	free(sd);
+	free(rc);
+	free(rd);
+}
+
+static void free_halo ( halo_t *h )
+{
+	free( h->sendcounts );
+	free( h->sdispls );
+	free( h->recvcounts );
+	free( h->rdispls );
+	free( h->sendidx );
+}
+
+/* Every rank formats its rows and writes them at its offset of the shared file */
+static long long write_csv_parallel ( char *filename, int nOwned, double *values, int format, int nth )
+{
+	char      *text;
+	long long  len = format_csv_rows( nOwned, 1, values, NULL, format, nth, &text ), offset = 0, total;
+	MPI_File   fh;
+	int        rank;
+
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Exscan( &len, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+	if ( rank == 0 ) offset = 0;
+	MPI_Allreduce( &len, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+
+	if ( MPI_File_open( MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh ) != MPI_SUCCESS )
+		mpi_error( "cannot create", filename );
+	MPI_File_set_size( fh, total );
+	for ( long long done = 0; done < len; done += MPI_IO_CHUNK )
+	{
+		int n = ( len - done < MPI_IO_CHUNK ) ? len - done : MPI_IO_CHUNK;
+		if ( MPI_File_write_at( fh, offset + done, text + done, n, MPI_CHAR, MPI_STATUS_IGNORE ) != MPI_SUCCESS )
+			mpi_error( "cannot write", filename );
+	}
+	MPI_File_close( &fh );
+	free(text);
+	return total;
+}
+
+/* Slowest rank for the times, all of them for the bytes */
+static void reduce_timing ( timing_t *t )
+{
+	for ( int i = 0; i < t->nPhases; i++ )
+	{
+		MPI_Allreduce( MPI_IN_PLACE, &t->phases[i].seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD );
+		MPI_Allreduce( MPI_IN_PLACE, &t->phases[i].bytes, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+	}
+}
+
+int main ( int argc, char *argv[] )
+{
+	int        rank, size, provided;
+	int        nDim, nVertsPerFace, nPoints = 0, nOwned, nLocal, nGhosts, nBlock, nLocalFaces;
+	int        nth, print2file, kernel_id = UVAFTLE_KERNEL_STENCIL, csv_format = CSV_FORMAT_FIXED;
+	double     t_eval, *coords, *owned, *flowmap, *logSqrt, time;
+	int       *faces, *block, *ghosts;
+	long      *first;
+	long long  ghosts_total, ghosts_max, ghosts_local;
+	halo_t     halo;
+	timing_t   timing;
+	char      *env, *timing_log;
+	uvaftle_mesh_t *mesh;
+
+	MPI_Init_thread( &argc, &argv, MPI_THREAD_FUNNELED, &provided );
+	MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+	MPI_Comm_size( MPI_COMM_WORLD, &size );
+
+	if ( argc != 8 )
+	{
+		if ( rank == 0 )
+		{
+			printf("USAGE: mpirun -np <ranks> %s <nDim> <coords_file> <faces_file> <flowmap_file> <t_eval> <nth> <print2file>\n", argv[0]);
+			printf("\tnDim:          dimensions of the space (2D/3D)\n");
+			printf("\tcoords_file:   file where mesh coordinates are stored (text or UVaFTLE mesh file).\n");
+			printf("\tfaces_file:    file where mesh faces are stored (text or UVaFTLE mesh file).\n");
+			printf("\tflowmap_file:  file where flowmap values are stored (text or UVaFTLE mesh file).\n");
+			printf("\tt_eval:        time when compute ftle is desired.\n");
+			printf("\tnth:           number of OpenMP threads per rank.\n");
+			printf("\tenvironment:   FTLE_KERNEL=stencil|simd|facewalk|facecode, FTLE_CSV_FORMAT, FTLE_EIGEN, FTLE_TIMING.\n");
+			printf("\tprint to file? (0-NO, 1-YES)\n");
+		}
+		MPI_Finalize();
+		return 1;
+	}
+
+	nDim       = atoi(argv[1]);
+	t_eval     = atof(argv[5]);
+	nth        = atoi(argv[6]);
+	print2file = atoi(argv[7]);
+	if ( ( nDim != 2 ) && ( nDim != 3 ) )             mpi_error( "wrong dimension provided (2 or 3 supported)", NULL );
+	if ( nth < 1 )                                    mpi_error( "wrong thread count provided (positive value expected)", NULL );
+	if ( ( print2file != 0 ) && ( print2file != 1 ) ) mpi_error( "wrong print2file value provided (0 or 1 supported)", NULL );
+	nVertsPerFace = nDim + 1;
+
+	/* Ranks hold no whole mesh, so the lattice kernel (which needs all the points) is not available */
+	if ( ( env = getenv("FTLE_KERNEL") ) != NULL && strcmp(env, "auto") )
+	{
+		kernel_id = uvaftle_kernel_id( env );
+		if ( ( kernel_id != UVAFTLE_KERNEL_STENCIL ) && ( kernel_id != UVAFTLE_KERNEL_SIMD ) && ( kernel_id != UVAFTLE_KERNEL_FACEWALK ) && ( kernel_id != UVAFTLE_KERNEL_FACECODE ) )
+			mpi_error( "wrong FTLE_KERNEL value provided (stencil, simd, facewalk or facecode supported)", NULL );
+	}
+	if ( ( env = getenv("FTLE_CSV_FORMAT") ) != NULL && env[0] && strcmp(env, "fixed") )
+	{
+		if ( strcmp(env, "shortest") ) mpi_error( "wrong FTLE_CSV_FORMAT value provided (fixed or shortest supported)", NULL );
+		csv_format = CSV_FORMAT_SHORTEST;
+	}
+	if ( ( env = getenv("FTLE_EIGEN") ) != NULL && env[0] )
+	{
+		if ( eigen_solver_id( env ) < 0 ) mpi_error( "wrong FTLE_EIGEN value provided (trig or jacobi supported)", NULL );
+		eigen_set_solver( eigen_solver_id( env ) );
+	}
+	timing_log = getenv("FTLE_TIMING");
+	timing_init( &timing );
+	first = (long *) malloc( sizeof(long) * ( size + 1 ) );
+
+	if ( rank == 0 )
+	{
+		printf("--------------------------------------------------------\n");
+		printf("|                   UVaFTLE (MPI + OpenMP)             |\n");
+		printf("--------------------------------------------------------\n");
+		printf("\nReading input data (%d ranks, %d threads each)\n\n", size, nth);
+		printf("\tReading mesh points coordinates...        ");
+		fflush(stdout);
+	}
+
+	/* Owned block of points */
+	timing_begin( &timing );
+	owned  = read_point_block( argv[2], MESH_SECTION_COORDS, nDim, &nPoints, first, rank, size, nth );
+	nOwned = first[rank + 1] - first[rank];
+	timing_end( &timing, "read_coords", nth, (long long) sizeof(double) * nOwned * nDim );
+	if ( rank == 0 ) { printf("DONE\n\tReading mesh faces vertices...            "); fflush(stdout); }
+
+	/* Local faces: the ones with at least one owned vertex */
+	timing_begin( &timing );
+	block = read_face_block( argv[3], nDim, nVertsPerFace, rank, size, &nBlock, nth );
+	timing_end( &timing, "read_faces", nth, (long long) sizeof(int) * nBlock * nVertsPerFace );
+	faces = scatter_faces( block, nBlock, nVertsPerFace, first, size, &nLocalFaces );
+	free(block);
+	timing_end( &timing, "scatter_faces", 1, (long long) sizeof(int) * nLocalFaces * nVertsPerFace );
+	if ( nLocalFaces == 0 ) mpi_error( "a rank owns points without faces", NULL );
+	if ( rank == 0 ) { printf("DONE\n"); fflush(stdout); }
+
+	/* One-layer halo */
+	timing_begin( &timing );
+	ghosts = find_ghosts( faces, (long) nLocalFaces * nVertsPerFace, first[rank], first[rank + 1], &nGhosts );
+	localize_faces( faces, (long) nLocalFaces * nVertsPerFace, first[rank], first[rank + 1], ghosts, nGhosts, nth );
+	build_halo( ghosts, nGhosts, first, size, &halo );
+	free(ghosts);
+	nLocal = nOwned + nGhosts;
+	coords = (double *) malloc( sizeof(double) * nLocal * nDim );
+	memcpy( coords, owned, sizeof(double) * nOwned * nDim );
+	free(owned);
+	halo_exchange( &halo, coords, nOwned, nDim, nth );
+	timing_end( &timing, "halo_build", nth, (long long) sizeof(double) * nGhosts * nDim );
+
+	/* Owned block of the flowmap plus its ghost values */
+	if ( rank == 0 ) { printf("\tReading mesh flowmap (x, y[, z])...       "); fflush(stdout); }
+	timing_begin( &timing );
+	owned   = read_point_block( argv[4], MESH_SECTION_FLOWMAP, nDim, &nPoints, first, rank, size, nth );
+	flowmap = (double *) malloc( sizeof(double) * nLocal * nDim );
+	memcpy( flowmap, owned, sizeof(double) * nOwned * nDim );
+	free(owned);
+	timing_end( &timing, "read_flowmap", nth, (long long) sizeof(double) * nOwned * nDim );
+	halo_exchange( &halo, flowmap, nOwned, nDim, nth );
+	timing_end( &timing, "halo_exchange", nth, (long long) sizeof(double) * nGhosts * nDim );
+	if ( rank == 0 ) { printf("DONE\n\n"); fflush(stdout); }
+
+	/* Local adjacency and FTLE of the owned points; the ghosts' own values are incomplete and dropped */
+	MPI_Barrier( MPI_COMM_WORLD );
+	if ( rank == 0 ) { printf("\nComputing Preproc (local CSR builder, %d threads per rank)...                     ", nth); fflush(stdout); }
+	time = MPI_Wtime();
+	mesh = uvaftle_mesh_create( nDim, nLocal, coords, kernel_id, NULL, nth );
+	if ( ( mesh == NULL ) || uvaftle_mesh_set_faces( mesh, nLocalFaces, faces ) || uvaftle_build_adjacency( mesh, 0 ) )
+		MPI_Abort( MPI_COMM_WORLD, -1 );
+	timing_add( &timing, "count_scan", uvaftle_phase_seconds( mesh, "count_scan" ), nth, 0 );
+	timing_add( &timing, "csr_build", uvaftle_phase_seconds( mesh, "csr_build" ), nth, 0 );
+	if ( ( kernel_id != UVAFTLE_KERNEL_FACEWALK ) && ( kernel_id != UVAFTLE_KERNEL_FACECODE ) )
+		timing_add( &timing, "stencil_table", uvaftle_phase_seconds( mesh, "stencil_table" ), nth, 0 );
+	MPI_Barrier( MPI_COMM_WORLD );
+	time = MPI_Wtime() - time;
+	if ( rank == 0 ) printf("DONE\n\nExecution time (ms) with %d ranks x %d threads: %f\n\n", size, nth, time * 1000);
+
+	logSqrt = (double *) malloc( sizeof(double) * nLocal );
+	if ( rank == 0 ) { printf("\nComputing FTLE (%s kernel, %d threads per rank)...                     ", uvaftle_kernel_name( kernel_id ), nth); fflush(stdout); }
+	omp_set_schedule( omp_sched_static, 0 );
+	MPI_Barrier( MPI_COMM_WORLD );
+	time = MPI_Wtime();
+	timing_begin( &timing );
+	uvaftle_compute( mesh, flowmap, t_eval, logSqrt );
+	timing_end( &timing, "ftle", nth, 0 );
+	MPI_Barrier( MPI_COMM_WORLD );
+	time = MPI_Wtime() - time;
+
+	ghosts_local = nGhosts;
+	MPI_Reduce( &ghosts_local, &ghosts_total, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD );
+	MPI_Reduce( &ghosts_local, &ghosts_max, 1, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD );
+	if ( rank == 0 )
+	{
+		printf("DONE\n\n");
+		printf("--------------------------------------------------------\n");
+		printf("\nExecution time (ms) with %d ranks x %d threads: %f\n\n", size, nth, time * 1000);
+		printf("FTLE throughput (Mpoints/s) with %s kernel: %f\n\n", uvaftle_kernel_name( kernel_id ), ( time > 0 ) ? (double) nPoints / time / 1e6 : 0.0);
+		printf("Ghost points: %lld in total (%.2f%% of the mesh), at most %lld per rank\n\n", ghosts_total, 100.0 * ghosts_total / nPoints, ghosts_max);
+		printf("--------------------------------------------------------\n");
+		fflush(stdout);
+	}
+
+	/* Every rank writes its rows of the shared output file */
+	if ( print2file )
+	{
+		if ( rank == 0 ) { printf("\nWriting result in output file...                  "); fflush(stdout); }
+		timing_begin( &timing );
+		long long written = write_csv_parallel( (char *) "ftle_result.csv", nOwned, logSqrt, csv_format, nth );
+		timing_end( &timing, "write", nth, ( rank == 0 ) ? written : 0 );
+		if ( rank == 0 ) { printf("DONE\n\n--------------------------------------------------------\n"); fflush(stdout); }
+	}
+
+	if ( timing_log != NULL )
+	{
+		reduce_timing( &timing );
+		if ( rank == 0 )
+		{
+			timing_set_int( &timing, "nDim", nDim );
+			timing_set_int( &timing, "nPoints", nPoints );
+			timing_set_int( &timing, "ranks", size );
+			timing_set_int( &timing, "threads", nth );
+			timing_set_string( &timing, "kernel", uvaftle_kernel_name( kernel_id ) );
+			timing_set_int( &timing, "ghosts", ghosts_total );
+			timing_set_string( &timing, "coords_file", argv[2] );
+			timing_set_string( &timing, "faces_file", argv[3] );
+			timing_set_string( &timing, "flowmap_file", argv[4] );
+			timing_set_double( &timing, "points_per_second", ( time > 0 ) ? (double) nPoints / time : 0.0 );
+			timing_report( &timing, timing_log );
+		}
+	}
+
+	uvaftle_mesh_free( mesh );
+	free_halo( &halo );
+	free(coords);
+	free(faces);
+	free(flowmap);
+	free(logSqrt);
+	free(first);
+	MPI_Finalize();
+	return 0;
+}
@@ -0,0 +1,411 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "omp.h"
+
+#include "preprocess.h"
+#include "gmsh.h"
+
+/* Nodes per element for the Gmsh element types up to 31 (0 is not a type) */
+static const int element_nodes[32] = { 0, 2, 3, 4, 4, 8, 6, 5, 3, 6, 9, 10, 27, 18, 14, 1,
+	8, 20, 15, 13, 9, 10, 12, 15, 15, 21, 4, 5, 6, 20, 35, 56 };
+
+/* 
+ * Entity block of $Nodes or $Elements. Values are read by position: a byte
+ * offset in binary files, a token index in the parsed ASCII section.
+ */
+typedef struct GmshBlock {
+	int     type;      /* element type, 0 for node blocks */
+	long    count;     /* nodes or elements of the block */
+	size_t  at;        /* first tag of the block */
+	int     width;     /* values per node after the tags (3 or more), or per element (1 + nodes) */
+	long    first;     /* index of the first node or kept element of the block */
+} gmsh_block_t;
+
+static inline int32_t get_i32 ( const char *p ) { int32_t v; memcpy( &v, p, sizeof(v) ); return v; }
+static inline uint64_t get_u64 ( const char *p ) { uint64_t v; memcpy( &v, p, sizeof(v) ); return v; }
+static inline double get_f64 ( const char *p ) { double v; memcpy( &v, p, sizeof(v) ); return v; }
+
+int is_gmsh_file ( char *filename )
+{
+	char magic[11];
+	FILE *file = fopen( filename, "rb" );
+	if ( file == NULL ) return 0;
+	size_t nread = fread( magic, 1, sizeof(magic), file );
+	fclose(file);
+	return ( nread == sizeof(magic) ) && ( memcmp( magic, "$MeshFormat", sizeof(magic) ) == 0 );
+}
+
+/* Position right after the end of the line containing pos */
+static size_t next_line ( gmsh_file_t *gf, size_t pos )
+{
+	while ( ( pos < gf->size ) && ( gf->data[pos] != '\n' ) ) pos++;
+	return ( pos < gf->size ) ? pos + 1 : pos;
+}
+
+static void corrupted ( gmsh_file_t *gf, const char *what )
+{
+	fprintf( stderr, "Error: malformed %s in Gmsh file %s\n", what, gf->filename );
+	exit(-1);
+}
+
+void open_gmsh_file ( char *filename, gmsh_file_t *gf )
+{
+	struct stat st;
+	int fd = open( filename, O_RDONLY );
+	double version;
+	int file_type, data_size;
+	size_t pos;
+
+	if ( ( fd < 0 ) || ( fstat( fd, &st ) < 0 ) )
+	{
+		fprintf( stderr, "Error: cannot open Gmsh file %s\n", filename );
+		exit(-1);
+	}
+	memset( gf, 0, sizeof(gmsh_file_t) );
+	gf->filename = filename;
+	gf->size = st.st_size;
+	gf->data = ( gf->size > 0 ) ? (char *) mmap( NULL, gf->size, PROT_READ, MAP_PRIVATE, fd, 0 ) : NULL;
+	close(fd);
+	if ( ( gf->data == NULL ) || ( gf->data == MAP_FAILED ) )
+	{
+		fprintf( stderr, "Error: cannot map Gmsh file %s\n", filename );
+		exit(-1);
+	}
+
+	/* $MeshFormat: version file-type data-size, then a binary 1 to check endianness */
+	pos = next_line( gf, 0 );
+	{
+		char line[128];
+		size_t len = next_line( gf, pos ) - pos;
+		if ( len >= sizeof(line) ) len = sizeof(line) - 1;
+		memcpy( line, gf->data + pos, len );
+		line[len] = '\0';
+		if ( sscanf( line, "%lf %d %d", &version, &file_type, &data_size ) != 3 ) corrupted( gf, "$MeshFormat" );
+	}
+	if ( ( version < 4.1 ) || ( version >= 5 ) )
+	{
+		fprintf( stderr, "Error: Gmsh file %s has format version %g, only 4.1 is supported (save it with Mesh.MshFileVersion = 4.1)\n", filename, version );
+		exit(-1);
+	}
+	if ( data_size != sizeof(uint64_t) )
+	{
+		fprintf( stderr, "Error: Gmsh file %s uses %d-byte sizes, only 8 is supported\n", filename, data_size );
+		exit(-1);
+	}
+	gf->binary = ( file_type == 1 );
+	pos = next_line( gf, pos );
+	if ( gf->binary )
+	{
+		if ( ( pos + sizeof(int32_t) > gf->size ) ) corrupted( gf, "$MeshFormat" );
+		if ( get_i32( gf->data + pos ) != 1 )
+		{
+			fprintf( stderr, "Error: Gmsh file %s was written with a different endianness\n", filename );
+			exit(-1);
+		}
+		pos = next_line( gf, pos + sizeof(int32_t) );
+	}
+	pos = next_line( gf, pos );
+
+	/* Locate the body of every section, only $Nodes and $Elements are used */
+	while ( pos < gf->size )
+	{
+		char name[64], end_name[68];
+		size_t len = 1, body;
+		const char *end;
+
+		while ( ( pos < gf->size ) && ( gf->data[pos] == '\n' || gf->data[pos] == '\r' || gf->data[pos] == ' ' ) ) pos++;
+		if ( pos == gf->size ) break;
+		if ( gf->data[pos] != '$' ) corrupted( gf, "section" );
+		name[0] = '$';
+		for ( pos++; ( pos < gf->size ) && !strchr( " \r\n", gf->data[pos] ) && ( len < sizeof(name) - 1 ); pos++ )
+			name[len++] = gf->data[pos];
+		name[len] = '\0';
+		body = next_line( gf, pos );
+		snprintf( end_name, sizeof(end_name), "$End%s", name + 1 );
+		end = (const char *) memmem( gf->data + body, gf->size - body, end_name, strlen(end_name) );
+		if ( end == NULL ) corrupted( gf, name );
+		if ( strcmp( name, "$Nodes" ) == 0 )
+		{
+			gf->nodes     = body;
+			gf->nodes_end = end - gf->data;
+		}
+		else if ( strcmp( name, "$Elements" ) == 0 )
+		{
+			gf->elements     = body;
+			gf->elements_end = end - gf->data;
+		}
+		pos = next_line( gf, end - gf->data );
+	}
+	if ( gf->nodes_end == 0 ) corrupted( gf, "file (no $Nodes section)" );
+	if ( gf->elements_end == 0 ) corrupted( gf, "file (no $Elements section)" );
+}
+
+/* ASCII sections are tokenized and parsed in parallel as a whole, blocks are walked afterwards */
+static double *parse_ascii_section ( gmsh_file_t *gf, size_t begin, size_t end, long *ntokens, int nth )
+{
+	double *values;
+	*ntokens = count_text_tokens( gf->data, begin, end, nth );
+	values = (double *) malloc( sizeof(double) * ( *ntokens > 0 ? *ntokens : 1 ) );
+	parse_text_range( gf->data, begin, end, *ntokens, values, nth, "read_gmsh" );
+	return values;
+}
+
+/* Value i of a section: position i of the parsed tokens, or the 8-byte value at byte offset i */
+static inline long tag_at ( gmsh_file_t *gf, const double *values, size_t i )
+{
+	return gf->binary ? (long) get_u64( gf->data + i ) : (long) values[i];
+}
+
+/* 
+ * Walks the block headers of a section. Header and block headers are four size_t
+ * (numEntityBlocks, count, minTag, maxTag) and three int plus one size_t
+ * (entityDim, entityTag, parametric or elementType, count).
+ */
+static gmsh_block_t *scan_blocks ( gmsh_file_t *gf, int nodes, const double *values, long ntokens, long *nblocks, long *total, long *minTag, long *maxTag )
+{
+	size_t pos = nodes ? gf->nodes : gf->elements;
+	size_t end = nodes ? gf->nodes_end : gf->elements_end;
+	const char *what = nodes ? "$Nodes" : "$Elements";
+	gmsh_block_t *blocks;
+	long sum = 0;
+
+	if ( gf->binary )
+	{
+		if ( pos + 4 * sizeof(uint64_t) > end ) corrupted( gf, what );
+		*nblocks = get_u64( gf->data + pos );
+		*total   = get_u64( gf->data + pos + 8 );
+		*minTag  = get_u64( gf->data + pos + 16 );
+		*maxTag  = get_u64( gf->data + pos + 24 );
+		pos += 4 * sizeof(uint64_t);
+	}
+	else
+	{
+		if ( ntokens < 4 ) corrupted( gf, what );
+		*nblocks = (long) values[0];
+		*total   = (long) values[1];
+		*minTag  = (long) values[2];
+		*maxTag  = (long) values[3];
+		pos = 4;
+		end = ntokens;
+	}
+	if ( ( *nblocks < 0 ) || ( *total < 0 ) ) corrupted( gf, what );
+
+	blocks = (gmsh_block_t *) malloc( sizeof(gmsh_block_t) * ( *nblocks > 0 ? *nblocks : 1 ) );
+	for ( long b = 0; b < *nblocks; b++ )
+	{
+		int dim, kind;
+		long count;
+		size_t unit = gf->binary ? sizeof(uint64_t) : 1;
+
+		if ( gf->binary )
+		{
+			if ( pos + 3 * sizeof(int32_t) + sizeof(uint64_t) > end ) corrupted( gf, what );
+			dim   = get_i32( gf->data + pos );
+			kind  = get_i32( gf->data + pos + 8 );
+			count = get_u64( gf->data + pos + 12 );
+			pos  += 3 * sizeof(int32_t) + sizeof(uint64_t);
+		}
+		else
+		{
+			if ( pos + 4 > end ) corrupted( gf, what );
+			dim   = (int) values[pos];
+			kind  = (int) values[pos+2];
+			count = (long) values[pos+3];
+			pos  += 4;
+		}
+		if ( count < 0 ) corrupted( gf, what );
+		blocks[b].count = count;
+		blocks[b].at    = pos;
+		if ( nodes )
+		{
+			/* Tags first, then x y z and the parametric coordinates if any */
+			blocks[b].type  = 0;
+			blocks[b].width = 3 + ( kind ? dim : 0 );
+			blocks[b].first = sum;
+			pos += count * ( 1 + blocks[b].width ) * unit;
+		}
+		else
+		{
+			if ( ( kind <= 0 ) || ( kind >= (int) ( sizeof(element_nodes) / sizeof(int) ) ) )
+			{
+				fprintf( stderr, "Error: element type %d of Gmsh file %s is not supported\n", kind, gf->filename );
+				exit(-1);
+			}
+			blocks[b].type  = kind;
+			blocks[b].width = 1 + element_nodes[kind];
+			blocks[b].first = 0;
+			pos += count * blocks[b].width * unit;
+		}
+		if ( pos > end ) corrupted( gf, what );
+		sum += count;
+	}
+	if ( sum != *total ) corrupted( gf, what );
+	return blocks;
+}
+
+/* Fills the tag map and, if coords is not NULL, the coordinates of every node */
+static void decode_nodes ( gmsh_file_t *gf, int nDim, double *coords, int nth )
+{
+	long ntokens = 0, nblocks, total, minTag, maxTag;
+	double *values = gf->binary ? NULL : parse_ascii_section( gf, gf->nodes, gf->nodes_end, &ntokens, nth );
+	gmsh_block_t *blocks = scan_blocks( gf, 1, values, ntokens, &nblocks, &total, &minTag, &maxTag );
+	int *tag2idx;
+	long nTags = maxTag - minTag + 1, bad = 0;
+
+	if ( ( total > 0 ) && ( ( minTag < 1 ) || ( nTags < total ) ) ) corrupted( gf, "$Nodes" );
+	tag2idx = (int *) malloc( sizeof(int) * ( total > 0 ? nTags : 1 ) );
+	#pragma omp parallel for default(none) shared(tag2idx, nTags) num_threads(nth) schedule(static)
+	for ( long t = 0; t < nTags; t++ )
+		tag2idx[t] = -1;
+
+	for ( long b = 0; b < nblocks; b++ )
+	{
+		gmsh_block_t *blk = &blocks[b];
+		size_t unit = gf->binary ? sizeof(uint64_t) : 1;
+		size_t xyz = blk->at + blk->count * unit;
+
+		#pragma omp parallel for default(none) shared(gf, values, blk, tag2idx, coords, nDim, minTag, nTags, unit, xyz) reduction(+:bad) num_threads(nth) schedule(static)
+		for ( long k = 0; k < blk->count; k++ )
+		{
+			long tag = tag_at( gf, values, blk->at + k * unit ) - minTag;
+			long idx = blk->first + k;
+			if ( ( tag < 0 ) || ( tag >= nTags ) ) { bad++; continue; }
+			tag2idx[tag] = (int) idx;
+			if ( coords == NULL ) continue;
+			for ( int d = 0; d < nDim; d++ )
+			{
+				size_t i = xyz + ( k * blk->width + d ) * unit;
+				coords[idx * nDim + d] = gf->binary ? get_f64( gf->data + i ) : values[i];
+			}
+		}
+	}
+	if ( bad ) corrupted( gf, "node tags of $Nodes" );
+
+	gf->minTag  = minTag;
+	gf->nTags   = nTags;
+	gf->tag2idx = tag2idx;
+	free(blocks);
+	free(values);
+}
+
+int read_gmsh_nodes ( gmsh_file_t *gf, int nDim, double **coords, int nth )
+{
+	long nblocks, total, minTag, maxTag;
+	gmsh_block_t *blocks;
+
+	/* Point count first, from the section header */
+	if ( gf->binary )
+	{
+		blocks = scan_blocks( gf, 1, NULL, 0, &nblocks, &total, &minTag, &maxTag );
+		free(blocks);
+	}
+	else
+	{
+		char line[256];
+		size_t len = gf->nodes_end - gf->nodes;
+		if ( len >= sizeof(line) ) len = sizeof(line) - 1;
+		memcpy( line, gf->data + gf->nodes, len );
+		line[len] = '\0';
+		if ( sscanf( line, "%ld %ld", &nblocks, &total ) != 2 ) corrupted( gf, "$Nodes" );
+	}
+	if ( ( total <= 0 ) || ( total > INT32_MAX ) ) corrupted( gf, "$Nodes" );
+
+	*coords = (double *) malloc( sizeof(double) * total * nDim );
+	if ( *coords == NULL )
+	{
+		fprintf( stderr, "Error: cannot allocate %ld points of Gmsh file %s\n", total, gf->filename );
+		exit(-1);
+	}
+	free( gf->tag2idx );
+	decode_nodes( gf, nDim, *coords, nth );
+	return (int) total;
+}
+
+int read_gmsh_elements ( gmsh_file_t *gf, int nDim, int **faces, int nth )
+{
+	long ntokens = 0, nblocks, total, minTag, maxTag, nFaces = 0, bad = 0;
+	int want = ( nDim == 2 ) ? 2 : 4;      /* 3-node triangles or 4-node tetrahedra */
+	int nVertsPerFace = nDim + 1;
+	double *values;
+	gmsh_block_t *blocks;
+
+	if ( gf->tag2idx == NULL ) decode_nodes( gf, nDim, NULL, nth );
+	values = gf->binary ? NULL : parse_ascii_section( gf, gf->elements, gf->elements_end, &ntokens, nth );
+	blocks = scan_blocks( gf, 0, values, ntokens, &nblocks, &total, &minTag, &maxTag );
+
+	for ( long b = 0; b < nblocks; b++ )
+		if ( blocks[b].type == want )
+		{
+			blocks[b].first = nFaces;
+			nFaces += blocks[b].count;
+		}
+	if ( nFaces == 0 )
+	{
+		fprintf( stderr, "Error: Gmsh file %s has no %s\n", gf->filename, ( nDim == 2 ) ? "triangles" : "tetrahedra" );
+		exit(-1);
+	}
+	if ( nFaces > INT32_MAX / nVertsPerFace ) corrupted( gf, "$Elements" );
+
+	*faces = (int *) malloc( sizeof(int) * nFaces * nVertsPerFace );
+	for ( long b = 0; b < nblocks; b++ )
+	{
+		gmsh_block_t *blk = &blocks[b];
+		size_t unit = gf->binary ? sizeof(uint64_t) : 1;
+		int *dst = *faces;
+
+		if ( blk->type != want ) continue;
+		/* Element tag, then its node tags */
+		#pragma omp parallel for default(none) shared(gf, values, blk, dst, nVertsPerFace, unit) reduction(+:bad) num_threads(nth) schedule(static)
+		for ( long k = 0; k < blk->count; k++ )
+		{
+			for ( int v = 0; v < nVertsPerFace; v++ )
+			{
+				long tag = tag_at( gf, values, blk->at + ( k * blk->width + 1 + v ) * unit ) - gf->minTag;
+				int idx = ( ( tag >= 0 ) && ( tag < gf->nTags ) ) ? gf->tag2idx[tag] : -1;
+				bad += ( idx < 0 );
+				dst[( blk->first + k ) * nVertsPerFace + v] = idx;
+			}
+		}
+	}
+	if ( bad ) corrupted( gf, "node tags of $Elements" );
+
+	free(blocks);
+	free(values);
+	return (int) nFaces;
+}
+
+void close_gmsh_file ( gmsh_file_t *gf )
+{
+	if ( gf->data ) munmap( gf->data, gf->size );
+	free( gf->tag2idx );
+	gf->data    = NULL;
+	gf->tag2idx = NULL;
+}
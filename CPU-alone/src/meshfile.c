@@ -0,0 +1,192 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "meshfile.h"
+
+static const char *section_names[MESH_NSECTIONS] = { "coordinates", "faces", "flowmap" };
+
+int is_mesh_file ( char *filename )
+{
+	char magic[8];
+	FILE *file = fopen( filename, "rb" );
+	if ( file == NULL ) return 0;
+	size_t nread = fread( magic, 1, sizeof(magic), file );
+	fclose(file);
+	return ( nread == sizeof(magic) ) && ( memcmp( magic, MESH_FILE_MAGIC, sizeof(magic) ) == 0 );
+}
+
+void open_mesh_file ( char *filename, mesh_file_t *mf )
+{
+	struct stat st;
+	int fd, is;
+
+	fd = open( filename, O_RDONLY );
+	if ( ( fd < 0 ) || ( fstat( fd, &st ) < 0 ) )
+	{
+		fprintf( stderr, "Error: cannot open mesh file %s\n", filename );
+		exit(-1);
+	}
+	if ( (size_t) st.st_size < sizeof(mesh_header_t) )
+	{
+		fprintf( stderr, "Error: truncated mesh file %s\n", filename );
+		exit(-1);
+	}
+
+	/* Private writable mapping: arrays are used in place, pages only copied if modified */
+	mf->size = st.st_size;
+	mf->map  = mmap( NULL, mf->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	close(fd);
+	if ( mf->map == MAP_FAILED )
+	{
+		fprintf( stderr, "Error: cannot map mesh file %s\n", filename );
+		exit(-1);
+	}
+	mf->header = (mesh_header_t *) mf->map;
+
+	if ( memcmp( mf->header->magic, MESH_FILE_MAGIC, sizeof(mf->header->magic) ) )
+	{
+		fprintf( stderr, "Error: %s is not a UVaFTLE mesh file\n", filename );
+		exit(-1);
+	}
+	if ( mf->header->endian != MESH_FILE_ENDIAN )
+	{
+		fprintf( stderr, "Error: %s was written with a different endianness, convert it again on this machine\n", filename );
+		exit(-1);
+	}
+	if ( ( mf->header->version != MESH_FILE_VERSION ) || ( mf->header->nSections != MESH_NSECTIONS ) )
+	{
+		fprintf( stderr, "Error: unsupported version %u of mesh file %s\n", mf->header->version, filename );
+		exit(-1);
+	}
+	for ( is = 0; is < MESH_NSECTIONS; is++ )
+	{
+		mesh_section_t *sec = &mf->header->sections[is];
+		if ( sec->offset == 0 ) continue;
+		if ( !mesh_section_fits( sec, mf->size ) )
+		{
+			fprintf( stderr, "Error: corrupted %s section in mesh file %s\n", section_names[is], filename );
+			exit(-1);
+		}
+	}
+}
+
+/* Whether a present section is aligned and lies within a file of size bytes; the bound is checked by division,
+   so no count or offset in a damaged or crafted header can wrap it around */
+int mesh_section_fits ( mesh_section_t *sec, size_t size )
+{
+	uint64_t elem = ( sec->dtype == MESH_DTYPE_INT32 ) ? sizeof(int) : sizeof(double);
+
+	if ( ( sec->offset % MESH_FILE_ALIGN ) || ( sec->offset > size ) || ( sec->width == 0 ) || ( sec->count > INT_MAX ) )
+		return 0;
+	return sec->count <= ( size - sec->offset ) / ( sec->width * elem );
+}
+
+void *mesh_file_section ( mesh_file_t *mf, int section, int width, int *count )
+{
+	mesh_section_t *sec = &mf->header->sections[section];
+	uint32_t dtype = ( section == MESH_SECTION_FACES ) ? MESH_DTYPE_INT32 : MESH_DTYPE_FLOAT64;
+
+	if ( sec->offset == 0 )
+	{
+		fprintf( stderr, "Error: mesh file has no %s section\n", section_names[section] );
+		exit(-1);
+	}
+	if ( ( sec->width != (uint32_t) width ) || ( sec->dtype != dtype ) )
+	{
+		fprintf( stderr, "Error: mesh file %s section stores %u values per element, %d expected\n", section_names[section], sec->width, width );
+		exit(-1);
+	}
+	*count = (int) sec->count;
+	return (char *) mf->map + sec->offset;
+}
+
+void close_mesh_file ( mesh_file_t *mf )
+{
+	munmap( mf->map, mf->size );
+	mf->map    = NULL;
+	mf->header = NULL;
+}
+
+/* Append one aligned section after offset and describe it in sec; absent (NULL) sections take no space */
+uint64_t write_mesh_section ( FILE *file, uint64_t offset, mesh_section_t *sec, void *data, int count, int width, uint32_t dtype, size_t elem )
+{
+	static const char zeros[MESH_FILE_ALIGN] = { 0 };
+	uint64_t start = ( offset + MESH_FILE_ALIGN - 1 ) / MESH_FILE_ALIGN * MESH_FILE_ALIGN;
+	size_t   bytes = (size_t) count * width * elem;
+
+	if ( data == NULL )
+	{
+		memset( sec, 0, sizeof(mesh_section_t) );
+		return offset;
+	}
+	sec->offset = start;
+	sec->count  = count;
+	sec->width  = width;
+	sec->dtype  = dtype;
+	if ( ( fwrite( zeros, 1, start - offset, file ) != start - offset ) || ( fwrite( data, 1, bytes, file ) != bytes ) )
+	{
+		fprintf( stderr, "Error: cannot write mesh file\n" );
+		exit(-1);
+	}
+	return start + bytes;
+}
+
+void write_mesh_file ( char *filename, int nDim, int nPoints, double *coords, int nFaces, int nVertsPerFace, int *faces, double *flowmap )
+{
+	mesh_header_t header;
+	uint64_t offset = sizeof(mesh_header_t);
+	FILE *file = fopen( filename, "wb" );
+
+	if ( file == NULL )
+	{
+		fprintf( stderr, "Error: cannot create mesh file %s\n", filename );
+		exit(-1);
+	}
+
+	/* Header is written last, once the section offsets are known */
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, MESH_FILE_MAGIC, sizeof(MESH_FILE_MAGIC) );
+	header.endian    = MESH_FILE_ENDIAN;
+	header.version   = MESH_FILE_VERSION;
+	header.nDim      = nDim;
+	header.nSections = MESH_NSECTIONS;
+	fwrite( &header, sizeof(header), 1, file );
+
+	offset = write_mesh_section( file, offset, &header.sections[MESH_SECTION_COORDS],  coords,  nPoints, nDim,          MESH_DTYPE_FLOAT64, sizeof(double) );
+	offset = write_mesh_section( file, offset, &header.sections[MESH_SECTION_FACES],   faces,   nFaces,  nVertsPerFace, MESH_DTYPE_INT32,   sizeof(int) );
+	offset = write_mesh_section( file, offset, &header.sections[MESH_SECTION_FLOWMAP], flowmap, nPoints, nDim,          MESH_DTYPE_FLOAT64, sizeof(double) );
+
+	if ( fseek( file, 0, SEEK_SET ) || ( fwrite( &header, sizeof(header), 1, file ) != 1 ) || fclose( file ) )
+	{
+		fprintf( stderr, "Error: cannot write mesh file %s\n", filename );
+		exit(-1);
+	}
+}
@@ -0,0 +1,167 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include "omp.h"
+
+#include "meshgen.h"
+
+/* Cube corners are numbered with bit 0 for x, bit 1 for y and bit 2 for z */
+
+/* 6 tetrahedra around the 0-7 diagonal */
+static const int kuhn_tets[6][4] = {
+	{ 0, 1, 3, 7 }, { 0, 1, 5, 7 }, { 0, 2, 3, 7 },
+	{ 0, 2, 6, 7 }, { 0, 4, 5, 7 }, { 0, 4, 6, 7 } };
+
+/* 5 tetrahedra: a central one and 4 corners, mirrored on odd cubes so that shared faces match */
+static const int five_tets[2][5][4] = {
+	{ { 1, 2, 4, 7 }, { 0, 1, 2, 4 }, { 3, 1, 2, 7 }, { 5, 1, 4, 7 }, { 6, 2, 4, 7 } },
+	{ { 0, 3, 5, 6 }, { 1, 0, 3, 5 }, { 2, 0, 3, 6 }, { 4, 0, 5, 6 }, { 7, 3, 5, 6 } } };
+
+long lattice_index ( int nDim, int *dims, int ix, int iy, int iz )
+{
+	return iy + (long) dims[1] * ( ix + (long) dims[0] * ( ( nDim == 3 ) ? iz : 0 ) );
+}
+
+/* Evenly spaced lines as numpy.linspace; bounds holds the min and max of every axis */
+int generate_lattice_coords ( int nDim, int *dims, double *bounds, double **coords, int nth )
+{
+	long nPoints = 1;
+
+	for ( int d = 0; d < nDim; d++ )
+	{
+		if ( dims[d] < 2 )
+		{
+			fprintf( stderr, "Error: the lattice needs at least 2 lines along every axis\n" );
+			exit(-1);
+		}
+		nPoints *= dims[d];
+	}
+	if ( nPoints * nDim > 0x7fffffffL )
+	{
+		fprintf( stderr, "Error: lattice of %ld points is too large\n", nPoints );
+		exit(-1);
+	}
+
+	*coords = (double *) malloc( sizeof(double) * nPoints * nDim );
+	double *c = *coords;
+
+	#pragma omp parallel for default(none) shared(nDim, dims, bounds, nPoints, c) num_threads(nth) schedule(static)
+	for ( long ip = 0; ip < nPoints; ip++ )
+	{
+		int idx[3];
+		idx[1] = ip % dims[1];
+		idx[0] = ( ip / dims[1] ) % dims[0];
+		idx[2] = ( nDim == 3 ) ? ip / ( (long) dims[1] * dims[0] ) : 0;
+		for ( int d = 0; d < nDim; d++ )
+		{
+			double step = ( bounds[2*d+1] - bounds[2*d] ) / ( dims[d] - 1 );
+			c[ip * nDim + d] = ( idx[d] == dims[d] - 1 ) ? bounds[2*d+1] : idx[d] * step + bounds[2*d];
+		}
+	}
+	return (int) nPoints;
+}
+
+int generate_lattice_faces ( int nDim, int *dims, int nTetsPerCube, int **faces, int nth )
+{
+	int  nVertsPerFace = nDim + 1;
+	int  nPerCell = ( nDim == 2 ) ? 2 : nTetsPerCube;
+	long nCells = (long) ( dims[0] - 1 ) * ( dims[1] - 1 ) * ( ( nDim == 3 ) ? dims[2] - 1 : 1 );
+
+	if ( ( nDim == 3 ) && ( nTetsPerCube != 5 ) && ( nTetsPerCube != 6 ) )
+	{
+		fprintf( stderr, "Error: cubes are split into 5 or 6 tetrahedra\n" );
+		exit(-1);
+	}
+	if ( nCells * nPerCell * nVertsPerFace > 0x7fffffffL )
+	{
+		fprintf( stderr, "Error: lattice of %ld cells is too large\n", nCells );
+		exit(-1);
+	}
+
+	*faces = (int *) malloc( sizeof(int) * nCells * nPerCell * nVertsPerFace );
+	int *f = *faces;
+
+	/* Every cell writes its own slots: no synchronization is needed */
+	#pragma omp parallel for default(none) shared(nDim, dims, nCells, nPerCell, nVertsPerFace, f, kuhn_tets, five_tets) num_threads(nth) schedule(static)
+	for ( long icell = 0; icell < nCells; icell++ )
+	{
+		int iy = icell % ( dims[1] - 1 );
+		int ix = ( icell / ( dims[1] - 1 ) ) % ( dims[0] - 1 );
+		int iz = ( nDim == 3 ) ? icell / ( (long) ( dims[1] - 1 ) * ( dims[0] - 1 ) ) : 0;
+		int *cell = f + icell * nPerCell * nVertsPerFace;
+		int corner[8];
+
+		for ( int c = 0; c < ( 1 << nDim ); c++ )
+			corner[c] = (int) lattice_index( nDim, dims, ix + ( c & 1 ), iy + ( ( c >> 1 ) & 1 ), iz + ( ( c >> 2 ) & 1 ) );
+
+		if ( nDim == 2 )
+		{
+			cell[0] = corner[0]; cell[1] = corner[1]; cell[2] = corner[3];
+			cell[3] = corner[0]; cell[4] = corner[3]; cell[5] = corner[2];
+		}
+		else if ( nPerCell == 6 )
+		{
+			for ( int t = 0; t < 6; t++ )
+				for ( int v = 0; v < 4; v++ )
+					cell[t * 4 + v] = corner[ kuhn_tets[t][v] ];
+		}
+		else
+		{
+			int parity = ( ix + iy + iz ) & 1;
+			for ( int t = 0; t < 5; t++ )
+				for ( int v = 0; v < 4; v++ )
+					cell[t * 4 + v] = corner[ five_tets[parity][t][v] ];
+		}
+	}
+	return (int) ( nCells * nPerCell );
+}
+
+/* Same layout as the files written by mesh-generation.py; %.17g keeps every double exact */
+void write_coordinates ( char *filename, int nDim, int nPoints, double *coords )
+{
+	FILE *file = fopen( filename, "w" );
+	if ( file == NULL )
+	{
+		fprintf( stderr, "Error: cannot create %s\n", filename );
+		exit(-1);
+	}
+	fprintf( file, "%d\n", nPoints );
+	for ( long i = 0; i < (long) nPoints * nDim; i++ )
+		fprintf( file, "%.17g\n", coords[i] );
+	fclose( file );
+}
+
+void write_faces ( char *filename, int nVertsPerFace, int nFaces, int *faces )
+{
+	FILE *file = fopen( filename, "w" );
+	if ( file == NULL )
+	{
+		fprintf( stderr, "Error: cannot create %s\n", filename );
+		exit(-1);
+	}
+	fprintf( file, "%d\n", nFaces );
+	for ( long i = 0; i < (long) nFaces * nVertsPerFace; i++ )
+		fprintf( file, "%d\n", faces[i] );
+	fclose( file );
+}
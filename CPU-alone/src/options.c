@@ -0,0 +1,241 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "omp.h"
+
+#include "options.h"
+#include "csvfile.h"
+#include "eigen.h"
+#include "uvaftle.h"
+
+/* Parse "kind[,chunk]" (static, dynamic, guided or auto) from the environment variable var, keeping def otherwise */
+static void read_schedule ( const char *var, sched_t def, sched_t *sched )
+{
+	char *value = getenv(var);
+	char  kind[16];
+	int   chunk = 0;
+
+	*sched = def;
+	if ( value == NULL || *value == '\0' ) return;
+	if ( sscanf( value, "%15[a-z],%d", kind, &chunk ) < 1 || chunk < 0 )
+	{
+		fprintf( stderr, "Error: wrong %s value '%s' (kind[,chunk] expected)\n", var, value );
+		exit(-1);
+	}
+	if      ( strcmp(kind, "static")  == 0 ) sched->kind = omp_sched_static;
+	else if ( strcmp(kind, "dynamic") == 0 ) sched->kind = omp_sched_dynamic;
+	else if ( strcmp(kind, "guided")  == 0 ) sched->kind = omp_sched_guided;
+	else if ( strcmp(kind, "auto")    == 0 ) sched->kind = omp_sched_auto;
+	else
+	{
+		fprintf( stderr, "Error: wrong %s schedule kind '%s' (static, dynamic, guided or auto supported)\n", var, kind );
+		exit(-1);
+	}
+	sched->chunk = chunk;
+}
+
+/* Parse a thread count from the environment variable var, keeping def otherwise */
+static int read_threads ( const char *var, int def )
+{
+	char *value = getenv(var);
+	if ( value == NULL ) return def;
+	if ( atoi(value) < 1 )
+	{
+		fprintf( stderr, "Error: wrong %s value '%s' (positive thread count expected)\n", var, value );
+		exit(-1);
+	}
+	return atoi(value);
+}
+
+/* "kind" or "kind,chunk" */
+void schedule_name ( sched_t *sched, char *name, int len )
+{
+	const char *kinds[] = { "", "static", "dynamic", "guided", "auto" };
+	if ( sched->chunk )
+		snprintf( name, len, "%s,%d", kinds[sched->kind], sched->chunk );
+	else
+		snprintf( name, len, "%s", kinds[sched->kind] );
+}
+
+/* Install the schedule used by the schedule(runtime) loops of the phase and describe it */
+void apply_schedule ( sched_t *sched, const char *phase )
+{
+	char name[32];
+	schedule_name( sched, name, sizeof(name) );
+	omp_set_schedule( sched->kind, sched->chunk );
+	printf("\nComputing %s (%s scheduler, %d threads)...                     ", phase, name, sched->nth);
+}
+
+/* Wrong option values are reported on the standard output and end the run with status 1 */
+static void wrong_option ( const char *message )
+{
+	printf("%s\n", message);
+	exit(1);
+}
+
+/* Read the FTLE_* options of a run of nSnapshots flowmaps with nth threads; faces_file names the default connectivity cache */
+void read_ftle_options ( int nDim, int nth, char *faces_file, int nSnapshots, ftle_options_t *opts )
+{
+	char   *env;
+	sched_t def_sched = { omp_sched_static, 0, nth };
+
+	/* Machine-readable per-phase report: "-" for the standard output or a file the record is appended to */
+	opts->timing_log = getenv("FTLE_TIMING");
+
+	/* Schedule of the preprocessing and FTLE loops: FTLE_SCHEDULE for both phases, FTLE_SCHEDULE_PREPROC and
+	   FTLE_SCHEDULE_FTLE for each one; FTLE_THREADS_PREPROC and FTLE_THREADS_FTLE override nth */
+	read_schedule( "FTLE_SCHEDULE", def_sched, &def_sched );
+	read_schedule( "FTLE_SCHEDULE_PREPROC", def_sched, &opts->preproc_sched );
+	read_schedule( "FTLE_SCHEDULE_FTLE", def_sched, &opts->ftle_sched );
+	opts->preproc_sched.nth = read_threads( "FTLE_THREADS_PREPROC", nth );
+	opts->ftle_sched.nth    = read_threads( "FTLE_THREADS_FTLE", nth );
+
+	/* CSR builder: "linear" (default, parallel count-and-scan) or "quadratic" (original serial scan and per-point face search) */
+	opts->preproc = getenv("FTLE_PREPROC");
+	if ( opts->preproc == NULL ) opts->preproc = (char *) "linear";
+	if ( strcmp(opts->preproc, "linear") && strcmp(opts->preproc, "quadratic") )
+		wrong_option("Wrong FTLE_PREPROC value provided (linear or quadratic supported)");
+
+	/* FTLE kernel: "auto" (default, grid if the points form a rectilinear lattice, stencil otherwise),
+	   "grid" (arithmetic neighbours on the lattice), "stencil" (precomputed axis neighbours), "simd" (stencil table solved
+	   in batches of SIMD_BATCH points), "facewalk" (neighbour search per point) or "facecode" (the same search with
+	   the vertices classified by a position code and a slot table instead of a comparison chain) */
+	env = getenv("FTLE_KERNEL");
+	if ( ( opts->kernel = uvaftle_kernel_id( env ? env : "auto" ) ) < 0 )
+		wrong_option("Wrong FTLE_KERNEL value provided (auto, grid, stencil, simd, facewalk or facecode supported)");
+
+	/* 3D eigen solver: "trig" (default, closed form, and its Newton-polished batch form in the simd and ensemble
+	   kernels) or "jacobi" (Jacobi rotations in every kernel) */
+	if ( ( env = getenv("FTLE_EIGEN") ) != NULL && env[0] )
+	{
+		if ( eigen_solver_id(env) < 0 )
+			wrong_option("Wrong FTLE_EIGEN value provided (trig or jacobi supported)");
+		eigen_set_solver( eigen_solver_id(env) );
+	}
+
+	/* Flowmap integrated from the velocity field written by mesh-generation.py instead of read from flowmap_file */
+	opts->vel_file   = getenv("FTLE_VELOCITY");
+	opts->times_file = getenv("FTLE_TIMES");
+	if ( ( opts->vel_file == NULL ) != ( opts->times_file == NULL ) )
+		wrong_option("FTLE_VELOCITY and FTLE_TIMES must be provided together");
+	if ( ( opts->vel_file != NULL ) && ( nSnapshots > 1 ) )
+		wrong_option("A flowmap series cannot be combined with FTLE_VELOCITY");
+	opts->integrator.method = FLOWMAP_RK45;
+	opts->integrator.nsteps = 100;
+	opts->integrator.rtol   = 1e-3;
+	opts->integrator.atol   = 1e-6;
+	env = getenv("FTLE_INTEGRATOR");
+	if ( env != NULL )
+	{
+		if      ( strcmp(env, "rk45") == 0 ) opts->integrator.method = FLOWMAP_RK45;
+		else if ( strcmp(env, "rk4")  == 0 ) opts->integrator.method = FLOWMAP_RK4;
+		else wrong_option("Wrong FTLE_INTEGRATOR value provided (rk45 or rk4 supported)");
+	}
+	if ( ( env = getenv("FTLE_RK4_STEPS") ) != NULL ) opts->integrator.nsteps = atoi(env);
+	if ( ( env = getenv("FTLE_RTOL") ) != NULL )      opts->integrator.rtol   = atof(env);
+	if ( ( env = getenv("FTLE_ATOL") ) != NULL )      opts->integrator.atol   = atof(env);
+	if ( ( opts->integrator.nsteps < 1 ) || !( opts->integrator.rtol > 0 ) || !( opts->integrator.atol > 0 ) )
+		wrong_option("Wrong FTLE_RK4_STEPS, FTLE_RTOL or FTLE_ATOL value provided (positive values expected)");
+
+	/* Optional lattice size "nx,ny[,nz]" checked by the grid kernel */
+	opts->grid_env = getenv("FTLE_GRID");
+	if ( ( opts->grid_env != NULL ) &&
+	     ( sscanf( opts->grid_env, "%d,%d,%d", &opts->grid_dims[0], &opts->grid_dims[1], &opts->grid_dims[2] ) != nDim ) )
+		wrong_option("Wrong FTLE_GRID value provided (nx,ny for 2D or nx,ny,nz for 3D)");
+
+	/* Ensemble mode: the flowmaps of the series are members solved together instead of consecutive snapshots */
+	opts->ensemble = 0;
+	env = getenv("FTLE_ENSEMBLE");
+	if ( ( env != NULL ) && env[0] && strcmp(env, "off") )
+	{
+		if ( strcmp(env, "on") )
+			wrong_option("Wrong FTLE_ENSEMBLE value provided (on or off supported)");
+		if ( opts->vel_file != NULL )
+			wrong_option("An ensemble cannot be combined with FTLE_VELOCITY");
+		opts->ensemble = 1;
+	}
+
+	/* Kernel precision: "double" (default), "single" (float flowmap, arithmetic and results) or "mixed" (float flowmap
+	   and results, double arithmetic) */
+	opts->precision = UVAFTLE_PRECISION_DOUBLE;
+	env = getenv("FTLE_PRECISION");
+	if ( ( env != NULL ) && env[0] )
+	{
+		if ( ( opts->precision = uvaftle_precision_id(env) ) < 0 )
+			wrong_option("Wrong FTLE_PRECISION value provided (double, single or mixed supported)");
+		if ( opts->ensemble && ( opts->precision != UVAFTLE_PRECISION_DOUBLE ) )
+			wrong_option("An ensemble is only solved in double precision");
+	}
+
+	/* Deviation of the reduced precisions from double: "off" (default) or "on", which also runs the double kernel on a
+	   double flowmap in the mesh order and keeps its results */
+	opts->precision_report = 0;
+	env = getenv("FTLE_PRECISION_REPORT");
+	if ( ( env != NULL ) && env[0] && strcmp(env, "off") )
+	{
+		if ( strcmp(env, "on") )
+			wrong_option("Wrong FTLE_PRECISION_REPORT value provided (on or off supported)");
+		opts->precision_report = ( opts->precision != UVAFTLE_PRECISION_DOUBLE );
+	}
+
+	/* Point renumbering of unstructured meshes: "none" (default) or "morton" (Z-order curve of the coordinates) */
+	env = getenv("FTLE_REORDER");
+	if ( ( opts->reorder = uvaftle_reorder_id( ( env && env[0] ) ? env : "none" ) ) < 0 )
+		wrong_option("Wrong FTLE_REORDER value provided (none or morton supported)");
+
+	/* VTU output (print2file 2): FTLE_VTU_COMPRESS sets the zlib level of its arrays, 0 (default) leaves them raw */
+	opts->vtu_level = 0;
+	if ( ( env = getenv("FTLE_VTU_COMPRESS") ) != NULL ) opts->vtu_level = atoi(env);
+	if ( ( opts->vtu_level < 0 ) || ( opts->vtu_level > 9 ) )
+		wrong_option("Wrong FTLE_VTU_COMPRESS value provided (0 to 9 supported)");
+
+	/* CSV values: "fixed" (default, the bytes of "%f") or "shortest" (shortest text that reads back as the same double) */
+	opts->csv_format = CSV_FORMAT_FIXED;
+	if ( ( env = getenv("FTLE_CSV_FORMAT") ) != NULL && env[0] && strcmp(env, "fixed") )
+	{
+		if ( strcmp(env, "shortest") )
+			wrong_option("Wrong FTLE_CSV_FORMAT value provided (fixed or shortest supported)");
+		opts->csv_format = CSV_FORMAT_SHORTEST;
+	}
+
+	/* Connectivity cache: "on" keeps it next to faces_file (<faces_file>.csr), any other value but "off" is its path */
+	opts->cache_file = NULL;
+	env = getenv("FTLE_CACHE");
+	if ( ( env != NULL ) && env[0] && strcmp(env, "off") )
+	{
+		if ( strcmp(env, "on") == 0 )
+		{
+			opts->cache_file = (char *) malloc( strlen(faces_file) + 5 );
+			sprintf( opts->cache_file, "%s.csr", faces_file );
+		}
+		else opts->cache_file = strdup(env);
+	}
+}
+
+void free_ftle_options ( ftle_options_t *opts )
+{
+	free( opts->cache_file );
+	opts->cache_file = NULL;
+}
@@ -20,106 +20,313 @@
  *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
  */ 
  
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "omp.h"
+
 #include "preprocess.h"
 
-void read_coordinates ( char *filename, int nDim, int nPoints, double *coords )
-{
-	int ip, d, check_EOF;
-	char buffer[255];
-	FILE *file;
+/* Whitespace as understood by fscanf("%s") */
+#define IS_SPACE(c) ( (c) == ' ' || (c) == '\n' || (c) == '\t' || (c) == '\r' || (c) == '\v' || (c) == '\f' )
 
-	// Open file
-	file = fopen( filename, "r" );
+typedef struct TextFile {
+	char   *data;
+	size_t  size;
+	size_t  pos;    /* first byte not consumed yet */
+} text_file_t;
 
-	// First element must be nPoints
-	check_EOF = fscanf(file, "%s", buffer);
-	if ( check_EOF == EOF )
+static void open_text_file ( char *filename, text_file_t *tf, const char *caller )
+{
+	struct stat st;
+	int fd = open( filename, O_RDONLY );
+
+	if ( ( fd < 0 ) || ( fstat( fd, &st ) < 0 ) )
 	{
-		fprintf( stderr, "Error: Unexpected EOF in read_coordinates\n" );
+		fprintf( stderr, "Error: cannot open %s in %s\n", filename, caller );
+		exit(-1);
+	}
+	tf->size = st.st_size;
+	tf->pos  = 0;
+	tf->data = ( tf->size > 0 ) ? (char *) mmap( NULL, tf->size, PROT_READ, MAP_PRIVATE, fd, 0 ) : NULL;
+	close(fd);
+	if ( tf->data == MAP_FAILED )
+	{
+		fprintf( stderr, "Error: cannot map %s in %s\n", filename, caller );
 		exit(-1);
 	}
+	if ( tf->data ) madvise( tf->data, tf->size, MADV_SEQUENTIAL );
+}
 
-	// Rest of read elements will be points' coordinates
-	for ( ip = 0; ip < nPoints; ip++ )
+static void close_text_file ( text_file_t *tf )
+{
+	if ( tf->data ) munmap( tf->data, tf->size );
+}
+
+/* Copies the next token (at most 254 chars, as the original %s buffer) and consumes it */
+static int next_token ( text_file_t *tf, char *buffer )
+{
+	size_t len = 0;
+	while ( ( tf->pos < tf->size ) && IS_SPACE( tf->data[tf->pos] ) ) tf->pos++;
+	if ( tf->pos == tf->size ) return EOF;
+	while ( ( tf->pos < tf->size ) && !IS_SPACE( tf->data[tf->pos] ) )
+	{
+		if ( len < 254 ) buffer[len++] = tf->data[tf->pos];
+		tf->pos++;
+	}
+	buffer[len] = '\0';
+	return 1;
+}
+
+/* Locale-independent atoi() of a token */
+static int parse_int ( const char *p, const char *end )
+{
+	int neg = 0;
+	long value = 0;
+	if ( ( p < end ) && ( *p == '-' || *p == '+' ) ) neg = ( *p++ == '-' );
+	while ( ( p < end ) && ( *p >= '0' ) && ( *p <= '9' ) ) value = value * 10 + ( *p++ - '0' );
+	return (int) ( neg ? -value : value );
+}
+
+/* 
+ * Locale-independent atof() of a token. Tokens with at most 2^53 as significand
+ * and a decimal exponent up to 22 are exact after one IEEE multiplication or
+ * division (Clinger's fast path), so they are correctly rounded like strtod.
+ * Up to 19 digits, the same operation in extended precision is correctly rounded
+ * too unless the result falls next to a midpoint between two doubles.
+ * Anything else goes through strtod in the C locale.
+ */
+static double parse_double ( const char *p, const char *end, locale_t c_locale )
+{
+	static const double pow10[23] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char *start = p;
+	uint64_t mantissa = 0;
+	int neg = 0, ndigits = 0, exp10 = 0, seen = 0;
+
+	if ( ( p < end ) && ( *p == '-' || *p == '+' ) ) neg = ( *p++ == '-' );
+	for ( ; ( p < end ) && ( *p >= '0' ) && ( *p <= '9' ); p++, seen++ )
 	{
-		for ( d = 0; d < nDim; d++ )
+		if ( mantissa || *p != '0' ) ndigits++;
+		if ( ndigits <= 19 ) mantissa = mantissa * 10 + ( *p - '0' );
+		else exp10++;
+	}
+	if ( ( p < end ) && ( *p == '.' ) )
+	{
+		for ( p++; ( p < end ) && ( *p >= '0' ) && ( *p <= '9' ); p++, seen++ )
 		{
-			check_EOF = fscanf(file, "%s", buffer);
-			if ( check_EOF == EOF )
+			if ( mantissa || *p != '0' ) ndigits++;
+			if ( ndigits <= 19 )
 			{
-				fprintf( stderr, "Error: Unexpected EOF in read_coordinates\n" );
-				exit(-1);
+				mantissa = mantissa * 10 + ( *p - '0' );
+				exp10--;
 			}
-			coords[ip * nDim + d] = atof(buffer);
+		}
+	}
+	if ( seen && ( p < end ) && ( *p == 'e' || *p == 'E' ) )
+	{
+		const char *q = p + 1;
+		int eneg = 0, e = 0, edigits = 0;
+		if ( ( q < end ) && ( *q == '-' || *q == '+' ) ) eneg = ( *q++ == '-' );
+		for ( ; ( q < end ) && ( *q >= '0' ) && ( *q <= '9' ); q++, edigits++ )
+			if ( e < 10000 ) e = e * 10 + ( *q - '0' );
+		if ( edigits )
+		{
+			exp10 += eneg ? -e : e;
+			p = q;
 		}
 	}
 
-	// Close file
-	fclose(file);
+	if ( seen && ( p == end ) && ( ndigits <= 19 ) && ( mantissa <= ( (uint64_t) 1 << 53 ) ) && ( exp10 >= -22 ) && ( exp10 <= 22 ) )
+	{
+		double value = (double) mantissa;
+		value = ( exp10 < 0 ) ? value / pow10[-exp10] : value * pow10[exp10];
+		return neg ? -value : value;
+	}
+#if LDBL_MANT_DIG >= 64
+	if ( seen && ( p == end ) && ( ndigits <= 19 ) && ( exp10 >= -27 ) && ( exp10 <= 27 ) )
+	{
+		/* 10^27 still has an exact 64-bit significand */
+		long double lpow10 = 1;
+		for ( int i = ( exp10 < 0 ) ? -exp10 : exp10; i > 0; i-- ) lpow10 *= 10;
+		long double lvalue = ( exp10 < 0 ) ? (long double) mantissa / lpow10 : (long double) mantissa * lpow10;
+		double value = (double) lvalue;
+		if ( lvalue == (long double) value ) return neg ? -value : value;
+		long double mid = ( (long double) value + (long double) nextafter( value, ( lvalue > value ) ? INFINITY : 0.0 ) ) / 2;
+		long double err = ldexpl( 1.0L, ilogbl( lvalue ) - ( LDBL_MANT_DIG - 1 ) );
+		if ( fabsl( lvalue - mid ) > err ) return neg ? -value : value;
+	}
+#endif
+	{
+		char buffer[255];
+		size_t len = end - start;
+		if ( len > 254 ) len = 254;
+		memcpy( buffer, start, len );
+		buffer[len] = '\0';
+		return strtod_l( buffer, NULL, c_locale );
+	}
 }
 
-void read_faces ( char *filename, int nDim, int nVertsPerFace, int nFaces, int *faces )
+/* 
+ * Parses the next ntokens whitespace-separated numbers of the file. The rest of
+ * the file is split in nth chunks starting at line boundaries; tokens are counted
+ * per chunk first, so every thread knows where its values go, and then parsed.
+ */
+static void parse_text_file ( text_file_t *tf, long ntokens, double *dvalues, int *ivalues, int nth, const char *caller )
 {
-   int iface, ielem, check_EOF;
-   char buffer[255];
-   FILE *file;
+	char  *data   = tf->data;
+	size_t begin  = tf->pos;
+	size_t size   = tf->size;
+	long  *offset = (long *) malloc( sizeof(long) * ( nth + 1 ) );
+	size_t *bound = (size_t *) malloc( sizeof(size_t) * ( nth + 1 ) );
+	locale_t c_locale = newlocale( LC_ALL_MASK, "C", (locale_t) 0 );
 
-   // Open file
-   file = fopen( filename, "r" );
+	/* Chunk boundaries right after a newline (or any blank if there are none near) */
+	bound[0]   = begin;
+	bound[nth] = size;
+	for ( int i = 1; i < nth; i++ )
+	{
+		size_t b = begin + ( size - begin ) / nth * i;
+		size_t nl = b;
+		while ( ( nl < size ) && ( data[nl] != '\n' ) ) nl++;
+		if ( nl == size ) while ( ( b < size ) && !IS_SPACE( data[b] ) ) b++;
+		else b = nl;
+		bound[i] = ( b < size ) ? b + 1 : size;
+		if ( bound[i] < bound[i-1] ) bound[i] = bound[i-1];
+	}
 
-   // First element must be nFaces
-   check_EOF = fscanf(file, "%s", buffer);
-   if ( check_EOF == EOF )
-   {
-      fprintf( stderr, "Error: Unexpected EOF in read_faces\n" );
-      exit(-1);
-   }
+	#pragma omp parallel default(none) shared(data, bound, offset, nth, ntokens, dvalues, ivalues, c_locale) num_threads(nth)
+	{
+		/* Count tokens of every chunk */
+		#pragma omp for schedule(static, 1)
+		for ( int ichunk = 0; ichunk < nth; ichunk++ )
+		{
+			long count = 0;
+			for ( size_t p = bound[ichunk]; p < bound[ichunk+1]; )
+			{
+				while ( ( p < bound[ichunk+1] ) && IS_SPACE( data[p] ) ) p++;
+				if ( p == bound[ichunk+1] ) break;
+				count++;
+				while ( ( p < bound[ichunk+1] ) && !IS_SPACE( data[p] ) ) p++;
+			}
+			offset[ichunk+1] = count;
+		}
 
-   // Rest of read elements will be faces points' indices
-   for ( iface = 0; iface < nFaces; iface++ )
-   {
-      for ( ielem = 0; ielem < nVertsPerFace; ielem++ )
-      {
-         check_EOF = fscanf(file, "%s", buffer);
-         if ( check_EOF == EOF )
-         {
-            fprintf( stderr, "Error: Unexpected EOF in read_faces\n" );
-            exit(-1);
-         }
-         faces[iface * nVertsPerFace + ielem] = atoi(buffer);
-      }
-   }
+		#pragma omp single
+		{
+			offset[0] = 0;
+			for ( int i = 1; i <= nth; i++ )
+				offset[i] = offset[i] + offset[i-1];
+		}
+
+		/* Parse them into their final position */
+		#pragma omp for schedule(static, 1)
+		for ( int ichunk = 0; ichunk < nth; ichunk++ )
+		{
+			long itoken = offset[ichunk];
+			for ( size_t p = bound[ichunk]; ( p < bound[ichunk+1] ) && ( itoken < ntokens ); )
+			{
+				size_t t;
+				while ( ( p < bound[ichunk+1] ) && IS_SPACE( data[p] ) ) p++;
+				if ( p == bound[ichunk+1] ) break;
+				for ( t = p; ( t < bound[ichunk+1] ) && !IS_SPACE( data[t] ); t++ );
+				if ( dvalues ) dvalues[itoken] = parse_double( data + p, data + t, c_locale );
+				else           ivalues[itoken] = parse_int( data + p, data + t );
+				itoken++;
+				p = t;
+			}
+		}
+	}
+
+	if ( offset[nth] < ntokens )
+	{
+		fprintf( stderr, "Error: Unexpected EOF in %s\n", caller );
+		exit(-1);
+	}
 
-   // Close file
-   fclose(file);
+	freelocale(c_locale);
+	free(offset);
+	free(bound);
 }
 
-void read_flowmap ( char *filename, int nDims, int nPoints, double *flowmap )
+/* Number of whitespace-separated tokens in data[begin, end) */
+long count_text_tokens ( char *data, size_t begin, size_t end, int nth )
 {
-   int ip, idim, check_EOF;
-   char buffer[255];
-   FILE *file;
+	long count = 0;
+	#pragma omp parallel for default(none) shared(data, begin, end) reduction(+:count) num_threads(nth) schedule(static)
+	for ( size_t p = begin; p < end; p++ )
+		count += !IS_SPACE( data[p] ) && ( ( p == begin ) || IS_SPACE( data[p-1] ) );
+	return count;
+}
 
-   // Open file
-   file = fopen( filename, "r" );
+/* The first ntokens numbers of data[begin, end), parsed in parallel as the text input files */
+void parse_text_range ( char *data, size_t begin, size_t end, long ntokens, double *values, int nth, const char *caller )
+{
+	text_file_t tf = { data, end, begin };
+	parse_text_file( &tf, ntokens, values, NULL, nth, caller );
+}
 
-   // Set velocity vectors space
-   for ( ip = 0; ip < nPoints; ip++ )
-   {
-      for ( idim = 0; idim < nDims; idim++ )
-          {
-                check_EOF = fscanf(file, "%s", buffer);
-                if ( check_EOF == EOF )
-                {
-                        fprintf( stderr, "Error: Unexpected EOF in read_flowmap\n" );
-                        exit(-1);
-                }
-                flowmap[ip * nDims + idim] = atof(buffer);
-          }
-   }
+int read_coordinates ( char *filename, int nDim, double **coords, int nth )
+{
+	int nPoints;
+	char buffer[255];
+	text_file_t tf;
+
+	open_text_file( filename, &tf, "read_coordinates" );
 
-   // Close file
-   fclose(file);
+	// First element must be nPoints
+	if ( next_token( &tf, buffer ) == EOF )
+	{
+		fprintf( stderr, "Error: Unexpected EOF in read_coordinates\n" );
+		exit(-1);
+	}
+	nPoints = atoi(buffer);
+
+	// Rest of read elements will be points' coordinates
+	*coords = (double *) malloc( sizeof(double) * nPoints * nDim );
+	parse_text_file( &tf, (long) nPoints * nDim, *coords, NULL, nth, "read_coordinates" );
+
+	close_text_file( &tf );
+	return nPoints;
+}
+
+int read_faces ( char *filename, int nDim, int nVertsPerFace, int **faces, int nth )
+{
+	int nFaces;
+	char buffer[255];
+	text_file_t tf;
+
+	open_text_file( filename, &tf, "read_faces" );
+
+	// First element must be nFaces
+	if ( next_token( &tf, buffer ) == EOF )
+	{
+		fprintf( stderr, "Error: Unexpected EOF in read_faces\n" );
+		exit(-1);
+	}
+	nFaces = atoi(buffer);
+
+	// Rest of read elements will be faces points' indices
+	*faces = (int *) malloc( sizeof(int) * nFaces * nVertsPerFace );
+	parse_text_file( &tf, (long) nFaces * nVertsPerFace, NULL, *faces, nth, "read_faces" );
+
+	close_text_file( &tf );
+	return nFaces;
+}
+
+void read_flowmap ( char *filename, int nDims, int nPoints, double *flowmap, int nth )
+{
+	text_file_t tf;
+
+	open_text_file( filename, &tf, "read_flowmap" );
+	parse_text_file( &tf, (long) nPoints * nDims, flowmap, NULL, nth, "read_flowmap" );
+	close_text_file( &tf );
 }
 
 void create_nFacesPerPoint_vector ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint )
@@ -143,6 +350,62 @@ void create_nFacesPerPoint_vector ( int nDim, int nPoints, int nFaces, int nVert
         }	
 }
 
+void create_nFacesPerPoint_vector_parallel ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint, int nth )
+{
+	int *carry = (int *) malloc( sizeof(int) * ( nth + 1 ) );
+
+	#pragma omp parallel default(none) shared(nPoints, nFaces, nVertsPerFace, faces, nFacesPerPoint, carry) num_threads(nth)
+	{
+		int ith  = omp_get_thread_num();
+		int nthr = omp_get_num_threads();
+		int lo   = (int) ( ( (long) nPoints * ith ) / nthr );
+		int hi   = (int) ( ( (long) nPoints * ( ith + 1 ) ) / nthr );
+
+		for ( int ip = lo; ip < hi; ip++ )
+			nFacesPerPoint[ip] = 0;
+		#pragma omp barrier
+
+		/* Atomics are only needed when several threads share the points */
+		if ( nthr == 1 )
+		{
+			for ( long i = 0; i < (long) nFaces * nVertsPerFace; i++ )
+				nFacesPerPoint[faces[i]]++;
+		}
+		else
+		{
+			#pragma omp for schedule(static)
+			for ( int iface = 0; iface < nFaces; iface++ )
+			{
+				for ( int ipf = 0; ipf < nVertsPerFace; ipf++ )
+				{
+					int ip = faces[(long) iface * nVertsPerFace + ipf];
+					#pragma omp atomic update
+					nFacesPerPoint[ip]++;
+				}
+			}
+		}
+
+		/* Block-wise inclusive scan: local scan, carry of previous blocks, fix-up */
+		for ( int ip = lo + 1; ip < hi; ip++ )
+			nFacesPerPoint[ip] = nFacesPerPoint[ip] + nFacesPerPoint[ip-1];
+		carry[ith + 1] = ( hi > lo ) ? nFacesPerPoint[hi-1] : 0;
+		#pragma omp barrier
+
+		#pragma omp single
+		{
+			carry[0] = 0;
+			for ( int i = 1; i <= nthr; i++ )
+				carry[i] = carry[i] + carry[i-1];
+		}
+
+		if ( carry[ith] )
+			for ( int ip = lo; ip < hi; ip++ )
+				nFacesPerPoint[ip] = nFacesPerPoint[ip] + carry[ith];
+	}
+
+	free(carry);
+}
+
 void create_facesPerPoint_vector ( int nDim, int ip, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint, int *facesPerPoint )
 {
 	int count, iface, ipf, nFacesP, iFacesP;   
@@ -162,3 +425,212 @@ void create_facesPerPoint_vector ( int nDim, int ip, int nFaces, int nVertsPerFa
                 }
 }
 
+
+void create_facesPerPoint_vector_linear ( int nDim, int nPoints, int nFaces, int nVertsPerFace, int *faces, int *nFacesPerPoint, int *facesPerPoint, int nth )
+{
+	int *fill = (int *) malloc( sizeof(int) * nPoints );
+
+	#pragma omp parallel default(none) shared(nPoints, nFaces, nVertsPerFace, faces, nFacesPerPoint, facesPerPoint, fill) num_threads(nth)
+	{
+		/* Next free slot of every point in facesPerPoint */
+		#pragma omp for schedule(static)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			fill[ip] = ( ip == 0 ) ? 0 : nFacesPerPoint[ip-1];
+
+		/* Single pass over faces scattering each face to its vertices */
+		#pragma omp for schedule(static)
+		for ( int iface = 0; iface < nFaces; iface++ )
+		{
+			for ( int ipf = 0; ipf < nVertsPerFace; ipf++ )
+			{
+				int ip = faces[(long) iface * nVertsPerFace + ipf];
+				int pos;
+				#pragma omp atomic capture
+				pos = fill[ip]++;
+				facesPerPoint[pos] = iface;
+			}
+		}
+
+		/* Threads scatter in any order: sort each point's faces as the face search does */
+		#pragma omp for schedule(dynamic, 1024)
+		for ( int ip = 0; ip < nPoints; ip++ )
+		{
+			int iFacesP = ( ip == 0 ) ? 0 : nFacesPerPoint[ip-1];
+			for ( int i = iFacesP + 1; i < nFacesPerPoint[ip]; i++ )
+			{
+				int iface = facesPerPoint[i];
+				int j = i - 1;
+				while ( ( j >= iFacesP ) && ( facesPerPoint[j] > iface ) )
+				{
+					facesPerPoint[j+1] = facesPerPoint[j];
+					j--;
+				}
+				facesPerPoint[j+1] = iface;
+			}
+		}
+	}
+
+	free(fill);
+}
+
+void create_stencil_table ( int nDim, int nPoints, int nVertsPerFace, double *coords, int *faces, int *nFacesPerPoint, int *facesPerPoint, int *stencil, double *invDenom, int nth )
+{
+	#pragma omp parallel for default(none) shared(nDim, nPoints, nVertsPerFace, coords, faces, nFacesPerPoint, facesPerPoint, stencil, invDenom) num_threads(nth) schedule(static)
+	for ( int ip = 0; ip < nPoints; ip++ )
+	{
+		int *closest = stencil + ip * 2 * nDim;
+		int iFacesP  = ( ip == 0 ) ? 0 : nFacesPerPoint[ip-1];
+		int count    = 0;
+
+		for ( int k = 0; k < 2 * nDim; k++ )
+			closest[k] = -1;
+
+		/* Same search as compute_gradient: first vertex found on each side of each axis */
+		for ( int iface = iFacesP; ( iface < nFacesPerPoint[ip] ) && ( count < 2 * nDim ); iface++ )
+		{
+			int idxface = facesPerPoint[iface];
+			for ( int ivert = 0; ( ivert < nVertsPerFace ) && ( count < 2 * nDim ); ivert++ )
+			{
+				int ivertex = faces[idxface * nVertsPerFace + ivert];
+				int axis = -1, ndiff = 0;
+				if ( ivertex == ip ) continue;
+				for ( int d = 0; d < nDim; d++ )
+				{
+					if ( coords[ivertex * nDim + d] != coords[ip * nDim + d] )
+					{
+						axis = d;
+						ndiff++;
+					}
+				}
+				if ( ndiff != 1 ) continue;
+
+				/* (.., i-1, ..) goes to slot 2*axis and (.., i+1, ..) to slot 2*axis+1 */
+				int slot;
+				if      ( coords[ivertex * nDim + axis] < coords[ip * nDim + axis] ) slot = 2 * axis;
+				else if ( coords[ivertex * nDim + axis] > coords[ip * nDim + axis] ) slot = 2 * axis + 1;
+				else continue;
+				if ( closest[slot] == -1 )
+				{
+					closest[slot] = ivertex;
+					count++;
+				}
+			}
+		}
+
+		for ( int d = 0; d < nDim; d++ )
+		{
+			if ( ( closest[2*d] > -1 ) && ( closest[2*d+1] > -1 ) )
+				invDenom[ip * nDim + d] = 1.0 / ( coords[closest[2*d+1] * nDim + d] - coords[closest[2*d] * nDim + d] );
+			else
+				invDenom[ip * nDim + d] = 0;
+		}
+	}
+}
+
+/* Stencil table of a lattice: the axis neighbours follow from the indices, -1 beyond the borders */
+void create_grid_stencil_table ( grid_t *grid, int nPoints, int *stencil, double *invDenom, int nth )
+{
+	int nDim = grid->nDim;
+	#pragma omp parallel for default(none) shared(grid, nDim, nPoints, stencil, invDenom) num_threads(nth) schedule(static)
+	for ( int ip = 0; ip < nPoints; ip++ )
+	{
+		for ( int d = 0; d < nDim; d++ )
+		{
+			int i = ( ip / grid->strides[d] ) % grid->dims[d];
+			stencil[ip * 2 * nDim + 2 * d]     = ( i > 0 ) ? ip - grid->strides[d] : -1;
+			stencil[ip * 2 * nDim + 2 * d + 1] = ( i < grid->dims[d] - 1 ) ? ip + grid->strides[d] : -1;
+			invDenom[ip * nDim + d] = grid->invDenom[d][i];
+		}
+	}
+}
+
+int detect_structured_grid ( int nDim, int nPoints, double *coords, int *dims, grid_t *grid, int nth )
+{
+	int stride = 1, valid = 1;
+
+	grid->nDim = nDim;
+	for ( int d = 0; d < 3; d++ )
+	{
+		grid->axis[d]     = NULL;
+		grid->invDenom[d] = NULL;
+	}
+
+	/* Point 0 and point stride differ in one axis only: the next slower varying one */
+	for ( int level = 0; level < nDim; level++ )
+	{
+		int axis = -1, n = 1;
+		if ( stride >= nPoints ) { free_structured_grid( grid ); return 0; }
+		for ( int d = 0; d < nDim; d++ )
+		{
+			if ( coords[stride * nDim + d] != coords[d] )
+			{
+				if ( axis != -1 ) { free_structured_grid( grid ); return 0; }
+				axis = d;
+			}
+		}
+		if ( ( axis == -1 ) || ( grid->axis[axis] != NULL ) ) { free_structured_grid( grid ); return 0; }
+
+		for ( n = 1; (long) n * stride < nPoints; n++ )
+		{
+			int differs = 0;
+			for ( int d = 0; d < nDim; d++ )
+				if ( ( d != axis ) && ( coords[(long) n * stride * nDim + d] != coords[d] ) ) differs = 1;
+			if ( differs ) break;
+		}
+		if ( ( dims != NULL ) && ( dims[axis] != n ) ) { free_structured_grid( grid ); return 0; }
+
+		grid->order[level]   = axis;
+		grid->dims[axis]     = n;
+		grid->strides[axis]  = stride;
+		grid->axis[axis]     = (double *) malloc( sizeof(double) * n );
+		grid->invDenom[axis] = (double *) malloc( sizeof(double) * n );
+		for ( int i = 0; i < n; i++ )
+			grid->axis[axis][i] = coords[(long) i * stride * nDim + axis];
+		stride = stride * n;
+	}
+
+	if ( stride != nPoints ) valid = 0;
+
+	/* Lattice lines must be strictly monotonic along every axis */
+	for ( int d = 0; ( d < nDim ) && valid; d++ )
+	{
+		double *x = grid->axis[d];
+		int increasing = ( x[1] > x[0] );
+		for ( int i = 1; i < grid->dims[d]; i++ )
+			if ( increasing ? !( x[i] > x[i-1] ) : !( x[i] < x[i-1] ) ) valid = 0;
+	}
+
+	/* Every point must lie on its lattice node */
+	if ( valid )
+	{
+		#pragma omp parallel for default(none) shared(nDim, nPoints, coords, grid) reduction(&&:valid) num_threads(nth) schedule(static)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			for ( int d = 0; d < nDim; d++ )
+				valid = valid && ( coords[ip * nDim + d] == grid->axis[d][( ip / grid->strides[d] ) % grid->dims[d]] );
+	}
+
+	if ( !valid )
+	{
+		free_structured_grid( grid );
+		return 0;
+	}
+
+	for ( int d = 0; d < nDim; d++ )
+	{
+		int n = grid->dims[d];
+		for ( int i = 0; i < n; i++ )
+			grid->invDenom[d][i] = ( ( i > 0 ) && ( i < n - 1 ) ) ? 1.0 / ( grid->axis[d][i+1] - grid->axis[d][i-1] ) : 0;
+	}
+	return 1;
+}
+
+void free_structured_grid ( grid_t *grid )
+{
+	for ( int d = 0; d < 3; d++ )
+	{
+		free( grid->axis[d] );
+		free( grid->invDenom[d] );
+		grid->axis[d]     = NULL;
+		grid->invDenom[d] = NULL;
+	}
+}
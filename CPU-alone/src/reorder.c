@@ -0,0 +1,160 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "omp.h"
+
+#include "reorder.h"
+
+/* Insert two (2D) or three (3D) zero bits between the bits of x */
+static inline uint64_t spread_bits_2D ( uint64_t x )
+{
+	x &= 0xffffffffULL;
+	x = ( x | ( x << 16 ) ) & 0x0000ffff0000ffffULL;
+	x = ( x | ( x << 8 ) )  & 0x00ff00ff00ff00ffULL;
+	x = ( x | ( x << 4 ) )  & 0x0f0f0f0f0f0f0f0fULL;
+	x = ( x | ( x << 2 ) )  & 0x3333333333333333ULL;
+	x = ( x | ( x << 1 ) )  & 0x5555555555555555ULL;
+	return x;
+}
+
+static inline uint64_t spread_bits_3D ( uint64_t x )
+{
+	x &= 0x1fffffULL;
+	x = ( x | ( x << 32 ) ) & 0x001f00000000ffffULL;
+	x = ( x | ( x << 16 ) ) & 0x001f0000ff0000ffULL;
+	x = ( x | ( x << 8 ) )  & 0x100f00f00f00f00fULL;
+	x = ( x | ( x << 4 ) )  & 0x10c30c30c30c30c3ULL;
+	x = ( x | ( x << 2 ) )  & 0x1249249249249249ULL;
+	return x;
+}
+
+/* Points sorted by the Morton code of their coordinates quantised in the bounding box (32 bits per axis in 2D, 21 in 3D);
+   ties keep the original order */
+void morton_order ( int nDim, int nPoints, double *coords, int *perm, int nth )
+{
+	double lo[3] = { 0, 0, 0 }, scale[3];
+	int    bits = ( nDim == 2 ) ? 32 : 21;
+	uint64_t *key = (uint64_t *) malloc( sizeof(uint64_t) * nPoints );
+	uint64_t *tmpkey = (uint64_t *) malloc( sizeof(uint64_t) * nPoints );
+	int      *tmp = (int *) malloc( sizeof(int) * nPoints );
+
+	for ( int d = 0; d < nDim; d++ )
+	{
+		double l = coords[d], h = coords[d];
+		#pragma omp parallel for default(none) shared(nDim, nPoints, coords, d) reduction(min:l) reduction(max:h) num_threads(nth) schedule(static)
+		for ( int ip = 0; ip < nPoints; ip++ )
+		{
+			double x = coords[ip * nDim + d];
+			if ( x < l ) l = x;
+			if ( x > h ) h = x;
+		}
+		lo[d] = l;
+		scale[d] = ( h > l ) ? ( (double) ( ( 1ULL << bits ) - 1 ) ) / ( h - l ) : 0;
+	}
+
+	#pragma omp parallel for default(none) shared(nDim, nPoints, coords, lo, scale, key, perm) num_threads(nth) schedule(static)
+	for ( int ip = 0; ip < nPoints; ip++ )
+	{
+		uint64_t code = 0;
+		for ( int d = 0; d < nDim; d++ )
+		{
+			uint64_t q = (uint64_t) ( ( coords[ip * nDim + d] - lo[d] ) * scale[d] );
+			code |= ( ( nDim == 2 ) ? spread_bits_2D( q ) : spread_bits_3D( q ) ) << d;
+		}
+		key[ip]  = code;
+		perm[ip] = ip;
+	}
+
+	/* Stable LSD radix sort, 8 bits per pass; passes over bytes that are equal for all keys are skipped */
+	for ( int shift = 0; shift < 64; shift += 8 )
+	{
+		long count[257];
+		memset( count, 0, sizeof(count) );
+		for ( int i = 0; i < nPoints; i++ )
+			count[ ( ( key[i] >> shift ) & 0xff ) + 1 ]++;
+		if ( count[ ( ( key[0] >> shift ) & 0xff ) + 1 ] == nPoints ) continue;
+		for ( int b = 0; b < 256; b++ )
+			count[b + 1] += count[b];
+		for ( int i = 0; i < nPoints; i++ )
+		{
+			long pos = count[ ( key[i] >> shift ) & 0xff ]++;
+			tmpkey[pos] = key[i];
+			tmp[pos]    = perm[i];
+		}
+		memcpy( key, tmpkey, sizeof(uint64_t) * nPoints );
+		memcpy( perm, tmp, sizeof(int) * nPoints );
+	}
+
+	free(key);
+	free(tmpkey);
+	free(tmp);
+}
+
+void invert_permutation ( int nPoints, int *perm, int *iperm, int nth )
+{
+	#pragma omp parallel for default(none) shared(nPoints, perm, iperm) num_threads(nth) schedule(static)
+	for ( int i = 0; i < nPoints; i++ )
+		iperm[ perm[i] ] = i;
+}
+
+/* dst[new] = src[perm[new]], width values per point */
+void permute_points ( int nPoints, int width, int *perm, double *src, double *dst, int nth )
+{
+	#pragma omp parallel for default(none) shared(nPoints, width, perm, src, dst) num_threads(nth) schedule(static)
+	for ( int i = 0; i < nPoints; i++ )
+		memcpy( dst + (long) i * width, src + (long) perm[i] * width, sizeof(double) * width );
+}
+
+/* Vertices renumbered with iperm and faces sorted (stably) by their lowest new vertex, so that the faces of
+   neighbouring points are close in memory too */
+void renumber_faces ( int nPoints, int nFaces, int nVertsPerFace, int *iperm, int *faces, int *dst, int nth )
+{
+	int  *minv  = (int *) malloc( sizeof(int) * nFaces );
+	long *start = (long *) calloc( nPoints + 1, sizeof(long) );
+
+	#pragma omp parallel for default(none) shared(nFaces, nVertsPerFace, iperm, faces, minv) num_threads(nth) schedule(static)
+	for ( int f = 0; f < nFaces; f++ )
+	{
+		int m = iperm[ faces[f * nVertsPerFace] ];
+		for ( int v = 1; v < nVertsPerFace; v++ )
+			if ( iperm[ faces[f * nVertsPerFace + v] ] < m ) m = iperm[ faces[f * nVertsPerFace + v] ];
+		minv[f] = m;
+	}
+
+	for ( int f = 0; f < nFaces; f++ )
+		start[ minv[f] + 1 ]++;
+	for ( int i = 0; i < nPoints; i++ )
+		start[i + 1] += start[i];
+	for ( int f = 0; f < nFaces; f++ )
+	{
+		long pos = start[ minv[f] ]++;
+		for ( int v = 0; v < nVertsPerFace; v++ )
+			dst[pos * nVertsPerFace + v] = iperm[ faces[f * nVertsPerFace + v] ];
+	}
+
+	free(minv);
+	free(start);
+}
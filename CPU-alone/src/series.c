@@ -0,0 +1,243 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+#include <unistd.h>
+#include "omp.h"
+
+#include "series.h"
+#include "preprocess.h"
+#include "timing.h"
+
+static void add_snapshot ( flowmap_series_t *series, int *capacity, const char *file, double t_eval )
+{
+	if ( series->n == *capacity )
+	{
+		*capacity = ( *capacity ) ? 2 * ( *capacity ) : 16;
+		series->files  = (char **)  realloc( series->files,  sizeof(char *) * ( *capacity ) );
+		series->t_eval = (double *) realloc( series->t_eval, sizeof(double) * ( *capacity ) );
+	}
+	series->files[ series->n ]  = strdup( file );
+	series->t_eval[ series->n ] = t_eval;
+	series->n++;
+}
+
+/* spec: "@list" (one "<flowmap_file> [t_eval]" per line, '#' starts a comment, relative names are taken from the
+   directory of the list), a glob pattern or a single file; snapshots without their own time take t_eval */
+void read_flowmap_series ( char *spec, double t_eval, flowmap_series_t *series )
+{
+	int capacity = 0;
+
+	series->n      = 0;
+	series->files  = NULL;
+	series->t_eval = NULL;
+
+	if ( spec[0] == '@' )
+	{
+		char line[4096], file[4096], path[8192];
+		double t;
+		const char *slash = strrchr( spec + 1, '/' );
+		int dirlen = ( slash != NULL ) ? (int) ( slash - ( spec + 1 ) ) + 1 : 0;
+		FILE *fp = fopen( spec + 1, "r" );
+		if ( fp == NULL )
+		{
+			fprintf( stderr, "Error: cannot open flowmap list %s\n", spec + 1 );
+			exit(-1);
+		}
+		while ( fgets( line, sizeof(line), fp ) != NULL )
+		{
+			char *hash = strchr( line, '#' );
+			if ( hash != NULL ) *hash = '\0';
+			int nread = sscanf( line, "%4095s %lf", file, &t );
+			if ( nread < 1 ) continue;
+			if ( file[0] == '/' )
+				snprintf( path, sizeof(path), "%s", file );
+			else
+				snprintf( path, sizeof(path), "%.*s%s", dirlen, spec + 1, file );
+			add_snapshot( series, &capacity, path, ( nread == 2 ) ? t : t_eval );
+		}
+		fclose( fp );
+	}
+	else if ( strpbrk( spec, "*?[" ) != NULL )
+	{
+		glob_t g;
+		if ( glob( spec, 0, NULL, &g ) == 0 )
+		{
+			for ( size_t i = 0; i < g.gl_pathc; i++ )
+				add_snapshot( series, &capacity, g.gl_pathv[i], t_eval );
+			globfree( &g );
+		}
+	}
+	else
+		add_snapshot( series, &capacity, spec, t_eval );
+
+	if ( series->n == 0 )
+	{
+		fprintf( stderr, "Error: no flowmap files found in %s\n", spec );
+		exit(-1);
+	}
+}
+
+void free_flowmap_series ( flowmap_series_t *series )
+{
+	for ( int i = 0; i < series->n; i++ )
+		free( series->files[i] );
+	free( series->files );
+	free( series->t_eval );
+	series->n = 0;
+}
+
+static void *prefetch_flowmap ( void *arg )
+{
+	flowmap_prefetch_t *pf = (flowmap_prefetch_t *) arg;
+	double start = omp_get_wtime();
+
+	if ( is_mesh_file( pf->filename ) )
+	{
+		int nFlowmap;
+		long page = sysconf( _SC_PAGESIZE );
+		volatile char sink = 0;
+
+		open_mesh_file( pf->filename, &pf->mf );
+		pf->flowmap = (double *) mesh_file_section( &pf->mf, MESH_SECTION_FLOWMAP, pf->nDim, &nFlowmap );
+		if ( nFlowmap != pf->nPoints )
+		{
+			fprintf( stderr, "Error: flowmap %s has %d points but the mesh has %d\n", pf->filename, nFlowmap, pf->nPoints );
+			exit(-1);
+		}
+		/* Fault the pages in now, so the FTLE loop finds them resident */
+		pf->bytes = (long long) sizeof(double) * pf->nPoints * pf->nDim;
+		for ( long long off = 0; off < pf->bytes; off += page )
+			sink += ( (char *) pf->flowmap )[off];
+	}
+	else
+	{
+		if ( pf->flowmap == NULL )
+			pf->flowmap = (double *) malloc( sizeof(double) * pf->nPoints * pf->nDim );
+		read_flowmap( pf->filename, pf->nDim, pf->nPoints, pf->flowmap, 1 );
+		pf->bytes = timing_file_size( pf->filename );
+	}
+	pf->seconds = omp_get_wtime() - start;
+	return NULL;
+}
+
+/* Read the next snapshot on a thread of its own, outside the OpenMP team that solves the current one */
+void start_flowmap_prefetch ( flowmap_prefetch_t *pf, char *filename, int nDim, int nPoints, double *buffer )
+{
+	pf->filename = filename;
+	pf->nDim     = nDim;
+	pf->nPoints  = nPoints;
+	pf->flowmap  = buffer;
+	pf->mf.map   = NULL;
+	pf->seconds  = 0;
+	pf->bytes    = 0;
+	if ( pthread_create( &pf->thread, NULL, prefetch_flowmap, pf ) )
+	{
+		fprintf( stderr, "Error: cannot start the flowmap reader thread\n" );
+		exit(-1);
+	}
+}
+
+/* Wait for the snapshot; pf->mf.map tells whether it is mapped or held in pf->flowmap */
+double *finish_flowmap_prefetch ( flowmap_prefetch_t *pf )
+{
+	pthread_join( pf->thread, NULL );
+	return pf->flowmap;
+}
+
+/* Make the prefetched snapshot the current one: the mapping or buffer of the previous one is released,
+   except for one buffer kept in *spare for the next read */
+double *swap_prefetched_flowmap ( flowmap_prefetch_t *pf, double *current, mesh_file_t *mf_current, double **spare )
+{
+	int     old_mapped = ( mf_current->map != NULL );
+	double *next       = finish_flowmap_prefetch( pf );
+
+	if ( old_mapped ) close_mesh_file( mf_current );
+	if ( pf->mf.map == NULL )
+		*spare = old_mapped ? NULL : current;
+	else if ( !old_mapped )
+	{
+		if ( *spare == NULL ) *spare = current; else free(current);
+	}
+	*mf_current = pf->mf;
+	return next;
+}
+
+/* Ensemble layout of K members: flowmapK[( point * nDim + component ) * K + member], written in one contiguous pass */
+void interleave_flowmaps ( int nPoints, int nDim, int K, double **members, double *flowmapK, int nth )
+{
+	#pragma omp parallel for default(none) shared(nPoints, nDim, K, members, flowmapK) num_threads(nth) schedule(static)
+	for ( long i = 0; i < (long) nPoints * nDim; i++ )
+		for ( int k = 0; k < K; k++ )
+			flowmapK[ i * K + k ] = members[k][i];
+}
+
+/* Members 1 to series->n - 1 of an ensemble, read next to member 0 (flowmap, mapped through mf if a mesh file) and
+   interleaved point by point, so that one pass over the mesh solves all of them; the members are released */
+double *read_ensemble_members ( flowmap_series_t *series, int nDim, int nPoints, double *flowmap, mesh_file_t *mf, timing_t *timing, int nth )
+{
+	int          nMembers = series->n;
+	double      *flowmapK, **members;
+	mesh_file_t *mf_members;
+
+	members    = (double **)     malloc( sizeof(double *) * nMembers );
+	mf_members = (mesh_file_t *) malloc( sizeof(mesh_file_t) * nMembers );
+	members[0]    = flowmap;
+	mf_members[0] = *mf;
+	timing_begin( timing );
+	for ( int k = 1; k < nMembers; k++ )
+	{
+		int nFlowmap;
+		mf_members[k].map = NULL;
+		if ( is_mesh_file( series->files[k] ) )
+		{
+			open_mesh_file( series->files[k], &mf_members[k] );
+			members[k] = (double *) mesh_file_section( &mf_members[k], MESH_SECTION_FLOWMAP, nDim, &nFlowmap );
+			if ( nFlowmap != nPoints )
+			{
+				fprintf( stderr, "Error: flowmap %s has %d points but the mesh has %d\n", series->files[k], nFlowmap, nPoints );
+				exit(-1);
+			}
+			timing_end( timing, "read_flowmap", 1, (long long) sizeof(double) * nPoints * nDim );
+		}
+		else
+		{
+			members[k] = (double *) malloc( sizeof(double) * nPoints * nDim );
+			read_flowmap ( series->files[k], nDim, nPoints, members[k], nth );
+			timing_end( timing, "read_flowmap", nth, timing_file_size( series->files[k] ) );
+		}
+	}
+	flowmapK = (double *) malloc( sizeof(double) * nPoints * nDim * nMembers );
+	interleave_flowmaps( nPoints, nDim, nMembers, members, flowmapK, nth );
+	timing_end( timing, "interleave", nth, 0 );
+	for ( int k = 0; k < nMembers; k++ )
+	{
+		if ( mf_members[k].map ) close_mesh_file( &mf_members[k] ); else free(members[k]);
+	}
+	free(members);
+	free(mf_members);
+	mf->map = NULL;
+	return flowmapK;
+}
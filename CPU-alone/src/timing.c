@@ -0,0 +1,195 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "omp.h"
+#include "timing.h"
+
+void timing_init ( timing_t *t )
+{
+	memset( t, 0, sizeof(timing_t) );
+	t->start = t->begin = omp_get_wtime();
+}
+
+void timing_begin ( timing_t *t )
+{
+	t->begin = omp_get_wtime();
+}
+
+/* Record a phase measured elsewhere; phases repeated under the same name (one per snapshot) are accumulated */
+void timing_add ( timing_t *t, const char *name, double seconds, int nth, long long bytes )
+{
+	timing_phase_t *p = NULL;
+	for ( int i = 0; i < t->nPhases; i++ )
+		if ( strncmp( t->phases[i].name, name, TIMING_NAME_LEN ) == 0 ) p = &t->phases[i];
+	if ( p == NULL )
+	{
+		if ( t->nPhases == TIMING_MAX_PHASES )
+		{
+			fprintf( stderr, "Error: too many timed phases (%d supported)\n", TIMING_MAX_PHASES );
+			exit(-1);
+		}
+		p = &t->phases[ t->nPhases++ ];
+		snprintf( p->name, TIMING_NAME_LEN, "%s", name );
+	}
+	p->seconds += seconds;
+	p->bytes   += bytes;
+	p->nth      = nth;
+	p->calls++;
+}
+
+/* Close the current phase and return its duration in seconds */
+double timing_end ( timing_t *t, const char *name, int nth, long long bytes )
+{
+	double seconds = omp_get_wtime() - t->begin;
+	timing_add( t, name, seconds, nth, bytes );
+	t->begin = omp_get_wtime();
+	return seconds;
+}
+
+/* Hardware cache or branch misses (event TIMING_*_MISSES) of the process and of the threads it creates afterwards
+   (open it before the first parallel region, so the OpenMP team inherits it); -1 where perf events are not available */
+int timing_counter_open ( int event )
+{
+	struct perf_event_attr attr;
+
+	memset( &attr, 0, sizeof(attr) );
+	attr.size           = sizeof(attr);
+	attr.type           = PERF_TYPE_HARDWARE;
+	attr.config         = ( event == TIMING_BRANCH_MISSES ) ? PERF_COUNT_HW_BRANCH_MISSES : PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled       = 1;
+	attr.inherit        = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	return (int) syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+}
+
+void timing_counter_start ( int fd )
+{
+	if ( fd < 0 ) return;
+	ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+	ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+}
+
+/* Events counted since timing_counter_start, -1 if unavailable */
+long long timing_counter_stop ( int fd )
+{
+	long long count;
+	if ( fd < 0 ) return -1;
+	ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+	if ( read( fd, &count, sizeof(count) ) != sizeof(count) ) return -1;
+	return count;
+}
+
+void timing_counter_close ( int fd )
+{
+	if ( fd >= 0 ) close( fd );
+}
+
+static char *timing_new_field ( timing_t *t )
+{
+	if ( t->nFields == TIMING_MAX_FIELDS )
+	{
+		fprintf( stderr, "Error: too many timing fields (%d supported)\n", TIMING_MAX_FIELDS );
+		exit(-1);
+	}
+	return t->fields[ t->nFields++ ];
+}
+
+void timing_set_int ( timing_t *t, const char *key, long long value )
+{
+	snprintf( timing_new_field( t ), TIMING_FIELD_LEN, "\"%s\": %lld", key, value );
+}
+
+void timing_set_double ( timing_t *t, const char *key, double value )
+{
+	snprintf( timing_new_field( t ), TIMING_FIELD_LEN, "\"%s\": %.9g", key, value );
+}
+
+/* Strings are escaped as JSON requires; anything that does not fit is truncated */
+void timing_set_string ( timing_t *t, const char *key, const char *value )
+{
+	char *field = timing_new_field( t );
+	int   len   = snprintf( field, TIMING_FIELD_LEN, "\"%s\": \"", key );
+
+	for ( const char *c = value; *c && ( len < TIMING_FIELD_LEN - 8 ); c++ )
+	{
+		if ( *c == '"' || *c == '\\' )
+			len += sprintf( field + len, "\\%c", *c );
+		else if ( (unsigned char) *c < 0x20 )
+			len += sprintf( field + len, "\\u%04x", *c );
+		else
+			field[len++] = *c;
+	}
+	field[len++] = '"';
+	field[len]   = '\0';
+}
+
+long long timing_file_size ( const char *filename )
+{
+	struct stat st;
+	return ( stat( filename, &st ) == 0 ) ? (long long) st.st_size : 0;
+}
+
+/* One JSON object per line, so that the records can be appended to a log */
+void timing_write_json ( timing_t *t, FILE *fp )
+{
+	char      stamp[32];
+	time_t    now = time(NULL);
+	double    total = 0;
+	long long bytes = 0;
+
+	strftime( stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now) );
+	fprintf( fp, "{\"timestamp\": \"%s\"", stamp );
+	for ( int i = 0; i < t->nFields; i++ )
+		fprintf( fp, ", %s", t->fields[i] );
+	fprintf( fp, ", \"phases\": [" );
+	for ( int i = 0; i < t->nPhases; i++ )
+	{
+		timing_phase_t *p = &t->phases[i];
+		fprintf( fp, "%s{\"name\": \"%s\", \"seconds\": %.9f, \"threads\": %d, \"bytes\": %lld, \"bytes_per_second\": %.9g, \"calls\": %d}",
+			( i > 0 ) ? ", " : "", p->name, p->seconds, p->nth, p->bytes, ( p->seconds > 0 ) ? p->bytes / p->seconds : 0.0, p->calls );
+		total += p->seconds;
+		bytes += p->bytes;
+	}
+	fprintf( fp, "], \"phases_seconds\": %.9f, \"wall_seconds\": %.9f, \"bytes\": %lld}\n", total, omp_get_wtime() - t->start, bytes );
+}
+
+/* destination: "-" for the standard output, otherwise a file the record is appended to */
+void timing_report ( timing_t *t, const char *destination )
+{
+	FILE *fp = ( strcmp( destination, "-" ) == 0 ) ? stdout : fopen( destination, "a" );
+	if ( fp == NULL )
+	{
+		fprintf( stderr, "Error: cannot open timing log %s\n", destination );
+		exit(-1);
+	}
+	timing_write_json( t, fp );
+	if ( fp == stdout ) fflush( fp ); else fclose( fp );
+}
@@ -0,0 +1,602 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "omp.h"
+
+#include "ftle.h"
+#include "arithmetic.h"
+#include "preprocess.h"
+#include "reorder.h"
+#include "uvaftle.h"
+
+enum { PHASE_DETECT_GRID = 0, PHASE_REORDER = 1, PHASE_COUNT_SCAN = 2, PHASE_CSR_BUILD = 3, PHASE_STENCIL_TABLE = 4, NPHASES = 5 };
+
+static const char *kernel_names[] = { "auto", "grid", "stencil", "simd", "facewalk", "facecode" };
+static const char *precision_names[] = { "double", "single", "mixed" };
+static const char *reorder_names[] = { "none", "morton" };
+static const char *phase_names[]  = { "detect_grid", "reorder", "count_scan", "csr_build", "stencil_table" };
+
+struct UvaFtleMesh {
+	int      nDim;
+	int      nVertsPerFace;
+	int      nPoints;
+	int      nFaces;
+	int      kernel;        /* resolved: never UVAFTLE_KERNEL_AUTO */
+	int      preproc_nth;
+	int      ftle_nth;
+	double  *coords;        /* caller-owned, unless renumbered */
+	int     *faces;         /* caller-owned, unless renumbered */
+	int      own_coords;
+	int      own_faces;
+	int     *perm;          /* renumbering: perm[new] = old, iperm[old] = new */
+	int     *iperm;
+	int      use_grid;
+	grid_t   grid;
+	int     *nFacesPerPoint;
+	int     *facesPerPoint;
+	int      own_csr;       /* CSR lists built (and freed) by the library */
+	int     *stencil;
+	double  *invDenom;
+	int      own_stencil;
+	double   seconds[NPHASES];
+};
+
+int uvaftle_kernel_id ( const char *name )
+{
+	for ( int k = 0; k < UVAFTLE_NKERNELS; k++ )
+		if ( strcmp( name, kernel_names[k] ) == 0 ) return k;
+	return -1;
+}
+
+const char *uvaftle_kernel_name ( int kernel )
+{
+	return ( kernel >= 0 && kernel < UVAFTLE_NKERNELS ) ? kernel_names[kernel] : "unknown";
+}
+
+int uvaftle_precision_id ( const char *name )
+{
+	for ( int p = 0; p < UVAFTLE_NPRECISIONS; p++ )
+		if ( strcmp( name, precision_names[p] ) == 0 ) return p;
+	return -1;
+}
+
+const char *uvaftle_precision_name ( int precision )
+{
+	return ( precision >= 0 && precision < UVAFTLE_NPRECISIONS ) ? precision_names[precision] : "unknown";
+}
+
+int uvaftle_reorder_id ( const char *name )
+{
+	for ( int r = 0; r < UVAFTLE_NREORDERS; r++ )
+		if ( strcmp( name, reorder_names[r] ) == 0 ) return r;
+	return -1;
+}
+
+const char *uvaftle_reorder_name ( int order )
+{
+	return ( order >= 0 && order < UVAFTLE_NREORDERS ) ? reorder_names[order] : "unknown";
+}
+
+uvaftle_mesh_t *uvaftle_mesh_create ( int nDim, int nPoints, double *coords, int kernel, int *grid_dims, int nth )
+{
+	uvaftle_mesh_t *mesh;
+
+	if ( ( nDim != 2 && nDim != 3 ) || ( nPoints < 1 ) || ( coords == NULL ) || ( kernel < 0 ) || ( kernel >= UVAFTLE_NKERNELS ) || ( nth < 1 ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_create: wrong mesh (2D or 3D, at least one point), kernel or thread count\n" );
+		return NULL;
+	}
+
+	mesh = (uvaftle_mesh_t *) calloc( 1, sizeof(uvaftle_mesh_t) );
+	mesh->nDim          = nDim;
+	mesh->nVertsPerFace = nDim + 1;   /* triangles or tetrahedra */
+	mesh->nPoints       = nPoints;
+	mesh->coords        = coords;
+	mesh->kernel        = kernel;
+	mesh->preproc_nth   = nth;
+	mesh->ftle_nth      = nth;
+
+	/* Structured lattices need neither faces nor adjacency */
+	if ( kernel == UVAFTLE_KERNEL_AUTO || kernel == UVAFTLE_KERNEL_GRID )
+	{
+		double t = omp_get_wtime();
+		mesh->use_grid = detect_structured_grid( nDim, nPoints, coords, grid_dims, &mesh->grid, nth );
+		mesh->seconds[PHASE_DETECT_GRID] = omp_get_wtime() - t;
+		if ( !mesh->use_grid && kernel == UVAFTLE_KERNEL_GRID )
+		{
+			fprintf( stderr, "Error: mesh points do not form a rectilinear lattice" );
+			if ( grid_dims != NULL )
+			{
+				fprintf( stderr, " of %d", grid_dims[0] );
+				for ( int d = 1; d < nDim; d++ ) fprintf( stderr, "x%d", grid_dims[d] );
+			}
+			fprintf( stderr, "\n" );
+			free(mesh);
+			return NULL;
+		}
+		mesh->kernel = mesh->use_grid ? UVAFTLE_KERNEL_GRID : UVAFTLE_KERNEL_STENCIL;
+	}
+	return mesh;
+}
+
+void uvaftle_mesh_free ( uvaftle_mesh_t *mesh )
+{
+	if ( mesh == NULL ) return;
+	if ( mesh->own_csr )
+	{
+		free( mesh->nFacesPerPoint );
+		free( mesh->facesPerPoint );
+	}
+	if ( mesh->own_stencil )
+	{
+		free( mesh->stencil );
+		free( mesh->invDenom );
+	}
+	if ( mesh->own_coords ) free( mesh->coords );
+	if ( mesh->own_faces )  free( mesh->faces );
+	free( mesh->perm );
+	free( mesh->iperm );
+	if ( mesh->use_grid ) free_structured_grid( &mesh->grid );
+	free(mesh);
+}
+
+int uvaftle_mesh_set_threads ( uvaftle_mesh_t *mesh, int preproc_nth, int ftle_nth )
+{
+	if ( ( preproc_nth < 1 ) || ( ftle_nth < 1 ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_set_threads: positive thread counts expected\n" );
+		return -1;
+	}
+	mesh->preproc_nth = preproc_nth;
+	mesh->ftle_nth    = ftle_nth;
+	return 0;
+}
+
+/* Points renumbered by the caller before the adjacency is built */
+int uvaftle_mesh_set_coords ( uvaftle_mesh_t *mesh, double *coords )
+{
+	if ( ( coords == NULL ) || mesh->use_grid || ( mesh->stencil != NULL ) || ( mesh->perm != NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_set_coords: the points of a lattice, of a built stencil table or of a renumbered mesh cannot be replaced\n" );
+		return -1;
+	}
+	mesh->coords = coords;
+	return 0;
+}
+
+/* Faces in the current point order: after uvaftle_mesh_reorder, faces already renumbered (e.g. by the connectivity cache) */
+int uvaftle_mesh_set_faces ( uvaftle_mesh_t *mesh, int nFaces, int *faces )
+{
+	if ( ( nFaces < 1 ) || ( faces == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_set_faces: at least one face expected\n" );
+		return -1;
+	}
+	long nIndices = (long) nFaces * mesh->nVertsPerFace, nWrong = 0;
+	#pragma omp parallel for reduction(+:nWrong) num_threads(mesh->preproc_nth)
+	for ( long i = 0; i < nIndices; i++ )
+		nWrong += ( faces[i] < 0 ) || ( faces[i] >= mesh->nPoints );
+	if ( nWrong > 0 )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_set_faces: %ld vertex indices outside [0, %d)\n", nWrong, mesh->nPoints );
+		return -1;
+	}
+	if ( mesh->own_faces ) free( mesh->faces );
+	mesh->own_faces = 0;
+	mesh->nFaces = nFaces;
+	mesh->faces  = faces;
+	return 0;
+}
+
+/* Connectivity built elsewhere (e.g. the connectivity cache): used in place, the missing parts are built by uvaftle_build_adjacency */
+int uvaftle_mesh_set_adjacency ( uvaftle_mesh_t *mesh, int *nFacesPerPoint, int *facesPerPoint, int *stencil, double *invDenom )
+{
+	if ( ( nFacesPerPoint == NULL ) != ( facesPerPoint == NULL ) || ( stencil == NULL ) != ( invDenom == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_set_adjacency: CSR lists and stencil table must be given in pairs\n" );
+		return -1;
+	}
+	if ( nFacesPerPoint != NULL )
+	{
+		mesh->nFacesPerPoint = nFacesPerPoint;
+		mesh->facesPerPoint  = facesPerPoint;
+		mesh->own_csr        = 0;
+	}
+	if ( stencil != NULL )
+	{
+		mesh->stencil     = stencil;
+		mesh->invDenom    = invDenom;
+		mesh->own_stencil = 0;
+	}
+	return 0;
+}
+
+int uvaftle_mesh_kernel ( uvaftle_mesh_t *mesh )
+{
+	return mesh->kernel;
+}
+
+int uvaftle_mesh_npoints ( uvaftle_mesh_t *mesh )
+{
+	return mesh->nPoints;
+}
+
+struct Grid *uvaftle_mesh_grid ( uvaftle_mesh_t *mesh )
+{
+	return mesh->use_grid ? &mesh->grid : NULL;
+}
+
+double *uvaftle_mesh_coords ( uvaftle_mesh_t *mesh )
+{
+	return mesh->coords;
+}
+
+int *uvaftle_mesh_faces ( uvaftle_mesh_t *mesh, int *nFaces )
+{
+	if ( nFaces ) *nFaces = mesh->faces ? mesh->nFaces : 0;
+	return mesh->faces;
+}
+
+/* Renumber the points along a space-filling curve, so that the kernels see neighbouring points close in memory. The
+   coordinates, and the faces if already set, are copied in the new order into arrays owned by the mesh: the caller's
+   ones are no longer used. Flowmaps must then be given in that order (uvaftle_mesh_permute) and results come out in it */
+int uvaftle_mesh_reorder ( uvaftle_mesh_t *mesh, int order )
+{
+	int     nDim = mesh->nDim, nPoints = mesh->nPoints, nth = mesh->preproc_nth;
+	int    *perm, *iperm;
+	double *coords, t;
+
+	if ( ( order < 0 ) || ( order >= UVAFTLE_NREORDERS ) || ( mesh->perm != NULL ) || ( mesh->nFacesPerPoint != NULL ) || ( mesh->stencil != NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_reorder: wrong order, or the mesh is already renumbered or its adjacency built\n" );
+		return -1;
+	}
+	/* Lattice points are addressed by their indices */
+	if ( ( order == UVAFTLE_REORDER_NONE ) || mesh->use_grid ) return 0;
+
+	t = omp_get_wtime();
+	mesh->perm  = perm  = (int *) malloc( sizeof(int) * nPoints );
+	mesh->iperm = iperm = (int *) malloc( sizeof(int) * nPoints );
+	morton_order( nDim, nPoints, mesh->coords, perm, nth );
+	invert_permutation( nPoints, perm, iperm, nth );
+
+	coords = (double *) malloc( sizeof(double) * nPoints * nDim );
+	permute_points( nPoints, nDim, perm, mesh->coords, coords, nth );
+	if ( mesh->own_coords ) free( mesh->coords );
+	mesh->coords     = coords;
+	mesh->own_coords = 1;
+
+	if ( mesh->faces != NULL )
+	{
+		int *faces = (int *) malloc( sizeof(int) * (long) mesh->nFaces * mesh->nVertsPerFace );
+		renumber_faces( nPoints, mesh->nFaces, mesh->nVertsPerFace, iperm, mesh->faces, faces, nth );
+		if ( mesh->own_faces ) free( mesh->faces );
+		mesh->faces     = faces;
+		mesh->own_faces = 1;
+	}
+	mesh->seconds[PHASE_REORDER] = omp_get_wtime() - t;
+	return 0;
+}
+
+/* NULL, NULL if the points keep the caller's order */
+void uvaftle_mesh_permutation ( uvaftle_mesh_t *mesh, int **perm, int **iperm )
+{
+	if ( perm )  *perm  = mesh->perm;
+	if ( iperm ) *iperm = mesh->iperm;
+}
+
+/* Point array of width values per point (nDim for a flowmap, nDim x nMembers for interleaved members) into the mesh order */
+int uvaftle_mesh_permute ( uvaftle_mesh_t *mesh, int width, double *src, double *dst )
+{
+	if ( ( width < 1 ) || ( src == NULL ) || ( dst == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_mesh_permute: width, source and destination arrays expected\n" );
+		return -1;
+	}
+	if ( mesh->perm != NULL )
+		permute_points( mesh->nPoints, width, mesh->perm, src, dst, mesh->preproc_nth );
+	else if ( src != dst )
+		memcpy( dst, src, sizeof(double) * mesh->nPoints * width );
+	return 0;
+}
+
+int uvaftle_build_adjacency ( uvaftle_mesh_t *mesh, int flags )
+{
+	int nDim = mesh->nDim, nPoints = mesh->nPoints, nFaces = mesh->nFaces, nVertsPerFace = mesh->nVertsPerFace;
+	int nth = mesh->preproc_nth;
+	int stencil = ( flags & UVAFTLE_BUILD_STENCIL ) || ( mesh->kernel == UVAFTLE_KERNEL_STENCIL ) || ( mesh->kernel == UVAFTLE_KERNEL_SIMD );
+	double t;
+
+	/* On a lattice the neighbours follow from the indices: only the ensemble kernel wants them in a table */
+	if ( mesh->use_grid )
+	{
+		if ( stencil && ( mesh->stencil == NULL ) )
+		{
+			t = omp_get_wtime();
+			mesh->stencil     = (int *)    malloc( sizeof(int)    * nPoints * 2 * nDim );
+			mesh->invDenom    = (double *) malloc( sizeof(double) * nPoints * nDim );
+			mesh->own_stencil = 1;
+			create_grid_stencil_table ( &mesh->grid, nPoints, mesh->stencil, mesh->invDenom, nth );
+			mesh->seconds[PHASE_STENCIL_TABLE] = omp_get_wtime() - t;
+		}
+		return 0;
+	}
+
+	if ( ( mesh->nFacesPerPoint == NULL || ( stencil && mesh->stencil == NULL ) ) && ( mesh->faces == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_build_adjacency: the mesh faces are not set\n" );
+		return -1;
+	}
+
+	/* Assign faces to vertices: nFacesPerPoint accumulates the previous counts */
+	if ( mesh->nFacesPerPoint == NULL )
+	{
+		int *faces = mesh->faces, *nFacesPerPoint, *facesPerPoint;
+		mesh->own_csr = 1;
+		mesh->nFacesPerPoint = nFacesPerPoint = (int *) malloc( sizeof(int) * nPoints );
+		t = omp_get_wtime();
+		if ( flags & UVAFTLE_BUILD_QUADRATIC )
+			create_nFacesPerPoint_vector ( nDim, nPoints, nFaces, nVertsPerFace, faces, nFacesPerPoint );
+		else
+			create_nFacesPerPoint_vector_parallel ( nDim, nPoints, nFaces, nVertsPerFace, faces, nFacesPerPoint, nth );
+		mesh->seconds[PHASE_COUNT_SCAN] = omp_get_wtime() - t;
+
+		t = omp_get_wtime();
+		mesh->facesPerPoint = facesPerPoint = (int *) malloc( sizeof(int) * nFacesPerPoint[ nPoints - 1 ] );
+		if ( flags & UVAFTLE_BUILD_QUADRATIC )
+		{
+			#pragma omp parallel for default(none) shared(nDim, nFaces, nPoints, nVertsPerFace, faces, nFacesPerPoint, facesPerPoint) num_threads(nth) schedule(runtime)
+			for ( int ip = 0; ip < nPoints; ip++ )
+				create_facesPerPoint_vector( nDim, ip, nFaces, nVertsPerFace, faces, nFacesPerPoint, facesPerPoint );
+		}
+		else
+			create_facesPerPoint_vector_linear ( nDim, nPoints, nFaces, nVertsPerFace, faces, nFacesPerPoint, facesPerPoint, nth );
+		mesh->seconds[PHASE_CSR_BUILD] = omp_get_wtime() - t;
+	}
+
+	/* Resolve the axis neighbours once; the mesh connectivity is no longer needed afterwards */
+	if ( stencil && ( mesh->stencil == NULL ) )
+	{
+		t = omp_get_wtime();
+		mesh->stencil     = (int *)    malloc( sizeof(int)    * nPoints * 2 * nDim );
+		mesh->invDenom    = (double *) malloc( sizeof(double) * nPoints * nDim );
+		mesh->own_stencil = 1;
+		create_stencil_table ( nDim, nPoints, nVertsPerFace, mesh->coords, mesh->faces, mesh->nFacesPerPoint, mesh->facesPerPoint,
+		                       mesh->stencil, mesh->invDenom, nth );
+		mesh->seconds[PHASE_STENCIL_TABLE] = omp_get_wtime() - t;
+	}
+	if ( !( flags & UVAFTLE_BUILD_KEEP_FACES ) )
+		uvaftle_mesh_drop_faces( mesh );
+	return 0;
+}
+
+void uvaftle_mesh_adjacency ( uvaftle_mesh_t *mesh, int **nFacesPerPoint, int **facesPerPoint, int **stencil, double **invDenom )
+{
+	if ( nFacesPerPoint ) *nFacesPerPoint = mesh->nFacesPerPoint;
+	if ( facesPerPoint )  *facesPerPoint  = mesh->facesPerPoint;
+	if ( stencil )        *stencil        = mesh->stencil;
+	if ( invDenom )       *invDenom       = mesh->invDenom;
+}
+
+/* Once the stencil table exists the faces (still owned by the caller) and the CSR lists are released */
+void uvaftle_mesh_drop_faces ( uvaftle_mesh_t *mesh )
+{
+	if ( mesh->stencil == NULL ) return;
+	if ( mesh->own_csr )
+	{
+		free( mesh->nFacesPerPoint );
+		free( mesh->facesPerPoint );
+	}
+	if ( mesh->own_faces ) free( mesh->faces );
+	mesh->own_csr        = 0;
+	mesh->own_faces      = 0;
+	mesh->nFacesPerPoint = NULL;
+	mesh->facesPerPoint  = NULL;
+	mesh->faces          = NULL;
+}
+
+/* Wall time of the last run of a preprocessing phase: detect_grid, reorder, count_scan, csr_build or stencil_table */
+double uvaftle_phase_seconds ( uvaftle_mesh_t *mesh, const char *phase )
+{
+	for ( int p = 0; p < NPHASES; p++ )
+		if ( strcmp( phase, phase_names[p] ) == 0 ) return mesh->seconds[p];
+	return 0;
+}
+
+/* Point loops of the stencil, simd, facewalk and facecode kernels, for one dimension and face size */
+template <int NDIM, int NVERTS, typename real_t, typename acc_t>
+static void compute_points ( uvaftle_mesh_t *mesh, real_t *flowmap, double t_eval, real_t *ftle )
+{
+	int     nPoints = mesh->nPoints, nth = mesh->ftle_nth;
+	double *coords = mesh->coords, *invDenom = mesh->invDenom;
+	int    *faces = mesh->faces, *nFacesPerPoint = mesh->nFacesPerPoint, *facesPerPoint = mesh->facesPerPoint, *stencil = mesh->stencil;
+
+	if ( mesh->kernel == UVAFTLE_KERNEL_SIMD )
+	{
+		int nBatches = ( nPoints + SIMD_BATCH - 1 ) / SIMD_BATCH;
+		#pragma omp parallel for default(none) shared(nPoints, nBatches, stencil, invDenom, flowmap, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ib = 0; ib < nBatches; ib++ )
+		{
+			int n = ( nPoints - ib * SIMD_BATCH < SIMD_BATCH ) ? nPoints - ib * SIMD_BATCH : SIMD_BATCH;
+			compute_ftle_stencil_batch<NDIM, real_t, acc_t> ( ib * SIMD_BATCH, n, stencil, invDenom, flowmap, ftle, t_eval );
+		}
+	}
+	else if ( stencil != NULL )
+	{
+		#pragma omp parallel for default(none) shared(nPoints, stencil, invDenom, flowmap, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			compute_ftle_stencil<NDIM, real_t, acc_t> ( ip, stencil, invDenom, flowmap, ftle, t_eval );
+	}
+	else if ( mesh->kernel == UVAFTLE_KERNEL_FACECODE )
+	{
+		#pragma omp parallel for default(none) shared(nPoints, coords, flowmap, faces, nFacesPerPoint, facesPerPoint, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			compute_gradient_coded<NDIM, NVERTS, real_t, acc_t> ( ip, coords, flowmap, faces, nFacesPerPoint, facesPerPoint, ftle, t_eval );
+	}
+	else
+	{
+		#pragma omp parallel for default(none) shared(nPoints, coords, flowmap, faces, nFacesPerPoint, facesPerPoint, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			/* Compute gradient, tensors and ATxA based on neighbors flowmap values, then get the max eigenvalue */
+			compute_gradient<NDIM, NVERTS, real_t, acc_t> ( ip, coords, flowmap, faces, nFacesPerPoint, facesPerPoint, ftle, t_eval );
+	}
+}
+
+/* Kernel dispatch of uvaftle_compute and uvaftle_compute_float, with flowmap and results stored as real_t and the arithmetic in acc_t */
+template <typename real_t, typename acc_t>
+static int compute ( uvaftle_mesh_t *mesh, real_t *flowmap, double t_eval, real_t *ftle, const char *caller )
+{
+	int     nth = mesh->ftle_nth;
+	grid_t *grid = &mesh->grid;
+
+	if ( ( flowmap == NULL ) || ( ftle == NULL ) )
+	{
+		fprintf( stderr, "Error: %s: flowmap and result arrays expected\n", caller );
+		return -1;
+	}
+	if ( !mesh->use_grid && ( mesh->stencil == NULL ) && ( ( mesh->nFacesPerPoint == NULL ) || ( ( mesh->kernel != UVAFTLE_KERNEL_FACEWALK ) && ( mesh->kernel != UVAFTLE_KERNEL_FACECODE ) ) ) )
+	{
+		fprintf( stderr, "Error: %s: the adjacency of the %s kernel is not built\n", caller, uvaftle_kernel_name( mesh->kernel ) );
+		return -1;
+	}
+
+	if ( mesh->use_grid )
+	{
+		int nBlocks = grid_nblocks( grid );
+		#pragma omp parallel for default(none) shared(nBlocks, grid, flowmap, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ib = 0; ib < nBlocks; ib++ )
+			compute_ftle_grid_block<real_t, acc_t> ( ib, grid, flowmap, ftle, t_eval );
+	}
+	else if ( mesh->nDim == 2 )
+		compute_points<2, 3, real_t, acc_t> ( mesh, flowmap, t_eval, ftle );
+	else
+		compute_points<3, 4, real_t, acc_t> ( mesh, flowmap, t_eval, ftle );
+	return 0;
+}
+
+int uvaftle_compute ( uvaftle_mesh_t *mesh, double *flowmap, double t_eval, double *ftle )
+{
+	return compute<double, double> ( mesh, flowmap, t_eval, ftle, "uvaftle_compute" );
+}
+
+int uvaftle_compute_float ( uvaftle_mesh_t *mesh, float *flowmap, double t_eval, float *ftle, int precision )
+{
+	if ( precision == UVAFTLE_PRECISION_SINGLE )
+		return compute<float, float> ( mesh, flowmap, t_eval, ftle, "uvaftle_compute_float" );
+	if ( precision == UVAFTLE_PRECISION_MIXED )
+		return compute<float, double> ( mesh, flowmap, t_eval, ftle, "uvaftle_compute_float" );
+	fprintf( stderr, "Error: uvaftle_compute_float: single or mixed precision expected\n" );
+	return -1;
+}
+
+/* Float copy of a flowmap for uvaftle_compute_float: flowmap is in the point order of the caller, as given to
+   uvaftle_mesh_permute, and flowmap32 comes out in the mesh order, so a renumbered mesh needs no double copy */
+int uvaftle_narrow_flowmap ( uvaftle_mesh_t *mesh, double *flowmap, float *flowmap32 )
+{
+	int  nPoints = mesh->nPoints, nDim = mesh->nDim, nth = mesh->ftle_nth;
+	int *perm = mesh->perm;
+
+	if ( ( flowmap == NULL ) || ( flowmap32 == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_narrow_flowmap: flowmap arrays expected\n" );
+		return -1;
+	}
+	#pragma omp parallel for default(none) shared(nPoints, nDim, perm, flowmap, flowmap32) num_threads(nth) schedule(static)
+	for ( int i = 0; i < nPoints; i++ )
+	{
+		long row = ( perm != NULL ) ? perm[i] : i;
+		for ( int c = 0; c < nDim; c++ )
+			flowmap32[(long) i * nDim + c] = (float) flowmap[row * nDim + c];
+	}
+	return 0;
+}
+
+/* Add the deviation of the float results from the double reference ones (uvaftle_compute on the same flowmap) to the
+   running max and sum; neither array is modified. Equal values (also infinities of degenerate gradients, or NaNs on
+   both sides) do not deviate; a NaN on one side deviates infinitely */
+int uvaftle_precision_deviation ( uvaftle_mesh_t *mesh, const float *ftle, const double *reference, double *dev_max, double *dev_sum )
+{
+	int    n = mesh->nPoints, nth = mesh->ftle_nth;
+	double max, sum = 0;
+
+	if ( ( ftle == NULL ) || ( reference == NULL ) || ( dev_max == NULL ) || ( dev_sum == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_precision_deviation: result, reference and deviation arrays expected\n" );
+		return -1;
+	}
+	max = *dev_max;
+
+	#pragma omp parallel for default(none) shared(n, ftle, reference) reduction(max:max) reduction(+:sum) num_threads(nth) schedule(static)
+	for ( int i = 0; i < n; i++ )
+	{
+		double r = ftle[i], d;
+		if ( ( r == reference[i] ) || ( ( r != r ) && ( reference[i] != reference[i] ) ) )
+			d = 0;
+		else
+			d = fabs( r - reference[i] );
+		if ( d != d )
+			d = INFINITY;
+		max = ( d > max ) ? d : max;
+		sum += d;
+	}
+
+	*dev_max  = max;
+	*dev_sum += sum;
+	return 0;
+}
+
+/* nMembers flowmaps interleaved point by point (see interleave_flowmaps), one t_eval each; ftle holds nMembers values per point */
+int uvaftle_compute_ensemble ( uvaftle_mesh_t *mesh, int nMembers, double *flowmapK, double *t_eval, double *ftle )
+{
+	int     nDim = mesh->nDim, nPoints = mesh->nPoints, nth = mesh->ftle_nth;
+	int    *stencil = mesh->stencil;
+	double *invDenom = mesh->invDenom;
+
+	if ( ( nMembers < 1 ) || ( flowmapK == NULL ) || ( t_eval == NULL ) || ( ftle == NULL ) )
+	{
+		fprintf( stderr, "Error: uvaftle_compute_ensemble: members, flowmaps, times and result arrays expected\n" );
+		return -1;
+	}
+	if ( stencil == NULL )
+	{
+		fprintf( stderr, "Error: uvaftle_compute_ensemble: the stencil table is not built (UVAFTLE_BUILD_STENCIL)\n" );
+		return -1;
+	}
+
+	if ( nDim == 2 )
+	{
+		#pragma omp parallel for default(none) shared(nPoints, nMembers, stencil, invDenom, flowmapK, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			compute_ftle_ensemble_2D ( ip, nMembers, stencil, invDenom, flowmapK, ftle, t_eval );
+	}
+	else
+	{
+		#pragma omp parallel for default(none) shared(nPoints, nMembers, stencil, invDenom, flowmapK, ftle, t_eval) num_threads(nth) schedule(runtime)
+		for ( int ip = 0; ip < nPoints; ip++ )
+			compute_ftle_ensemble_3D ( ip, nMembers, stencil, invDenom, flowmapK, ftle, t_eval );
+	}
+	return 0;
+}
@@ -0,0 +1,362 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "omp.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "vtkfile.h"
+
+#define VTU_STAGE_BYTES  ( 8 << 20 )   /* gathered in parallel and written with one fwrite */
+#define VTU_BLOCK_ELEMS  ( 1 << 15 )   /* elements per compressed block */
+#define VTU_NARRAYS_MAX  64
+
+/* VTK cell types */
+enum { VTK_TRIANGLE = 5, VTK_PIXEL = 8, VTK_TETRA = 10, VTK_VOXEL = 11 };
+
+typedef struct VtuData {
+	int      nDim;
+	int      nVertsPerCell;
+	int      cellType;
+	int      cellDims[3];    /* lattice cells along each axis */
+	long     nCells;
+	int      nArrays;
+	int      array;          /* FTLE array being written */
+	double  *coords;
+	void    *values;         /* real_t of write_vtu_file */
+	int     *faces;
+	int     *perm;
+	int     *iperm;
+	grid_t  *grid;
+} vtu_data_t;
+
+/* Writes count elements of an array, starting at element first, into dst */
+typedef void (*vtu_fill_t) ( vtu_data_t *d, long first, long count, char *dst );
+
+typedef struct VtuWriter {
+	FILE      *file;
+	int        level;
+	int        nth;
+	long long  appended;     /* bytes after the '_' of the appended data */
+	char      *stage;
+} vtu_writer_t;
+
+/* Row of point i (original order) in the arrays of the run */
+static inline long point_row ( vtu_data_t *d, long i )
+{
+	return d->iperm ? d->iperm[i] : i;
+}
+
+/* FTLE arrays are Float64 whatever real_t holds them */
+template <typename real_t>
+static void fill_values ( vtu_data_t *d, long first, long count, char *dst )
+{
+	double *out    = (double *) dst;
+	real_t *values = (real_t *) d->values;
+	for ( long i = 0; i < count; i++ )
+		out[i] = values[point_row( d, first + i ) * d->nArrays + d->array];
+}
+
+/* VTK points always have 3 components */
+static void fill_points ( vtu_data_t *d, long first, long count, char *dst )
+{
+	double *out = (double *) dst;
+	for ( long i = 0; i < count; i++ )
+	{
+		long row = point_row( d, first + i );
+		for ( int c = 0; c < 3; c++ )
+			out[i * 3 + c] = ( c < d->nDim ) ? d->coords[row * d->nDim + c] : 0.0;
+	}
+}
+
+/* Pixel and voxel corners go x fastest, then y, then z */
+static void fill_connectivity ( vtu_data_t *d, long first, long count, char *dst )
+{
+	int *out = (int *) dst;
+	int  nv  = d->nVertsPerCell;
+	for ( long i = 0; i < count; i++ )
+	{
+		long c = first + i;
+		if ( d->grid != NULL )
+		{
+			int *strides = d->grid->strides;
+			long cx = c % d->cellDims[0];
+			long cy = ( c / d->cellDims[0] ) % d->cellDims[1];
+			long cz = c / ( (long) d->cellDims[0] * d->cellDims[1] );
+			long base = cx * strides[0] + cy * strides[1] + ( ( d->nDim == 3 ) ? cz * strides[2] : 0 );
+			for ( int v = 0; v < nv; v++ )
+				out[i * nv + v] = (int) ( base + ( v & 1 ) * strides[0] + ( ( v >> 1 ) & 1 ) * strides[1] + ( ( v >> 2 ) & 1 ) * ( ( d->nDim == 3 ) ? strides[2] : 0 ) );
+		}
+		else
+		{
+			for ( int v = 0; v < nv; v++ )
+				out[i * nv + v] = d->faces[c * nv + v];
+		}
+		if ( d->perm != NULL )
+			for ( int v = 0; v < nv; v++ )
+				out[i * nv + v] = d->perm[out[i * nv + v]];
+	}
+}
+
+static void fill_offsets ( vtu_data_t *d, long first, long count, char *dst )
+{
+	int64_t *out = (int64_t *) dst;
+	for ( long i = 0; i < count; i++ )
+		out[i] = ( first + i + 1 ) * d->nVertsPerCell;
+}
+
+static void fill_types ( vtu_data_t *d, long first, long count, char *dst )
+{
+	(void) first;
+	memset( dst, d->cellType, count );
+}
+
+/* Raw arrays: a UInt64 byte count, then the data gathered by all threads one stage at a time */
+static void write_raw_array ( vtu_writer_t *w, vtu_data_t *d, vtu_fill_t fill, long count, size_t elem )
+{
+	uint64_t nbytes = (uint64_t) count * elem;
+	long stage = VTU_STAGE_BYTES / elem;
+	char *buffer = w->stage;
+	int nth = w->nth;
+
+	fwrite( &nbytes, sizeof(nbytes), 1, w->file );
+	for ( long first = 0; first < count; first += stage )
+	{
+		long n = ( count - first < stage ) ? count - first : stage;
+		#pragma omp parallel for default(none) shared(d, fill, first, n, elem, buffer, nth) num_threads(nth) schedule(static, 1)
+		for ( int t = 0; t < nth; t++ )
+		{
+			long b = n * t / nth, e = n * ( t + 1 ) / nth;
+			fill( d, first + b, e - b, buffer + b * elem );
+		}
+		fwrite( buffer, elem, n, w->file );
+	}
+	w->appended += sizeof(nbytes) + nbytes;
+}
+
+#ifdef HAVE_ZLIB
+/* 
+ * vtkZLibDataCompressor arrays: nblocks, block size, last block size and the
+ * compressed size of every block, then the blocks. Blocks are compressed in
+ * parallel, nth at a time, and the header is completed once they are written.
+ */
+static void write_compressed_array ( vtu_writer_t *w, vtu_data_t *d, vtu_fill_t fill, long count, size_t elem )
+{
+	long nblocks = ( count + VTU_BLOCK_ELEMS - 1 ) / VTU_BLOCK_ELEMS;
+	size_t block = (size_t) VTU_BLOCK_ELEMS * elem;
+	uLong bound = compressBound( block );
+	uint64_t *header = (uint64_t *) calloc( 3 + nblocks, sizeof(uint64_t) );
+	char *raw = (char *) malloc( block * w->nth );
+	char *packed = (char *) malloc( bound * w->nth );
+	uLongf *packed_size = (uLongf *) malloc( sizeof(uLongf) * w->nth );
+	long header_pos = ftell( w->file );
+	int nth = w->nth, level = w->level, failed = 0;
+
+	header[0] = nblocks;
+	header[1] = block;
+	header[2] = ( nblocks > 0 ) ? ( count - ( nblocks - 1 ) * VTU_BLOCK_ELEMS ) * elem : 0;
+	fwrite( header, sizeof(uint64_t), 3 + nblocks, w->file );
+	w->appended += sizeof(uint64_t) * ( 3 + nblocks );
+
+	for ( long b0 = 0; b0 < nblocks; b0 += nth )
+	{
+		int nb = ( nblocks - b0 < nth ) ? (int) ( nblocks - b0 ) : nth;
+		#pragma omp parallel for default(none) shared(d, fill, b0, nb, count, elem, block, bound, raw, packed, packed_size, level) reduction(+:failed) num_threads(nth) schedule(static, 1)
+		for ( int t = 0; t < nb; t++ )
+		{
+			long first = ( b0 + t ) * VTU_BLOCK_ELEMS;
+			long n = ( count - first < VTU_BLOCK_ELEMS ) ? count - first : VTU_BLOCK_ELEMS;
+			fill( d, first, n, raw + t * block );
+			packed_size[t] = bound;
+			failed += ( compress2( (Bytef *) packed + t * bound, &packed_size[t], (Bytef *) raw + t * block, n * elem, level ) != Z_OK );
+		}
+		for ( int t = 0; t < nb; t++ )
+		{
+			fwrite( packed + t * bound, 1, packed_size[t], w->file );
+			header[3 + b0 + t] = packed_size[t];
+			w->appended += packed_size[t];
+		}
+	}
+	if ( failed )
+	{
+		fprintf( stderr, "Error: zlib compression failed\n" );
+		exit(-1);
+	}
+
+	fseek( w->file, header_pos, SEEK_SET );
+	fwrite( header, sizeof(uint64_t), 3 + nblocks, w->file );
+	fseek( w->file, 0, SEEK_END );
+	free(header);
+	free(raw);
+	free(packed);
+	free(packed_size);
+}
+#endif
+
+static void write_array ( vtu_writer_t *w, vtu_data_t *d, vtu_fill_t fill, long count, size_t elem )
+{
+#ifdef HAVE_ZLIB
+	if ( w->level > 0 )
+	{
+		write_compressed_array( w, d, fill, count, elem );
+		return;
+	}
+#endif
+	write_raw_array( w, d, fill, count, elem );
+}
+
+/* DataArray element with a fixed-width offset, filled in once the data is written */
+static long data_array ( FILE *file, const char *type, const char *name, int ncomp )
+{
+	long pos;
+	fprintf( file, "        <DataArray type=\"%s\" Name=\"%s\"", type, name );
+	if ( ncomp > 1 ) fprintf( file, " NumberOfComponents=\"%d\"", ncomp );
+	fprintf( file, " format=\"appended\" offset=\"" );
+	pos = ftell( file );
+	fprintf( file, "%020lld\"/>\n", 0LL );
+	return pos;
+}
+
+template <typename real_t>
+long long write_vtu_file ( char *filename, int nDim, int nPoints, double *coords, int nFaces, int nVertsPerFace, int *faces, grid_t *grid,
+                           int nArrays, real_t *values, int *perm, int *iperm, int level, int nth )
+{
+	const uint16_t endian = 1;
+	vtu_data_t d;
+	vtu_writer_t w;
+	long field[VTU_NARRAYS_MAX + 5];
+	long long offset[VTU_NARRAYS_MAX + 5];
+	char name[32];
+	int nfields = 0;
+	long long written;
+
+	if ( nArrays > VTU_NARRAYS_MAX )
+	{
+		fprintf( stderr, "Error: at most %d FTLE arrays can be written to %s\n", VTU_NARRAYS_MAX, filename );
+		exit(-1);
+	}
+#ifndef HAVE_ZLIB
+	if ( level > 0 )
+	{
+		fprintf( stderr, "Warning: built without zlib, %s is written uncompressed\n", filename );
+		level = 0;
+	}
+#endif
+
+	memset( &d, 0, sizeof(d) );
+	d.nDim    = nDim;
+	d.nArrays = nArrays;
+	d.coords  = coords;
+	d.values  = values;
+	d.faces   = faces;
+	d.perm    = perm;
+	d.iperm   = iperm;
+	d.grid    = grid;
+	if ( grid != NULL )
+	{
+		d.nVertsPerCell = ( nDim == 2 ) ? 4 : 8;
+		d.cellType      = ( nDim == 2 ) ? VTK_PIXEL : VTK_VOXEL;
+		d.nCells        = 1;
+		for ( int a = 0; a < 3; a++ )
+		{
+			d.cellDims[a] = ( a < nDim ) ? grid->dims[a] - 1 : 1;
+			d.nCells     *= d.cellDims[a];
+		}
+	}
+	else
+	{
+		d.nVertsPerCell = nVertsPerFace;
+		d.cellType      = ( nDim == 2 ) ? VTK_TRIANGLE : VTK_TETRA;
+		d.nCells        = nFaces;
+	}
+
+	w.file = fopen( filename, "wb" );
+	if ( w.file == NULL )
+	{
+		fprintf( stderr, "Error: cannot create %s\n", filename );
+		exit(-1);
+	}
+	w.level    = level;
+	w.nth      = nth;
+	w.appended = 0;
+	w.stage    = (char *) malloc( VTU_STAGE_BYTES );
+
+	fprintf( w.file, "<?xml version=\"1.0\"?>\n" );
+	fprintf( w.file, "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"%s>\n",
+	         *(const char *) &endian ? "LittleEndian" : "BigEndian", ( level > 0 ) ? " compressor=\"vtkZLibDataCompressor\"" : "" );
+	fprintf( w.file, "  <UnstructuredGrid>\n" );
+	fprintf( w.file, "    <Piece NumberOfPoints=\"%d\" NumberOfCells=\"%ld\">\n", nPoints, d.nCells );
+	fprintf( w.file, "      <PointData Scalars=\"%s\">\n", ( nArrays > 1 ) ? "FTLE_0" : "FTLE" );
+	for ( int k = 0; k < nArrays; k++ )
+	{
+		if ( nArrays > 1 ) sprintf( name, "FTLE_%d", k ); else sprintf( name, "FTLE" );
+		field[nfields++] = data_array( w.file, "Float64", name, 1 );
+	}
+	fprintf( w.file, "      </PointData>\n      <Points>\n" );
+	field[nfields++] = data_array( w.file, "Float64", "Points", 3 );
+	fprintf( w.file, "      </Points>\n      <Cells>\n" );
+	field[nfields++] = data_array( w.file, "Int32", "connectivity", 1 );
+	field[nfields++] = data_array( w.file, "Int64", "offsets", 1 );
+	field[nfields++] = data_array( w.file, "UInt8", "types", 1 );
+	fprintf( w.file, "      </Cells>\n    </Piece>\n  </UnstructuredGrid>\n" );
+	fprintf( w.file, "  <AppendedData encoding=\"raw\">\n   _" );
+
+	nfields = 0;
+	for ( d.array = 0; d.array < nArrays; d.array++ )
+	{
+		offset[nfields++] = w.appended;
+		write_array( &w, &d, fill_values<real_t>, nPoints, sizeof(double) );
+	}
+	offset[nfields++] = w.appended;
+	write_array( &w, &d, fill_points, nPoints, 3 * sizeof(double) );
+	offset[nfields++] = w.appended;
+	write_array( &w, &d, fill_connectivity, d.nCells, d.nVertsPerCell * sizeof(int) );
+	offset[nfields++] = w.appended;
+	write_array( &w, &d, fill_offsets, d.nCells, sizeof(int64_t) );
+	offset[nfields++] = w.appended;
+	write_array( &w, &d, fill_types, d.nCells, 1 );
+	fprintf( w.file, "\n  </AppendedData>\n</VTKFile>\n" );
+	written = ftell( w.file );
+
+	for ( int i = 0; i < nfields; i++ )
+	{
+		fseek( w.file, field[i], SEEK_SET );
+		fprintf( w.file, "%020lld", offset[i] );
+	}
+	if ( fclose( w.file ) != 0 )
+	{
+		fprintf( stderr, "Error: cannot write %s\n", filename );
+		exit(-1);
+	}
+	free( w.stage );
+	return written;
+}
+
+template long long write_vtu_file<double> ( char *filename, int nDim, int nPoints, double *coords, int nFaces, int nVertsPerFace, int *faces,
+                                            grid_t *grid, int nArrays, double *values, int *perm, int *iperm, int level, int nth );
+template long long write_vtu_file<float>  ( char *filename, int nDim, int nPoints, double *coords, int nFaces, int nVertsPerFace, int *faces,
+                                            grid_t *grid, int nArrays, float *values, int *perm, int *iperm, int level, int nth );
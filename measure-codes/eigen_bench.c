@@ -0,0 +1,232 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <omp.h>
+
+#include "arithmetic.h"
+#include "eigen.h"
+
+/* 
+ * Throughput and accuracy of the largest-eigenvalue solvers for symmetric
+ * 3x3 tensors: the characteristic cubic of max_solve_3rd_degree_eq, the
+ * trigonometric closed form, Jacobi rotations and the batched form in 4 and
+ * 8 lanes. The errors are relative to Jacobi rotations in long double.
+ * Tensors are C = F^T F for random gradients F, either stretched by up to
+ * 10^3 per axis (as a flowmap does) or with repeated eigenvalues.
+ *
+ * USAGE: eigen_bench <nth> [nTensors]   (default: 4M tensors)
+ */
+
+typedef struct Tensors {
+	long    n;
+	double *a[6];   /* a00, a01, a02, a11, a12, a22 */
+} tensors_t;
+
+static double uniform ( unsigned long long *state )
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (double) ( *state >> 11 ) / 9007199254740992.0;
+}
+
+/* Random rotation R (from a normalised quaternion) */
+static void random_rotation ( unsigned long long *state, double R[3][3] )
+{
+	double w = uniform(state) - 0.5, x = uniform(state) - 0.5, y = uniform(state) - 0.5, z = uniform(state) - 0.5;
+	double nrm = sqrt( w*w + x*x + y*y + z*z );
+	w /= nrm; x /= nrm; y /= nrm; z /= nrm;
+	R[0][0] = 1 - 2*(y*y + z*z); R[0][1] = 2*(x*y - w*z);     R[0][2] = 2*(x*z + w*y);
+	R[1][0] = 2*(x*y + w*z);     R[1][1] = 1 - 2*(x*x + z*z); R[1][2] = 2*(y*z - w*x);
+	R[2][0] = 2*(x*z - w*y);     R[2][1] = 2*(y*z + w*x);     R[2][2] = 1 - 2*(x*x + y*y);
+}
+
+static void create_tensors ( long n, int degenerate, tensors_t *t )
+{
+	t->n = n;
+	for ( int k = 0; k < 6; k++ )
+		t->a[k] = (double *) malloc( sizeof(double) * n );
+
+	#pragma omp parallel for schedule(static)
+	for ( long i = 0; i < n; i++ )
+	{
+		unsigned long long state = 0x9E3779B97F4A7C15ULL ^ (unsigned long long) ( i * 2 + degenerate );
+		double F[3][3], R[3][3], C[3][3];
+		if ( degenerate )
+		{
+			/* R^T diag(l0, l1, l1) R with l1 = l0 or l1 = 0 */
+			double l[3];
+			random_rotation( &state, R );
+			l[0] = pow( 10, 6 * uniform(&state) - 3 );
+			l[1] = l[2] = ( i % 3 == 0 ) ? l[0] : ( ( i % 3 == 1 ) ? 0 : pow( 10, 6 * uniform(&state) - 3 ) );
+			for ( int r = 0; r < 3; r++ )
+				for ( int c = 0; c < 3; c++ )
+					C[r][c] = R[0][r] * l[0] * R[0][c] + R[1][r] * l[1] * R[1][c] + R[2][r] * l[2] * R[2][c];
+		}
+		else
+		{
+			for ( int r = 0; r < 3; r++ )
+			{
+				double scale = pow( 10, 3 * uniform(&state) );
+				for ( int c = 0; c < 3; c++ )
+					F[r][c] = ( 2 * uniform(&state) - 1 ) * scale;
+			}
+			for ( int r = 0; r < 3; r++ )
+				for ( int c = 0; c < 3; c++ )
+					C[r][c] = F[0][r] * F[0][c] + F[1][r] * F[1][c] + F[2][r] * F[2][c];
+		}
+		t->a[0][i] = C[0][0]; t->a[1][i] = C[0][1]; t->a[2][i] = C[0][2];
+		t->a[3][i] = C[1][1]; t->a[4][i] = C[1][2]; t->a[5][i] = C[2][2];
+	}
+}
+
+/* Cyclic Jacobi rotations in long double */
+static long double reference_max ( double a00, double a01, double a02, double a11, double a12, double a22 )
+{
+	long double a[3][3] = { { a00, a01, a02 }, { a01, a11, a12 }, { a02, a12, a22 } };
+	for ( int sweep = 0; sweep < 32; sweep++ )
+	{
+		long double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		long double diag = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+		if ( !( off > 1e-40L * diag ) ) break;
+		for ( int p = 0; p < 2; p++ )
+			for ( int q = p + 1; q < 3; q++ )
+			{
+				if ( a[p][q] == 0 ) continue;
+				long double theta = ( a[q][q] - a[p][p] ) / ( 2 * a[p][q] );
+				long double t = 1 / ( fabsl(theta) + sqrtl( theta * theta + 1 ) );
+				if ( theta < 0 ) t = -t;
+				long double c = 1 / sqrtl( t * t + 1 ), s = t * c;
+				int r = 3 - p - q;
+				long double arp = a[r][p], arq = a[r][q];
+				a[p][p] -= t * a[p][q];
+				a[q][q] += t * a[p][q];
+				a[p][q] = a[q][p] = 0;
+				a[r][p] = a[p][r] = c * arp - s * arq;
+				a[r][q] = a[q][r] = s * arp + c * arq;
+			}
+	}
+	long double max = ( a[0][0] > a[1][1] ) ? a[0][0] : a[1][1];
+	return ( max > a[2][2] ) ? max : a[2][2];
+}
+
+/* Legacy path: coefficients of -x^3 + b x^2 + c x + d, solved by max_solve_3rd_degree_eq */
+static double cubic_max ( double a00, double a01, double a02, double a11, double a12, double a22 )
+{
+	double b = a00 + a11 + a22;
+	double c = a01 * a01 + a02 * a02 + a12 * a12 - a00 * a11 - a00 * a22 - a11 * a22;
+	double d = a00 * a11 * a22 + 2 * a01 * a12 * a02 - a00 * a12 * a12 - a11 * a02 * a02 - a22 * a01 * a01;
+	return max_solve_3rd_degree_eq( -1, b, c, d );
+}
+
+enum { SOLVER_CUBIC, SOLVER_TRIG, SOLVER_JACOBI, SOLVER_BATCH4, SOLVER_BATCH8, NSOLVERS };
+static const char *solver_names[NSOLVERS] = { "cubic", "trig", "jacobi", "batch x4", "batch x8" };
+
+static void run_solver ( int solver, tensors_t *t, double *out, int nth )
+{
+	double **a = t->a;
+	long n = t->n;
+
+	if ( solver == SOLVER_BATCH4 || solver == SOLVER_BATCH8 )
+	{
+		int w = ( solver == SOLVER_BATCH4 ) ? 4 : 8;
+		#pragma omp parallel for default(none) shared(a, n, out, w) num_threads(nth) schedule(static)
+		for ( long i = 0; i < n; i += w )
+		{
+			int m = ( n - i < w ) ? (int) ( n - i ) : w;
+			eigen_max_sym3_batch( m, a[0] + i, a[1] + i, a[2] + i, a[3] + i, a[4] + i, a[5] + i, out + i );
+		}
+		return;
+	}
+
+	#pragma omp parallel for default(none) shared(a, n, out, solver) num_threads(nth) schedule(static)
+	for ( long i = 0; i < n; i++ )
+	{
+		if ( solver == SOLVER_CUBIC )
+			out[i] = cubic_max( a[0][i], a[1][i], a[2][i], a[3][i], a[4][i], a[5][i] );
+		else if ( solver == SOLVER_TRIG )
+			out[i] = eigen_max_sym3_trig( a[0][i], a[1][i], a[2][i], a[3][i], a[4][i], a[5][i] );
+		else
+			out[i] = eigen_max_sym3_jacobi( a[0][i], a[1][i], a[2][i], a[3][i], a[4][i], a[5][i] );
+	}
+}
+
+int main ( int argc, char *argv[] )
+{
+	int nth, nreps = 5;
+	long n = 4000000;
+
+	if ( argc < 2 )
+	{
+		printf("USAGE: %s <nth> [nTensors]\n", argv[0]);
+		return 1;
+	}
+	nth = atoi(argv[1]);
+	if ( argc > 2 ) n = atol(argv[2]);
+
+	double *out = (double *) malloc( sizeof(double) * n );
+	long double *ref = (long double *) malloc( sizeof(long double) * n );
+	if ( out == NULL || ref == NULL )
+	{
+		fprintf( stderr, "Error: not enough memory for %ld tensors\n", n );
+		return 1;
+	}
+
+	printf("%12s %10s %18s %16s\n", "tensors", "solver", "Mtensors/s", "max rel. error");
+	for ( int degenerate = 0; degenerate < 2; degenerate++ )
+	{
+		tensors_t t;
+		create_tensors( n, degenerate, &t );
+		#pragma omp parallel for schedule(static)
+		for ( long i = 0; i < n; i++ )
+			ref[i] = reference_max( t.a[0][i], t.a[1][i], t.a[2][i], t.a[3][i], t.a[4][i], t.a[5][i] );
+
+		for ( int solver = 0; solver < NSOLVERS; solver++ )
+		{
+			double time = 0;
+			for ( int r = 0; r < nreps; r++ )
+			{
+				double t0 = omp_get_wtime();
+				run_solver( solver, &t, out, nth );
+				time += omp_get_wtime() - t0;
+			}
+
+			/* NaN counts as an infinite error */
+			double max_err = 0;
+			for ( long i = 0; i < n; i++ )
+			{
+				double err = (double) ( fabsl( out[i] - ref[i] ) / ref[i] );
+				if ( !( err <= max_err ) ) max_err = isnan(err) ? INFINITY : err;
+			}
+			printf("%12s %10s %18.2f %16.3e\n", degenerate ? "degenerate" : "stretched", solver_names[solver], (double) n * nreps / time / 1e6, max_err);
+			fflush(stdout);
+		}
+
+		for ( int k = 0; k < 6; k++ )
+			free( t.a[k] );
+	}
+
+	free(out);
+	free(ref);
+	return 0;
+}
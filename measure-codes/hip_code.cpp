@@ -464,7 +464,7 @@ __global__ void gpu_compute_gradient_3D (int nPoints, int offset, int faces_offs
   ftle_matrix[2] = gra10 * gra12 + gra20 * gra22 + gra30 * gra32;
   ftle_matrix[3] = ftle_matrix[1];
   ftle_matrix[4] = gra11 * gra11 + gra21 * gra21 + gra31 * gra31;
-  ftle_matrix[5] = gra11 * gra12 + gra11 * gra22 + gra31 * gra32;
+  ftle_matrix[5] = gra11 * gra12 + gra21 * gra22 + gra31 * gra32;
   ftle_matrix[6] = ftle_matrix[2];
   ftle_matrix[7] = ftle_matrix[5];
   ftle_matrix[8] = gra12 * gra12 + gra22 * gra22 + gra32 * gra32;
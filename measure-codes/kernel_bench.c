@@ -0,0 +1,720 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <omp.h>
+
+#include "arithmetic.h"
+#include "preprocess.h"
+#include "eigen.h"
+#include "timing.h"
+
+/* 
+ * Compares the FTLE kernels templated on the dimension and face size
+ * (compute_gradient, compute_ftle_stencil) with the 2D/3D functions they
+ * replaced, which took the face size at run time and were chosen point by
+ * point. Meshes are square or cubic lattices split into triangles or
+ * tetrahedra, numbered along the lattice or shuffled as an unstructured
+ * mesh would be; both kernels must give the same bits.
+ *
+ * A second table compares the face-walk kernel with its branch-free variant
+ * (compute_gradient_coded), which classifies the vertices by a position code
+ * and a slot table, also with the faces of every point and the vertices of
+ * every face in random order, as a mesh generator may leave them; besides the
+ * throughput it reports the branch misses per point of each kernel, where the
+ * hardware counters are available (n/a otherwise).
+ *
+ * USAGE: kernel_bench <nth> [nPoints2D nPoints3D]   (default: 4M and 2M points)
+ */
+
+typedef struct Lattice {
+	int     nDim, nVertsPerFace, nPoints, nFaces;
+	double *coords, *flowmap, *invDenom;
+	int    *faces, *nFacesPerPoint, *facesPerPoint, *stencil;
+} lattice_t;
+
+/* The replaced functions and their helpers, as they were in arithmetic.c; the kernels are kept out of line
+   so that, as the templated ones, they are called once per point */
+
+/* Max eigenvalue of the Cauchy-Green tensor C = grad^T grad. The squared tensor used before had the
+   same eigenvector and the square of this eigenvalue, so log(sqrt(.)) of that one is log of this one */
+static inline double eigen_from_gradient_2D ( double gra10, double gra11, double gra20, double gra21 )
+{
+    double C00 = gra10 * gra10 + gra11 * gra11;
+    double C01 = gra10 * gra20 + gra11 * gra21;
+    double C11 = gra20 * gra20 + gra21 * gra21;
+
+    double mean = ( C00 + C11 ) / 2;
+    double half = ( C00 - C11 ) / 2;
+    return mean + sqrt( half * half + C01 * C01 );
+}
+
+static inline double ftle_from_gradient_2D ( double gra10, double gra11, double gra20, double gra21, double T )
+{
+	return log( eigen_from_gradient_2D ( gra10, gra11, gra20, gra21 ) ) / T;
+}
+
+/* Upper triangle of the Cauchy-Green tensor; row i of the gradient is component i of the flowmap */
+static inline void tensor_from_gradient_3D ( double gra10, double gra11, double gra12, double gra20, double gra21, double gra22, double gra30, double gra31, double gra32, double *a00, double *a01, double *a02, double *a11, double *a12, double *a22 )
+{
+    *a00 = gra10 * gra10 + gra20 * gra20 + gra30 * gra30;
+    *a01 = gra10 * gra11 + gra20 * gra21 + gra30 * gra31;
+    *a02 = gra10 * gra12 + gra20 * gra22 + gra30 * gra32;
+    *a11 = gra11 * gra11 + gra21 * gra21 + gra31 * gra31;
+    *a12 = gra11 * gra12 + gra21 * gra22 + gra31 * gra32;
+    *a22 = gra12 * gra12 + gra22 * gra22 + gra32 * gra32;
+}
+
+static inline double ftle_from_gradient_3D ( double gra10, double gra11, double gra12, double gra20, double gra21, double gra22, double gra30, double gra31, double gra32, double T )
+{
+    double a00, a01, a02, a11, a12, a22;
+    tensor_from_gradient_3D ( gra10, gra11, gra12, gra20, gra21, gra22, gra30, gra31, gra32, &a00, &a01, &a02, &a11, &a12, &a22 );
+    return log( eigen_max_sym3 ( a00, a01, a02, a11, a12, a22 ) ) / T;
+}
+
+static __attribute__((noinline)) void legacy_gradient_2D ( int ip, int nVertsPerFace, double *coords, double *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, double *log_sqrt, double T )
+{
+	int nDim = 2; 
+	int iface, nFaces, idxface, ivert;
+	int closest_points_0 = -1;
+	int closest_points_1 = -1;
+	int closest_points_2 = -1;
+	int closest_points_3 = -1;
+	int count = 0;
+
+	int ivertex;
+	double denom_x, denom_y;
+	double gra10, gra11, gra20, gra21;
+
+	nFaces  = (ip == 0) ? nFacesPerPoint[ip] : nFacesPerPoint[ip] - nFacesPerPoint[ip-1];
+    /* Find 4 closest points */
+	
+	for ( iface = 0; (iface < nFaces) && (count < 4); iface++ )
+	{
+		idxface = (ip == 0) ? facesPerPoint[iface] : facesPerPoint[nFacesPerPoint[ip-1] + iface];
+		for ( ivert = 0; (ivert < nVertsPerFace) && (count < 4); ivert++ )
+		{
+			ivertex = faces[idxface * nVertsPerFace + ivert];
+			if ( ivertex != ip )
+			{
+        		/* (i-1, j) */
+				if ( (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) && (coords[ivertex * nDim] < coords[ip * nDim]) )
+				{
+					if (closest_points_0 == -1)
+					{
+						closest_points_0 = ivertex;
+						count++;
+					}
+				}
+				else
+				{
+        			/* (i+1, j) */
+					if ( (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) && (coords[ivertex * nDim] > coords[ip * nDim]) )
+					{
+						if (closest_points_1 == -1)
+						{
+							closest_points_1 = ivertex;
+							count++;
+						}
+					}
+					else
+					{
+        				/* (i, j-1) */
+						if ( (coords[ivertex * nDim] == coords[ip * nDim]) && (coords[ivertex * nDim + 1] < coords[ip * nDim + 1]) ) 
+						{
+							if (closest_points_2 == -1)
+							{
+								closest_points_2 = ivertex;
+								count++;
+							}
+						}
+						else
+						{
+        					/* (i, j+1) */
+							if ( (coords[ivertex * nDim] == coords[ip * nDim]) && (coords[ivertex * nDim + 1] > coords[ip * nDim + 1]) )
+							{
+								if (closest_points_3 == -1)
+								{
+									closest_points_3 = ivertex;
+									count++;
+								}
+							}
+						}
+					}
+				}			
+			}
+		}
+	}     
+	if ( count == 4 )
+	{
+		/* NOTE: take care with denom_x and denom_y zero */
+		denom_x = coords[ closest_points_1 * nDim ]    - coords[ closest_points_0 * nDim ]; 
+		denom_y = coords[ closest_points_3 * nDim + 1] - coords[ closest_points_2 * nDim + 1];
+		gra10 = ( flowmap[ closest_points_1 * nDim ]     - flowmap[ closest_points_0 * nDim ] )     / denom_x; 			
+		gra20 = ( flowmap[ closest_points_3 * nDim ]     - flowmap[ closest_points_2 * nDim ] )     / denom_y;
+		gra11 = ( flowmap[ closest_points_1 * nDim + 1 ] - flowmap[ closest_points_0 * nDim + 1 ] ) / denom_x;
+		gra21 = ( flowmap[ closest_points_3 * nDim + 1 ] - flowmap[ closest_points_2 * nDim + 1 ] ) / denom_y;
+	}
+	else
+	{
+		if ( count == 3 )
+		{
+			// (i-1, j) and (i+1, j) 
+			if ( ( closest_points_0 > -1 ) && ( closest_points_1 > -1 ) )
+			{
+				denom_x = coords[ closest_points_1 * nDim ]    - coords[ closest_points_0 * nDim ]; 
+				gra10 = ( flowmap[ closest_points_1 * nDim ] - flowmap[ closest_points_0 * nDim ] ) / denom_x;					
+				gra20 = 1; //flowmap [ ip * nDim ]; //??
+				gra11 = ( flowmap[ closest_points_1 * nDim + 1 ] - flowmap[ closest_points_0 * nDim + 1 ] ) / denom_x;
+				gra21 = 1;//flowmap [ ip * nDim + 1];   //??
+			}
+			// (i-1, j) and (i+1, j) 
+			else
+			{
+				denom_y = coords[ closest_points_3 * nDim + 1] - coords[ closest_points_2 * nDim + 1];
+                gra10 = 1; //flowmap [ ip * nDim ];//??
+                gra20 = ( flowmap[ closest_points_3 * nDim ]     - flowmap[ closest_points_2 * nDim ] )     / denom_y;
+				gra11 = 1;// flowmap [ ip * nDim +1];//??
+				gra21 = ( flowmap[ closest_points_3 * nDim + 1 ] - flowmap[ closest_points_2 * nDim + 1 ] ) / denom_y;
+			}
+		}
+		else
+		{
+            gra10 = 1;//flowmap [ ip * nDim ];
+            gra20 = 1;//flowmap [ ip * nDim ];
+            gra11 = 1;//flowmap [ ip * nDim + 1];
+            gra21 = 1;//flowmap [ ip * nDim + 1];
+        }
+    }
+    log_sqrt[ip] = ftle_from_gradient_2D ( gra10, gra11, gra20, gra21, T );
+}
+
+static __attribute__((noinline)) void legacy_gradient_3D ( int ip, int nVertsPerFace, double *coords, double *flowmap, int *faces, int *nFacesPerPoint, int *facesPerPoint, double *log_sqrt, double T)
+{
+	int nDim = 3; 
+	int iface, nFaces, idxface, ivert;
+	int closest_points_0 = -1;
+	int closest_points_1 = -1;
+	int closest_points_2 = -1;
+	int closest_points_3 = -1;
+	int closest_points_4 = -1;
+	int closest_points_5 = -1;
+	int count = 0;
+	
+	int ivertex;
+	double denom_x, denom_y, denom_z;
+	double gra10, gra11, gra12, gra20, gra21, gra22, gra30, gra31, gra32;
+	nFaces  = (ip == 0) ? nFacesPerPoint[ip] : nFacesPerPoint[ip] - nFacesPerPoint[ip-1];
+
+        /* Find 6 closest points */
+	for ( iface = 0; (iface < nFaces) && (count < 6); iface++ )
+	{
+		idxface = (ip == 0) ? facesPerPoint[iface] : facesPerPoint[nFacesPerPoint[ip-1] + iface];
+		for ( ivert = 0; (ivert < nVertsPerFace) && (count < 6); ivert++ )
+		{
+			ivertex = faces[idxface * nVertsPerFace + ivert];
+			if ( ivertex != ip )
+			{
+            		/* (i-1, j, k) */
+				if (   (coords[ivertex * nDim + 1] == coords[ip * nDim + 1])
+					&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
+					&& (coords[ivertex * nDim]     <  coords[ip * nDim]) )
+				{
+					if (closest_points_0 == -1)
+					{
+						closest_points_0 = ivertex;
+						count++;
+					}
+				}
+				else
+				{
+            			/* (i+1, j, k) */
+					if (   (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) 
+						&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
+						&& (coords[ivertex * nDim]     >  coords[ip * nDim]) )
+					{
+						if (closest_points_1 == -1)
+						{
+							closest_points_1 = ivertex;
+							count++;
+						}
+					}
+					else
+					{
+            				/* (i, j-1, k) */
+						if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
+							&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
+							&& (coords[ivertex * nDim + 1] <  coords[ip * nDim + 1]) ) 
+						{
+							if (closest_points_2 == -1)
+							{
+								closest_points_2 = ivertex;
+								count++;
+							}
+						}
+						else
+						{
+            					/* (i, j+1, k) */
+							if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
+								&& (coords[ivertex * nDim + 2] == coords[ip * nDim + 2]) 
+								&& (coords[ivertex * nDim + 1] >  coords[ip * nDim + 1]) )
+							{
+								if (closest_points_3 == -1)
+								{
+									closest_points_3 = ivertex;
+									count++;
+								}
+							}
+							else
+							{
+            						/* (i, j, k-1) */
+								if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
+									&& (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) 
+									&& (coords[ivertex * nDim + 2] <  coords[ip * nDim + 2]) )
+								{
+									if (closest_points_4 == -1)
+									{
+										closest_points_4 = ivertex;
+										count++;
+									}
+								}
+								else
+								{
+	            						/* (i, j, k+1) */
+									if (   (coords[ivertex * nDim]     == coords[ip * nDim]) 
+										&& (coords[ivertex * nDim + 1] == coords[ip * nDim + 1]) 
+										&& (coords[ivertex * nDim + 2] >  coords[ip * nDim + 2]) )
+									{
+										if (closest_points_5 == -1)
+										{
+											closest_points_5 = ivertex;
+											count++;
+										}
+									}
+								}
+							}
+						}
+					}
+				}			
+			}
+		}
+	}     
+	if ( count == 6 )
+	{
+		/* NOTE: take care with denom_x and denom_y zero */
+		denom_x = coords[ closest_points_1 * nDim ]    - coords[ closest_points_0 * nDim ]; 
+		denom_y = coords[ closest_points_3 * nDim + 1] - coords[ closest_points_2 * nDim + 1];
+		denom_z = coords[ closest_points_5 * nDim + 2] - coords[ closest_points_4 * nDim + 2];
+
+		gra10 = ( flowmap[ closest_points_1 * nDim ] - flowmap[ closest_points_0 * nDim ] ) / denom_x; 			
+		gra11 = ( flowmap[ closest_points_3 * nDim ] - flowmap[ closest_points_2 * nDim ] ) / denom_y;
+		gra12 = ( flowmap[ closest_points_5 * nDim ] - flowmap[ closest_points_4 * nDim ] ) / denom_z;
+
+		gra20 = ( flowmap[ closest_points_1 * nDim + 1] - flowmap[ closest_points_0 * nDim + 1] ) / denom_x; 			
+		gra21 = ( flowmap[ closest_points_3 * nDim + 1] - flowmap[ closest_points_2 * nDim + 1] ) / denom_y;
+		gra22 = ( flowmap[ closest_points_5 * nDim + 1] - flowmap[ closest_points_4 * nDim + 1] ) / denom_z;
+
+		gra30 = ( flowmap[ closest_points_1 * nDim + 2] - flowmap[ closest_points_0 * nDim + 2] ) / denom_x; 			
+		gra31 = ( flowmap[ closest_points_3 * nDim + 2] - flowmap[ closest_points_2 * nDim + 2] ) / denom_y;
+		gra32 = ( flowmap[ closest_points_5 * nDim + 2] - flowmap[ closest_points_4 * nDim + 2] ) / denom_z;
+	}
+	else
+	{
+		gra10 = 1;
+		gra11 = 1;
+		gra12 = 1;
+		gra20 = 1;
+		gra21 = 1;
+		gra22 = 1;
+		gra30 = 1;
+		gra31 = 1;
+		gra32 = 1;
+	}
+
+    log_sqrt[ip] = ftle_from_gradient_3D ( gra10, gra11, gra12, gra20, gra21, gra22, gra30, gra31, gra32, T );
+}
+
+static __attribute__((noinline)) void legacy_stencil_2D ( int ip, int *stencil, double *invDenom, double *flowmap, double *log_sqrt, double T )
+{
+	int nDim = 2;
+	int *closest = stencil + ip * 4;
+	int count = ( closest[0] > -1 ) + ( closest[1] > -1 ) + ( closest[2] > -1 ) + ( closest[3] > -1 );
+	int has_x = ( closest[0] > -1 ) && ( closest[1] > -1 );
+	int has_y = ( closest[2] > -1 ) && ( closest[3] > -1 );
+	double gra10 = 1, gra11 = 1, gra20 = 1, gra21 = 1;
+
+	/* As legacy_gradient_2D: both pairs, or the complete one when a single neighbour is missing */
+	if ( has_x && ( count >= 3 ) )
+	{
+		gra10 = ( flowmap[ closest[1] * nDim ]     - flowmap[ closest[0] * nDim ] )     * invDenom[ ip * nDim ];
+		gra11 = ( flowmap[ closest[1] * nDim + 1 ] - flowmap[ closest[0] * nDim + 1 ] ) * invDenom[ ip * nDim ];
+	}
+	if ( has_y && ( count >= 3 ) )
+	{
+		gra20 = ( flowmap[ closest[3] * nDim ]     - flowmap[ closest[2] * nDim ] )     * invDenom[ ip * nDim + 1 ];
+		gra21 = ( flowmap[ closest[3] * nDim + 1 ] - flowmap[ closest[2] * nDim + 1 ] ) * invDenom[ ip * nDim + 1 ];
+	}
+	log_sqrt[ip] = ftle_from_gradient_2D ( gra10, gra11, gra20, gra21, T );
+}
+
+static __attribute__((noinline)) void legacy_stencil_3D ( int ip, int *stencil, double *invDenom, double *flowmap, double *log_sqrt, double T )
+{
+	int nDim = 3;
+	int *closest = stencil + ip * 6;
+
+	/* As legacy_gradient_3D: all 6 neighbours are required */
+	if ( ( closest[0] > -1 ) && ( closest[1] > -1 ) && ( closest[2] > -1 ) && ( closest[3] > -1 ) && ( closest[4] > -1 ) && ( closest[5] > -1 ) )
+	{
+		double inv_x = invDenom[ ip * nDim ];
+		double inv_y = invDenom[ ip * nDim + 1 ];
+		double inv_z = invDenom[ ip * nDim + 2 ];
+		log_sqrt[ip] = ftle_from_gradient_3D (
+			( flowmap[ closest[1] * nDim ]     - flowmap[ closest[0] * nDim ] )     * inv_x,
+			( flowmap[ closest[3] * nDim ]     - flowmap[ closest[2] * nDim ] )     * inv_y,
+			( flowmap[ closest[5] * nDim ]     - flowmap[ closest[4] * nDim ] )     * inv_z,
+			( flowmap[ closest[1] * nDim + 1 ] - flowmap[ closest[0] * nDim + 1 ] ) * inv_x,
+			( flowmap[ closest[3] * nDim + 1 ] - flowmap[ closest[2] * nDim + 1 ] ) * inv_y,
+			( flowmap[ closest[5] * nDim + 1 ] - flowmap[ closest[4] * nDim + 1 ] ) * inv_z,
+			( flowmap[ closest[1] * nDim + 2 ] - flowmap[ closest[0] * nDim + 2 ] ) * inv_x,
+			( flowmap[ closest[3] * nDim + 2 ] - flowmap[ closest[2] * nDim + 2 ] ) * inv_y,
+			( flowmap[ closest[5] * nDim + 2 ] - flowmap[ closest[4] * nDim + 2 ] ) * inv_z,
+			T );
+	}
+	else
+		log_sqrt[ip] = ftle_from_gradient_3D ( 1, 1, 1, 1, 1, 1, 1, 1, 1, T );
+}
+
+static unsigned long long next_random ( unsigned long long *state )
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return *state >> 33;
+}
+
+/* Random permutation of n values */
+static void shuffle_values ( int n, int *values, unsigned long long *state )
+{
+	for ( int i = n - 1; i > 0; i-- )
+	{
+		int j = (int) ( next_random(state) % ( i + 1 ) ), tmp = values[i];
+		values[i] = values[j];
+		values[j] = tmp;
+	}
+}
+
+/* Lattice of side^nDim points; every square is split into 2 triangles, every cube into the 6 tetrahedra
+   around its main diagonal. With shuffle the points are numbered in random order, with random_faces the
+   faces of every point and the vertices of every face are listed in random order */
+static void create_lattice ( int nDim, int side, int shuffle, int random_faces, int nth, lattice_t *m )
+{
+	int nCells = ( nDim == 2 ) ? ( side - 1 ) * ( side - 1 ) : ( side - 1 ) * ( side - 1 ) * ( side - 1 );
+	int stride[3] = { 1, side, side * side };
+	int *perm;
+
+	m->nDim          = nDim;
+	m->nVertsPerFace = nDim + 1;
+	m->nPoints       = ( nDim == 2 ) ? side * side : side * side * side;
+	m->nFaces        = nCells * ( ( nDim == 2 ) ? 2 : 6 );
+	m->coords        = (double *) malloc( sizeof(double) * m->nPoints * nDim );
+	m->flowmap       = (double *) malloc( sizeof(double) * m->nPoints * nDim );
+	m->faces         = (int *) malloc( sizeof(int) * (size_t) m->nFaces * m->nVertsPerFace );
+	perm             = (int *) malloc( sizeof(int) * m->nPoints );
+
+	for ( int ip = 0; ip < m->nPoints; ip++ )
+		perm[ip] = ip;
+	if ( shuffle )
+	{
+		unsigned long long state = 0x9E3779B97F4A7C15ULL;
+		shuffle_values( m->nPoints, perm, &state );
+	}
+
+	/* Flowmap of a smooth shear, so every point has a different gradient */
+	#pragma omp parallel for schedule(static) num_threads(nth)
+	for ( int ip = 0; ip < m->nPoints; ip++ )
+	{
+		for ( int d = 0; d < nDim; d++ )
+			m->coords[ perm[ip] * nDim + d ] = ( ip / stride[d] ) % side / (double) ( side - 1 );
+		for ( int d = 0; d < nDim; d++ )
+			m->flowmap[ perm[ip] * nDim + d ] = m->coords[ perm[ip] * nDim + d ] + 0.1 * sin( 6.283185307179586 * m->coords[ perm[ip] * nDim + ( d + 1 ) % nDim ] );
+	}
+
+	#pragma omp parallel for schedule(static) num_threads(nth)
+	for ( int c = 0; c < nCells; c++ )
+	{
+		int i = c % ( side - 1 ), j = c / ( side - 1 ) % ( side - 1 ), k = c / ( side - 1 ) / ( side - 1 );
+		int p = i + j * stride[1] + k * stride[2];
+		int *f = m->faces + (size_t) c * ( ( nDim == 2 ) ? 6 : 24 );
+		if ( nDim == 2 )
+		{
+			f[0] = p;     f[1] = p + 1;              f[2] = p + side;
+			f[3] = p + 1; f[4] = p + side + 1;       f[5] = p + side;
+		}
+		else
+		{
+			/* One tetrahedron per order in which the axes are walked from corner p to the opposite one */
+			const int axes[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+			for ( int t = 0; t < 6; t++ )
+			{
+				f[4*t]   = p;
+				f[4*t+1] = f[4*t]   + stride[ axes[t][0] ];
+				f[4*t+2] = f[4*t+1] + stride[ axes[t][1] ];
+				f[4*t+3] = f[4*t+2] + stride[ axes[t][2] ];
+			}
+		}
+		for ( int v = 0; v < ( ( nDim == 2 ) ? 6 : 24 ); v++ )
+			f[v] = perm[ f[v] ];
+	}
+	free(perm);
+
+	m->nFacesPerPoint = (int *) malloc( sizeof(int) * m->nPoints );
+	create_nFacesPerPoint_vector_parallel( nDim, m->nPoints, m->nFaces, m->nVertsPerFace, m->faces, m->nFacesPerPoint, nth );
+	m->facesPerPoint = (int *) malloc( sizeof(int) * m->nFacesPerPoint[ m->nPoints - 1 ] );
+	create_facesPerPoint_vector_linear( nDim, m->nPoints, m->nFaces, m->nVertsPerFace, m->faces, m->nFacesPerPoint, m->facesPerPoint, nth );
+	if ( random_faces )
+	{
+		unsigned long long state = 0x2545F4914F6CDD1DULL;
+		for ( int f = 0; f < m->nFaces; f++ )
+			shuffle_values( m->nVertsPerFace, m->faces + (size_t) f * m->nVertsPerFace, &state );
+		for ( int ip = 0; ip < m->nPoints; ip++ )
+		{
+			int first = ( ip == 0 ) ? 0 : m->nFacesPerPoint[ip-1];
+			shuffle_values( m->nFacesPerPoint[ip] - first, m->facesPerPoint + first, &state );
+		}
+	}
+	m->stencil  = (int *) malloc( sizeof(int) * m->nPoints * 2 * nDim );
+	m->invDenom = (double *) malloc( sizeof(double) * m->nPoints * nDim );
+	create_stencil_table( nDim, m->nPoints, m->nVertsPerFace, m->coords, m->faces, m->nFacesPerPoint, m->facesPerPoint, m->stencil, m->invDenom, nth );
+}
+
+static void free_lattice ( lattice_t *m )
+{
+	free(m->coords); free(m->flowmap); free(m->faces); free(m->nFacesPerPoint); free(m->facesPerPoint); free(m->stencil); free(m->invDenom);
+}
+
+enum { KERNEL_FACEWALK, KERNEL_STENCIL, NKERNELS };
+static const char *kernel_names[NKERNELS] = { "facewalk", "stencil" };
+
+/* Point loop of the replaced functions: dimension tested for every point, face size passed at run time */
+static void run_legacy ( int kernel, lattice_t *m, double *out, double T, int nth )
+{
+	#pragma omp parallel for default(none) shared(kernel, m, out, T) num_threads(nth) schedule(static)
+	for ( int ip = 0; ip < m->nPoints; ip++ )
+	{
+		if ( kernel == KERNEL_STENCIL )
+		{
+			if ( m->nDim == 2 )
+				legacy_stencil_2D( ip, m->stencil, m->invDenom, m->flowmap, out, T );
+			else
+				legacy_stencil_3D( ip, m->stencil, m->invDenom, m->flowmap, out, T );
+		}
+		else if ( m->nDim == 2 )
+			legacy_gradient_2D( ip, m->nVertsPerFace, m->coords, m->flowmap, m->faces, m->nFacesPerPoint, m->facesPerPoint, out, T );
+		else
+			legacy_gradient_3D( ip, m->nVertsPerFace, m->coords, m->flowmap, m->faces, m->nFacesPerPoint, m->facesPerPoint, out, T );
+	}
+}
+
+template <int NDIM, int NVERTS>
+static void run_template_dim ( int kernel, lattice_t *m, double *out, double T, int nth )
+{
+	if ( kernel == KERNEL_STENCIL )
+	{
+		#pragma omp parallel for default(none) shared(m, out, T) num_threads(nth) schedule(static)
+		for ( int ip = 0; ip < m->nPoints; ip++ )
+			compute_ftle_stencil<NDIM, double>( ip, m->stencil, m->invDenom, m->flowmap, out, T );
+	}
+	else
+	{
+		#pragma omp parallel for default(none) shared(m, out, T) num_threads(nth) schedule(static)
+		for ( int ip = 0; ip < m->nPoints; ip++ )
+			compute_gradient<NDIM, NVERTS, double>( ip, m->coords, m->flowmap, m->faces, m->nFacesPerPoint, m->facesPerPoint, out, T );
+	}
+}
+
+template <int NDIM, int NVERTS>
+static void run_facecode_dim ( int coded, lattice_t *m, double *out, double T, int nth )
+{
+	if ( coded )
+	{
+		#pragma omp parallel for default(none) shared(m, out, T) num_threads(nth) schedule(static)
+		for ( int ip = 0; ip < m->nPoints; ip++ )
+			compute_gradient_coded<NDIM, NVERTS, double>( ip, m->coords, m->flowmap, m->faces, m->nFacesPerPoint, m->facesPerPoint, out, T );
+	}
+	else
+		run_template_dim<NDIM, NVERTS>( KERNEL_FACEWALK, m, out, T, nth );
+}
+
+/* Face-walk kernel, with the comparison chain or (coded) the position codes */
+static void run_facecode ( int coded, lattice_t *m, double *out, double T, int nth )
+{
+	if ( m->nDim == 2 )
+		run_facecode_dim<2, 3>( coded, m, out, T, nth );
+	else
+		run_facecode_dim<3, 4>( coded, m, out, T, nth );
+}
+
+/* Point loop of the templated kernels: dimension and face size chosen once */
+static void run_template ( int kernel, lattice_t *m, double *out, double T, int nth )
+{
+	if ( m->nDim == 2 )
+		run_template_dim<2, 3>( kernel, m, out, T, nth );
+	else
+		run_template_dim<3, 4>( kernel, m, out, T, nth );
+}
+
+static void print_misses ( long long misses, int nPoints, int nreps )
+{
+	if ( misses < 0 )
+		printf(" %14s", "n/a");
+	else
+		printf(" %14.3f", (double) misses / nPoints / nreps);
+}
+
+int main ( int argc, char *argv[] )
+{
+	int nth, nreps = 5, branch_fd;
+	long sizes[2] = { 4000000, 2000000 };
+	double T = 10;
+
+	if ( argc < 2 )
+	{
+		printf("USAGE: %s <nth> [nPoints2D nPoints3D]\n", argv[0]);
+		return 1;
+	}
+	nth = atoi(argv[1]);
+	if ( argc > 3 )
+	{
+		sizes[0] = atol(argv[2]);
+		sizes[1] = atol(argv[3]);
+	}
+
+	/* Branch-miss counter, opened before any thread is started so that all of them are counted */
+	branch_fd = timing_counter_open( TIMING_BRANCH_MISSES );
+
+	printf("%4s %10s %10s %10s %16s %16s %9s\n", "dim", "numbering", "nPoints", "kernel", "legacy Mpts/s", "template Mpts/s", "speedup");
+	for ( int nDim = 2; nDim <= 3; nDim++ )
+	{
+		int side = 2;
+		while ( ( ( nDim == 2 ) ? (long) side * side : (long) side * side * side ) < sizes[nDim - 2] ) side++;
+
+		for ( int shuffle = 0; shuffle < 2; shuffle++ )
+		{
+			lattice_t m;
+			create_lattice( nDim, side, shuffle, 0, nth, &m );
+			double *legacy = (double *) malloc( sizeof(double) * m.nPoints );
+			double *result = (double *) malloc( sizeof(double) * m.nPoints );
+			if ( m.coords == NULL || m.faces == NULL || legacy == NULL || result == NULL )
+			{
+				fprintf( stderr, "Error: not enough memory for %d points\n", m.nPoints );
+				return 1;
+			}
+
+			for ( int kernel = 0; kernel < NKERNELS; kernel++ )
+			{
+				double t_legacy = 0, t_template = 0;
+				for ( int r = 0; r < nreps; r++ )
+				{
+					double t0 = omp_get_wtime();
+					run_legacy( kernel, &m, legacy, T, nth );
+					double t1 = omp_get_wtime();
+					run_template( kernel, &m, result, T, nth );
+					double t2 = omp_get_wtime();
+					t_legacy   += t1 - t0;
+					t_template += t2 - t1;
+				}
+				if ( memcmp( legacy, result, sizeof(double) * m.nPoints ) )
+				{
+					fprintf( stderr, "Error: %s template kernel differs from the legacy one\n", kernel_names[kernel] );
+					return 1;
+				}
+				printf("%4d %10s %10d %10s %16.2f %16.2f %9.2f\n", nDim, shuffle ? "shuffled" : "lattice", m.nPoints, kernel_names[kernel],
+					(double) m.nPoints * nreps / t_legacy / 1e6, (double) m.nPoints * nreps / t_template / 1e6, t_legacy / t_template);
+				fflush(stdout);
+			}
+
+			free(legacy);
+			free(result);
+			free_lattice(&m);
+		}
+	}
+
+	printf("\n%4s %10s %8s %10s %16s %16s %9s %14s %14s\n", "dim", "numbering", "faces", "nPoints", "facewalk Mpts/s", "facecode Mpts/s", "speedup",
+		"facewalk br/pt", "facecode br/pt");
+	for ( int nDim = 2; nDim <= 3; nDim++ )
+	{
+		int side = 2;
+		while ( ( ( nDim == 2 ) ? (long) side * side : (long) side * side * side ) < sizes[nDim - 2] ) side++;
+
+		for ( int order = 0; order < 4; order++ )
+		{
+			int shuffle = order / 2, random_faces = order % 2;
+			lattice_t m;
+			create_lattice( nDim, side, shuffle, random_faces, nth, &m );
+			double *walk  = (double *) malloc( sizeof(double) * m.nPoints );
+			double *coded = (double *) malloc( sizeof(double) * m.nPoints );
+			if ( m.coords == NULL || m.faces == NULL || walk == NULL || coded == NULL )
+			{
+				fprintf( stderr, "Error: not enough memory for %d points\n", m.nPoints );
+				return 1;
+			}
+
+			double    t_walk = 0, t_coded = 0;
+			long long br_walk = 0, br_coded = 0, br;
+			for ( int r = 0; r < nreps; r++ )
+			{
+				double t0 = omp_get_wtime();
+				timing_counter_start( branch_fd );
+				run_facecode( 0, &m, walk, T, nth );
+				br = timing_counter_stop( branch_fd );
+				br_walk = ( br < 0 || br_walk < 0 ) ? -1 : br_walk + br;
+				double t1 = omp_get_wtime();
+				timing_counter_start( branch_fd );
+				run_facecode( 1, &m, coded, T, nth );
+				br = timing_counter_stop( branch_fd );
+				br_coded = ( br < 0 || br_coded < 0 ) ? -1 : br_coded + br;
+				double t2 = omp_get_wtime();
+				t_walk  += t1 - t0;
+				t_coded += t2 - t1;
+			}
+			if ( memcmp( walk, coded, sizeof(double) * m.nPoints ) )
+			{
+				fprintf( stderr, "Error: facecode kernel differs from the facewalk one\n" );
+				return 1;
+			}
+			printf("%4d %10s %8s %10d %16.2f %16.2f %9.2f", nDim, shuffle ? "shuffled" : "lattice", random_faces ? "random" : "ordered", m.nPoints,
+				(double) m.nPoints * nreps / t_walk / 1e6, (double) m.nPoints * nreps / t_coded / 1e6, t_walk / t_coded);
+			print_misses( br_walk, m.nPoints, nreps );
+			print_misses( br_coded, m.nPoints, nreps );
+			printf("\n");
+			fflush(stdout);
+
+			free(walk);
+			free(coded);
+			free_lattice(&m);
+		}
+	}
+
+	timing_counter_close( branch_fd );
+	return 0;
+}
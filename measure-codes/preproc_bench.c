@@ -0,0 +1,126 @@
+/*
+ *            UVaFTLE 1.0: Lagrangian finite time 
+ *		    Lyapunov exponent extraction 
+ *		    for fluid dynamic applications
+ *
+ *    Copyright (C) 2023, 2024 Rocío Carratalá-Sáez et. al.
+ *    This file is part of the UVaFTLE application.
+ *
+ *  UVaFTLE is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  UVaFTLE is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with UVaFTLE.  If not, see <http://www.gnu.org/licenses/>.
+ */ 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <omp.h>
+
+#include "preprocess.h"
+
+/* 
+ * Compares the serial count-and-scan of create_nFacesPerPoint_vector with
+ * the block-wise parallel one on synthetic 2D meshes (two triangles per
+ * quad of a square lattice).
+ *
+ * USAGE: preproc_bench <nth> [nPoints ...]   (default: 1M 10M 100M points)
+ */
+
+static int *create_lattice_faces ( int side, int *nFaces )
+{
+	int nf = 2 * (side - 1) * (side - 1);
+	int *faces = (int *) malloc( sizeof(int) * 3 * (size_t) nf );
+	if ( faces == NULL ) return NULL;
+
+	#pragma omp parallel for schedule(static)
+	for ( int j = 0; j < side - 1; j++ )
+	{
+		for ( int i = 0; i < side - 1; i++ )
+		{
+			size_t f = 2 * ( (size_t) j * (side - 1) + i );
+			int p = j * side + i;
+			faces[3*f]   = p;        faces[3*f+1] = p + 1;    faces[3*f+2] = p + side;
+			faces[3*f+3] = p + 1;    faces[3*f+4] = p + side + 1; faces[3*f+5] = p + side;
+		}
+	}
+	*nFaces = nf;
+	return faces;
+}
+
+int main ( int argc, char *argv[] )
+{
+	long default_sizes[3] = { 1000000, 10000000, 100000000 };
+	int nth, nsizes, nreps = 5;
+	long *sizes;
+
+	if ( argc < 2 )
+	{
+		printf("USAGE: %s <nth> [nPoints ...]\n", argv[0]);
+		return 1;
+	}
+	nth = atoi(argv[1]);
+	if ( argc > 2 )
+	{
+		nsizes = argc - 2;
+		sizes  = (long *) malloc( sizeof(long) * nsizes );
+		for ( int i = 0; i < nsizes; i++ ) sizes[i] = atol(argv[i+2]);
+	}
+	else
+	{
+		nsizes = 3;
+		sizes  = default_sizes;
+	}
+
+	printf("%12s %12s %14s %14s %9s\n", "nPoints", "nFaces", "serial (ms)", "parallel (ms)", "speedup");
+	for ( int is = 0; is < nsizes; is++ )
+	{
+		int side = 2;
+		while ( (long) side * side < sizes[is] ) side++;
+		int nPoints = side * side;
+		int nFaces;
+		int *faces = create_lattice_faces( side, &nFaces );
+		int *serial   = (int *) malloc( sizeof(int) * nPoints );
+		int *parallel = (int *) malloc( sizeof(int) * nPoints );
+		if ( faces == NULL || serial == NULL || parallel == NULL )
+		{
+			fprintf( stderr, "Error: not enough memory for %d points\n", nPoints );
+			return 1;
+		}
+
+		double t_serial = 0, t_parallel = 0;
+		for ( int r = 0; r < nreps; r++ )
+		{
+			double t0 = omp_get_wtime();
+			create_nFacesPerPoint_vector( 2, nPoints, nFaces, 3, faces, serial );
+			double t1 = omp_get_wtime();
+			create_nFacesPerPoint_vector_parallel( 2, nPoints, nFaces, 3, faces, parallel, nth );
+			double t2 = omp_get_wtime();
+			t_serial   += t1 - t0;
+			t_parallel += t2 - t1;
+		}
+		if ( memcmp( serial, parallel, sizeof(int) * nPoints ) )
+		{
+			fprintf( stderr, "Error: parallel scan differs from the serial one\n" );
+			return 1;
+		}
+		t_serial   = t_serial   * 1000 / nreps;
+		t_parallel = t_parallel * 1000 / nreps;
+		printf("%12d %12d %14.3f %14.3f %9.2f\n", nPoints, nFaces, t_serial, t_parallel, t_serial / t_parallel);
+		fflush(stdout);
+
+		free(faces);
+		free(serial);
+		free(parallel);
+	}
+
+	return 0;
+}
@@ -182,6 +182,42 @@ def compute_flowmap_3D(x_, y_, z_, t_, vx, vy, vz, mesh, gridpoints, timeVector,
     mesh['flowmapY'] = solution[:, 1]
     return mesh
 
+def compute_ftle_uvaftle(library, nDim, coords, faces, flowmap, t_eval, nth=4):
+    '''
+        computes the FTLE in-process with libuvaftle; the arrays are passed
+        without copies, so they are made contiguous with the C types first
+    '''
+    lib = CDLL(library)
+    lib.uvaftle_mesh_create.restype = c_void_p
+    lib.uvaftle_mesh_create.argtypes = [c_int, c_int, POINTER(c_double), c_int, POINTER(c_int), c_int]
+    lib.uvaftle_mesh_set_faces.argtypes = [c_void_p, c_int, POINTER(c_int)]
+    lib.uvaftle_build_adjacency.argtypes = [c_void_p, c_int]
+    lib.uvaftle_compute.argtypes = [c_void_p, POINTER(c_double), c_double, POINTER(c_double)]
+    lib.uvaftle_mesh_free.argtypes = [c_void_p]
+
+    coords = np.ascontiguousarray(coords[:, 0:nDim], dtype=np.float64)
+    faces = np.ascontiguousarray(faces, dtype=np.int32)
+    flowmap = np.ascontiguousarray(flowmap[:, 0:nDim], dtype=np.float64)
+    ftle = np.empty(len(coords), dtype=np.float64)
+
+    mesh = lib.uvaftle_mesh_create(nDim, len(coords), coords.ctypes.data_as(POINTER(c_double)), 0, None, nth)
+    if mesh is None:
+        raise RuntimeError("uvaftle_mesh_create failed")
+    try:
+        if lib.uvaftle_mesh_set_faces(mesh, len(faces), faces.ctypes.data_as(POINTER(c_int))) != 0 or \
+           lib.uvaftle_build_adjacency(mesh, 0) != 0 or \
+           lib.uvaftle_compute(mesh, flowmap.ctypes.data_as(POINTER(c_double)), t_eval, ftle.ctypes.data_as(POINTER(c_double))) != 0:
+            raise RuntimeError("libuvaftle rejected the mesh or the flowmap")
+    finally:
+        lib.uvaftle_mesh_free(mesh)
+    return ftle
+
+def write_ftle(ftle_file, ftle):
+    ff = open(ftle_file, "w")
+    for index in range(len(ftle)):
+        ff.write(str(ftle[index])+'\n')
+    ff.close()
+
 def main_2D (args):
     
     t_start = time.time()
@@ -277,6 +313,11 @@ def main_2D (args):
     t_store = time.time()
     print("Python data saved in files: "+str(t_store-t_preprocess), flush=True)
 
+    if args.no_flowmap:
+        print("Flowmap skipped: UVaFTLE integrates it from "+vel_file+" and "+times_file, flush=True)
+        print("Total time elapsed: "+str(time.time()-t_start), flush=True)
+        return
+
     print("Starting compute flowmap...", flush=True)
     flowmap = compute_flowmap_2D(x_, y_, t_, vx, vy, mesh, gridpoints, [0, 8])
 
@@ -289,6 +330,12 @@ def main_2D (args):
         ff.write(str(truefm_y[index])+'\n')
     ff.close()
 
+    if args.ftle_library:
+        print("Computing FTLE with "+args.ftle_library+"...", flush=True)
+        ftle = compute_ftle_uvaftle(args.ftle_library, nDim, gridpoints, faces,
+                                    np.column_stack((truefm_x, truefm_y)), t0_eval, int(args.num_cores))
+        write_ftle(args.ftle_file, ftle)
+
     t_end = time.time()
     print("Total time elapsed: "+str(t_end-t_start), flush=True)
 
@@ -460,6 +507,9 @@ def main_3D (args):
     for index in range(len(tetrahedra)):
         ff.write(str(tetrahedra[index][0])+'\n' + str(tetrahedra[index][1])+'\n' + str(tetrahedra[index][2])+'\n' + str(tetrahedra[index][3])+'\n')
 
+    # Faces outlive the shared memory for the FTLE below
+    faces = tetrahedra.astype(np.int32)
+
     # Shared memory end
     shm.close()
     shm.unlink()
@@ -474,6 +524,11 @@ def main_3D (args):
     t_store = time.time()
     print("Python data saved in files: "+str(t_store-t_preprocess), flush=True)
 
+    if args.no_flowmap:
+        print("Flowmap skipped: UVaFTLE integrates it from "+vel_file+" and "+times_file, flush=True)
+        print("Total time elapsed: "+str(time.time()-t_start), flush=True)
+        return
+
     print("Starting compute flowmap...", flush=True)
     flowmap = compute_flowmap_3D(x_, y_, z_, t_, vx, vy, vz, mesh, gridpoints, [0, 8], number_of_threads=num_cores)
 
@@ -487,6 +542,12 @@ def main_3D (args):
         ff.write(str(truefm_y[index])+'\n')
         ff.write(str(truefm_z[index])+'\n')
     ff.close()
+
+    if args.ftle_library:
+        print("Computing FTLE with "+args.ftle_library+"...", flush=True)
+        ftle = compute_ftle_uvaftle(args.ftle_library, nDim, gridpoints, faces,
+                                    np.column_stack((truefm_x, truefm_y, truefm_z)), t0_eval, num_cores)
+        write_ftle(args.ftle_file, ftle)
     
     '''
     COMPUTE_FLOWMAP_C_FUNCTIONS.compute_flowmap(c_int(nDim), c_int(ntimes_eval), c_double(t0_eval), c_double(tdelta_eval), c_char_p(coords_file.encode('utf-8')), c_char_p(faces_file.encode('utf-8')), c_char_p(times_file.encode('utf-8')), c_char_p(vel_file.encode('utf-8')), c_int(nsteps_rk4), c_int(sched_policy), c_int(chunk_size), c_int(print2file), c_char_p(output_file.encode('utf-8')) )
@@ -523,6 +584,9 @@ if __name__ == '__main__':
     parser.add_argument(metavar="<x_steps_axis>", dest="x_steps_axis", help="Steps in X axis (for linspace)",  default=-1, type=int )
     parser.add_argument(metavar="<y_steps_axis>", dest="y_steps_axis", help="Steps in Y axis (for linspace)", default=-1, type=int )
     parser.add_argument(metavar="<z_steps_axis>", dest="z_steps_axis", help="Steps in Z axis (for linspace)", default=-1, nargs='?', type=int)
+    parser.add_argument("--no-flowmap", dest="no_flowmap", action="store_true", help="Do not compute the flowmap: UVaFTLE integrates it from <times_file> and <vel_file> (FTLE_VELOCITY, FTLE_TIMES)")
+    parser.add_argument("--ftle", dest="ftle_library", metavar="<libuvaftle.so>", help="Also compute the FTLE of the flowmap in-process with this UVaFTLE library (t_eval = <t0_eval>)", default=None)
+    parser.add_argument("--ftle-file", dest="ftle_file", metavar="<ftle_file>", help="File path where FTLE data will be stored with --ftle", default="ftle.txt")
 
 
     args = parser.parse_args()